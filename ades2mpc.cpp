@@ -25,6 +25,7 @@ parsing in my software.
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "stringex.h"
 #include <stdio.h>
 #include <ctype.h>
@@ -112,8 +113,7 @@ int free_ades2mpc_context( void *context)
    return( rval);
 }
 
-   /* see 'adestags.c' for code that generates these #defines.  Tags are
-sorted so that a binary search can speed up tag matching slightly. */
+   /* see 'adestags.c' for code that generates these #defines.  */
 
 #define ADES_Location                      1
 #define ADES_MPCID                         2
@@ -258,8 +258,12 @@ sorted so that a binary search can speed up tag matching slightly. */
 #define ADES_trx                         141
 #define ADES_uncTime                     142
 
-/* See 'adestags.c' for code that created following array
-and the above #defines. */
+/* See 'adestags.c' for code that created following arrays
+and the above #defines.  Tags are found with a perfect hash :  the
+'displacement' and 'slots' tables are built so that each of the above
+tags lands in its own slot,  so finding a tag takes one pass over its
+characters and a single string comparison (large ADES files can have
+tens of millions of tags to look up.)  */
 
 static int find_tag( const char *buff, size_t len)
 {
@@ -292,10 +296,32 @@ static int find_tag( const char *buff, size_t len)
        "selPhot", "shapeOcc", "sigCorr", "sigDec", "sigDelay",
        "sigDoppler", "sigMag", "sigRA", "sigTime", "software",
        "stn", "subFmt", "subFrm", "submitter", "sys", "telescope",
-       "trkID", "trkMPC", "trkSub", "trx", "uncTime",
-   NULL };
-
-   int i, rval = -1;
+       "trkID", "trkMPC", "trkSub", "trx", "uncTime" };
+   static const unsigned char displacement[64] = {
+         2,  2,  4,  0,  1,  0,  7,  0,  1,  0,  2,  0,  0,  0,  0,  0,
+         1,  3,  0,  0,  8,  1,  0,  9,  0,  5,  3,  4,  0,  0,  3,  1,
+         4,  0,  3,  1,  6,  0,  0,  3,  0, 11, 12,  0,  0,  2,  0,  0,
+         8,  0,  3,  0,  8,  0,  2,  0,  4,  0,  1,  6,  2,  8,  8,  1 };
+   static const unsigned char slots[256] = {
+         0,134,  0,  0, 21,  1,119, 30,  0, 70,  0,  0, 48,  0,  0,  0,
+        84,  0,137, 72, 24,  4,120,121, 83,  0, 82,  0,103,  0, 31,  0,
+        36, 49,135,  5,  0,  0,118,  0,  0,  0, 73,131, 11,  0,  0, 34,
+        39,115, 10, 54, 55, 35,108, 42,125, 79,127,116,  0, 17, 93, 80,
+       104,  0,  0,113,  0,  0, 59,  0, 81,  0,  0,  0, 47,128,  0, 50,
+        76,  0,  0,  0, 41, 78,  0, 64,  0,  0,109,  0, 23,139,  6,  0,
+        19,112, 62, 29,  0,  0, 28,  0, 26, 40, 56,142, 37,140, 38, 27,
+         0,  0, 16, 44,123,  0, 61,  0, 95, 96, 74, 14,  0, 77,117,114,
+         0,  0,  0,129,130,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0, 63,  0,  9,107, 43, 69, 92,  0,  0,  0,  0,  0,  0,138,  0,
+        45,110,132,  0,100,101,136, 98,  0,  0,141,105, 60,  0,  0,  0,
+        25,  0,  0, 99,  0, 68,126, 58,111, 33, 18,  0,  8, 65, 71, 75,
+        20, 52,  0,  0,  0,  0,  0, 57,  0, 67,  0,  0,  0, 22,  0,  0,
+         0,  0,  0, 51,  0,  0, 15,102, 12,  0,122, 32, 97,  0,  0,  0,
+         0,  0,  0, 94,  0,  0,  0,  7,  3,  0, 66,  2,  0, 13,  0,124,
+         0,  0,  0,  0, 88,  0,133, 46, 86,106, 87, 85, 90, 53, 89, 91 };
+   uint32_t hash = 5387;
+   size_t i;
+   int rval;
 
    if( *buff == '/')       /* closing tag */
       {
@@ -303,10 +329,12 @@ static int find_tag( const char *buff, size_t len)
       len--;
       }
    if( !memcmp( buff, "ades", 4))
-      rval = 0;
-   for( i = 0; tags[i] && rval == -1; i++)
-      if( !memcmp( tags[i], buff, len) && !tags[i][len])
-         rval = i + 1;
+      return( 0);
+   for( i = 0; i < len; i++)
+      hash = (hash * 33) ^ (uint32_t)(unsigned char)buff[i];
+   rval = slots[((hash >> 8) ^ displacement[hash & 63]) & 0xff];
+   if( !rval || strncmp( tags[rval - 1], buff, len) || tags[rval - 1][len])
+      rval = -1;
    return( rval);
 }
 
@@ -813,6 +841,7 @@ static void setup_observation( ades2mpc_t *cptr)
    memset( cptr->line2, ' ', 80);
    strlcpy_err( cptr->line2 + 80, "\n", 2);
    cptr->line2[0] = '\0';
+   cptr->rms_dec[0] = cptr->corr[0] = '\0';
    cptr->id_set = 0;
    cptr->full_t2k = NOT_A_VALID_TIME;
 }
@@ -1147,3 +1176,540 @@ int fgets_with_ades_xlation( char *buff, const size_t len,
    cptr->prev_rval = prev_rval;
    return( prev_rval);
 }
+
+/* Translates all the lines in ibuff[0...ilen-1] (which needn't be
+null-terminated),  just as fgets_with_ades_xlation( ) would,  appending
+the output lines (each LF-terminated) to *obuff.  *obuff is a malloc()ed
+buffer,  possibly NULL at the start,  of *oalloced bytes,  of which *olen
+are used;  it's realloc()ed as needed.  Returns 0,  or -1 if memory ran
+out;  *obuff,  *olen and *oalloced then still describe the output so far,
+and the caller must still free *obuff.  With PSV data,  a fresh context
+that has been fed the PSV header line can translate any run of data
+lines;  so a big PSV file can be split up and translated in pieces,
+possibly in different threads.  */
+
+int xlate_ades2mpc_buffer( void *context, const char *ibuff, size_t ilen,
+                        char **obuff, size_t *olen, size_t *oalloced)
+{
+   char buff[1000];
+
+   while( ilen)
+      {
+      const char *eol = (const char *)memchr( ibuff, '\n', ilen);
+      size_t len = (eol ? (size_t)( eol - ibuff) : ilen), i = 0;
+
+      while( i < len && ibuff[i] != 13 && i < sizeof( buff) - 1)
+         i++;
+      memcpy( buff, ibuff, i);
+      while( i && buff[i - 1] == ' ')
+         i--;           /* drop trailing spaces */
+      buff[i] = '\0';
+      if( eol)
+         len++;
+      ibuff += len;
+      ilen -= len;
+      while( xlate_ades2mpc_in_place( context, buff))
+         {
+         size_t out_len = 0;
+
+         while( buff[out_len] && buff[out_len] != 10 && buff[out_len] != 13)
+            out_len++;
+         if( *olen + out_len + 1 > *oalloced)
+            {
+            const size_t new_alloced = 2 * (*olen + out_len + 1) + 4096;
+            char *new_obuff = (char *)realloc( *obuff, new_alloced);
+
+            if( !new_obuff)
+               return( -1);
+            *obuff = new_obuff;
+            *oalloced = new_alloced;
+            }
+         memcpy( *obuff + *olen, buff, out_len);
+         *olen += out_len;
+         (*obuff)[(*olen)++] = '\n';
+         }
+      }
+   return( 0);
+}
+
+/* The above translator turns ADES into (extended) 80-column text,  which
+the caller then usually has to parse again.  For big ADES files (Gaia or
+survey submissions running to millions of observations),  it's faster
+and loses less precision to skip the text stage.  The following reader
+takes ADES (PSV or XML) in chunks of any size -- a read() buffer,  a
+memory-mapped file,  whatever -- and hands each observation to a
+callback as an ades_obs_t.  Lines are processed in place within each
+chunk;  only a line split between two chunks gets copied.  Tags are
+looked up with the same perfect hash as above.  Anything that isn't
+ADES optical data (80-column astrometry,  headers,  other XML) is
+skipped.
+
+   The callback should return zero to keep going.  A non-zero return
+stops the reader,  and gets returned by ades_reader_feed( ).   */
+
+typedef struct
+{
+   ades_obs_callback_t callback;
+   void *user_data;
+   ades_obs_t obs;
+   int depth, tags[MAX_DEPTH];
+   int n_psv_fields, *psv_tags;
+   bool in_optical;
+   char *partial;
+   size_t partial_len, partial_alloced;
+   long n_obs;
+   int rval;
+} ades_reader_t;
+
+void *init_ades_reader( ades_obs_callback_t callback, void *user_data)
+{
+   ades_reader_t *rval = (ades_reader_t *)calloc( 1, sizeof( ades_reader_t));
+
+   if( rval)
+      {
+      rval->callback = callback;
+      rval->user_data = user_data;
+      }
+   return( rval);
+}
+
+static void copy_ades_field( char *ostr, const size_t ostr_size,
+                             const char *iptr, size_t len)
+{
+   if( len >= ostr_size)
+      len = ostr_size - 1;
+   memcpy( ostr, iptr, len);
+   ostr[len] = '\0';
+}
+
+/* ADES times are nearly always of the form 'YYYY-MM-DDThh:mm:ss.sss'
+(with any number of decimals),  and can be parsed much faster than the
+general-purpose get_time_from_stringl( ) manages.  Returns false for
+anything else (including leap seconds),  which then goes the slow way. */
+
+static bool fast_ades_time( const char *tptr, long double *t2k)
+{
+   const char *format = "dddd-dd-ddTdd:dd:dd";
+   int i, fields[6], n_fields = 0;
+   long double frac = 0., scale = 1.;
+
+   fields[0] = 0;
+   for( i = 0; format[i]; i++)
+      if( format[i] == 'd')
+         {
+         if( tptr[i] < '0' || tptr[i] > '9')
+            return( false);
+         fields[n_fields] = fields[n_fields] * 10 + tptr[i] - '0';
+         }
+      else if( tptr[i] != format[i])
+         return( false);
+      else
+         fields[++n_fields] = 0;
+   tptr += i;
+   if( *tptr == '.')
+      while( *++tptr >= '0' && *tptr <= '9')
+         {
+         scale *= 0.1;
+         frac += scale * (long double)( *tptr - '0');
+         }
+   if( *tptr || fields[1] < 1 || fields[1] > 12 || fields[2] < 1
+            || fields[2] > 31 || fields[3] > 23 || fields[4] > 59
+            || fields[5] > 59)
+      return( false);
+   *t2k = (long double)( dmy_to_day( fields[2], fields[1], (long)fields[0], 0)
+                  - 2451545L) - 0.5
+            + ((long double)( fields[3] * 3600 + fields[4] * 60 + fields[5])
+                  + frac) / 86400.;
+   return( true);
+}
+
+static void set_ades_field( ades_obs_t *obs, const int itag,
+                             const char *tptr, const size_t len)
+{
+   char name[80];
+
+   copy_ades_field( name, sizeof( name), tptr, len);
+   switch( itag)
+      {
+      case ADES_obsTime:
+         {
+         char *zptr = strchr( name, 'Z');
+
+         if( zptr)
+            *zptr = '\0';
+         if( !fast_ades_time( name, &obs->t2k))
+            obs->t2k = get_time_from_stringl( 0., name, 0, NULL);
+         obs->jd = (double)obs->t2k + 2451545.;
+         }
+         break;
+      case ADES_ra:
+         obs->ra = atof( name);
+         break;
+      case ADES_dec:
+         obs->dec = atof( name);
+         break;
+      case ADES_rmsRA:
+         obs->rms_ra = atof( name);
+         break;
+      case ADES_rmsDec:
+         obs->rms_dec = atof( name);
+         break;
+      case ADES_rmsCorr:
+         obs->rms_corr = atof( name);
+         break;
+      case ADES_rmsTime:
+         obs->rms_time = atof( name);
+         break;
+      case ADES_mag:
+         obs->mag = atof( name);
+         break;
+      case ADES_rmsMag:
+         obs->rms_mag = atof( name);
+         break;
+      case ADES_pos1:
+      case ADES_pos2:
+      case ADES_pos3:
+         obs->pos[itag - ADES_pos1] = atof( name);
+         break;
+      case ADES_stn:
+         copy_ades_field( obs->stn, sizeof( obs->stn), tptr, len);
+         break;
+      case ADES_permID:
+         copy_ades_field( obs->perm_id, sizeof( obs->perm_id), tptr, len);
+         break;
+      case ADES_provID:
+         copy_ades_field( obs->prov_id, sizeof( obs->prov_id), tptr, len);
+         break;
+      case ADES_artSat:
+         copy_ades_field( obs->art_sat, sizeof( obs->art_sat), tptr, len);
+         break;
+      case ADES_trkSub:
+         copy_ades_field( obs->trk_sub, sizeof( obs->trk_sub), tptr, len);
+         break;
+      case ADES_obsID:
+         copy_ades_field( obs->obs_id, sizeof( obs->obs_id), tptr, len);
+         break;
+      case ADES_trkID:
+         copy_ades_field( obs->trk_id, sizeof( obs->trk_id), tptr, len);
+         break;
+      case ADES_mode:
+         copy_ades_field( obs->mode, sizeof( obs->mode), tptr, len);
+         break;
+      case ADES_band:
+         copy_ades_field( obs->band, sizeof( obs->band), tptr, len);
+         break;
+      case ADES_astCat:
+         copy_ades_field( obs->ast_cat, sizeof( obs->ast_cat), tptr, len);
+         break;
+      case ADES_notes:
+         copy_ades_field( obs->notes, sizeof( obs->notes), tptr, len);
+         break;
+      case ADES_sys:
+         copy_ades_field( obs->sys, sizeof( obs->sys), tptr, len);
+         break;
+      case ADES_ctr:
+         copy_ades_field( obs->ctr, sizeof( obs->ctr), tptr, len);
+         break;
+      case ADES_disc:
+         obs->disc = *tptr;
+         break;
+      default:
+         break;
+      }
+}
+
+static void emit_ades_obs( ades_reader_t *rptr)
+{
+   rptr->n_obs++;
+   if( rptr->callback)
+      rptr->rval = rptr->callback( rptr->user_data, &rptr->obs);
+}
+
+static const char *skip_whitespace_n( const char *tptr, const char *end)
+{
+   while( tptr < end && (unsigned char)*tptr <= ' ')
+      tptr++;
+   return( tptr);
+}
+
+static size_t count_psv_fields( const char *line, const char *end)
+{
+   size_t n_fields = 1;
+
+   while( (line = (const char *)memchr( line, '|', end - line)) != NULL)
+      {
+      line++;
+      n_fields++;
+      }
+   return( n_fields);
+}
+
+/* Returns the number of fields if 'line' (of 'len' bytes,  not necessarily
+null-terminated) is a PSV header,  else zero.  Same rules as
+check_for_psv_header( ) :  at least MIN_PSV_TAGS fields,  each of which
+starts with a lowercase letter.  */
+
+int psv_header_field_count( const char *line, const size_t len)
+{
+   const char *end = line + len;
+   const char *tptr = skip_whitespace_n( line, end);
+   size_t i, n_fields;
+
+   if( tptr == end || *tptr < 'a' || *tptr > 'z')
+      return( 0);          /* quick rejection of most non-header lines */
+   n_fields = count_psv_fields( line, end);
+   if( n_fields < MIN_PSV_TAGS)
+      return( 0);
+   for( i = 0; i < n_fields; i++)
+      {
+      tptr = skip_whitespace_n( tptr, end);
+      if( tptr == end || *tptr < 'a' || *tptr > 'z')
+         return( 0);
+      tptr = (const char *)memchr( tptr, '|', end - tptr);
+      if( tptr)
+         tptr++;
+      }
+   return( (int)n_fields);
+}
+
+   /* Returns 1 if 'line' was a PSV header (now stored in rptr),  0 if it
+   wasn't,  or -1 if memory ran out.   */
+
+static int read_psv_header( ades_reader_t *rptr, const char *line,
+                                                  const char *end)
+{
+   const size_t n_fields = (size_t)psv_header_field_count( line, end - line);
+   const char *tptr;
+   size_t i;
+
+   if( !n_fields)
+      return( 0);
+   free( rptr->psv_tags);
+   rptr->psv_tags = (int *)malloc( n_fields * sizeof( int));
+   if( !rptr->psv_tags)
+      {
+      rptr->n_psv_fields = 0;
+      return( -1);
+      }
+   rptr->n_psv_fields = (int)n_fields;
+   tptr = line;
+   for( i = 0; i < n_fields; i++)
+      {
+      size_t len = 0;
+
+      tptr = skip_whitespace_n( tptr, end);
+      while( tptr + len < end && tptr[len] != '|' && tptr[len] > ' ')
+         len++;
+      rptr->psv_tags[i] = find_tag( tptr, len);
+      tptr = (const char *)memchr( tptr, '|', end - tptr);
+      if( tptr)
+         tptr++;
+      }
+   return( 1);
+}
+
+static void read_psv_line( ades_reader_t *rptr, const char *line,
+                                                const char *end)
+{
+   int i;
+
+   memset( &rptr->obs, 0, sizeof( ades_obs_t));
+   for( i = 0; i < rptr->n_psv_fields; i++)
+      {
+      const char *field_end = (const char *)memchr( line, '|', end - line);
+      const char *tptr = skip_whitespace_n( line, end);
+      size_t len;
+
+      if( !field_end)
+         field_end = end;
+      len = (tptr < field_end ? field_end - tptr : 0);
+      while( len && (unsigned char)tptr[len - 1] <= ' ')
+         len--;
+      if( len && rptr->psv_tags[i] > 0)
+         set_ades_field( &rptr->obs, rptr->psv_tags[i], tptr, len);
+      line = field_end + 1;
+      }
+   emit_ades_obs( rptr);
+}
+
+/* XML is handled much as xlate_ades2mpc( ) does it :  we keep a stack of
+open tags,  and text between tags is assigned to the innermost one.  A
+closing </optical> tag means we've an observation to hand out.   */
+
+static int read_xml_line( ades_reader_t *rptr, const char *line,
+                                                const char *end)
+{
+   line = skip_whitespace_n( line, end);
+   while( line < end && !rptr->rval)
+      {
+      if( *line == '<')
+         {
+         const char *close = (const char *)memchr( line, '>', end - line);
+         int tag_idx;
+
+         if( !close)
+            return( ADES_MALFORMED_TAG);
+         tag_idx = find_tag( line + 1, close - line - 1);
+         if( tag_idx >= 0)
+            {
+            if( line[1] == '/')
+               {
+               rptr->depth--;
+               if( rptr->depth < 0 || rptr->tags[rptr->depth] != tag_idx)
+                  return( ADES_CLOSING_UNOPENED_TAG);
+               }
+            else
+               {
+               rptr->tags[rptr->depth++] = tag_idx;
+               if( rptr->depth == MAX_DEPTH)
+                  return( ADES_DEPTH_MAX);
+               }
+            if( tag_idx == ADES_optical)
+               {
+               if( line[1] != '/')
+                  memset( &rptr->obs, 0, sizeof( ades_obs_t));
+               else
+                  emit_ades_obs( rptr);
+               rptr->in_optical = (line[1] != '/');
+               }
+            }
+         line = close + 1;
+         }
+      else
+         {
+         const char *tptr = (const char *)memchr( line, '<', end - line);
+         size_t len;
+
+         if( !tptr)
+            tptr = end;
+         len = tptr - line;
+         while( len && (unsigned char)line[len - 1] <= ' ')
+            len--;
+         if( rptr->in_optical && rptr->depth && len)
+            set_ades_field( &rptr->obs, rptr->tags[rptr->depth - 1],
+                                    line, len);
+         line = tptr;
+         }
+      line = skip_whitespace_n( line, end);
+      }
+   return( 0);
+}
+
+static int read_ades_line( ades_reader_t *rptr, const char *line,
+                                                size_t len)
+{
+   const char *end;
+
+   while( len && (line[len - 1] == 13 || line[len - 1] == ' '))
+      len--;
+   end = line + len;
+   if( rptr->depth || memchr( line, '<', len))
+      return( read_xml_line( rptr, line, end));
+   switch( read_psv_header( rptr, line, end))
+      {
+      case 1:
+         return( 0);
+      case -1:
+         return( -1);
+      }
+   if( rptr->psv_tags)
+      {
+      if( count_psv_fields( line, end) == (size_t)rptr->n_psv_fields)
+         read_psv_line( rptr, line, end);
+      else if( len && *line != '#' && *line != '!')
+         {              /* we've reached the end of a PSV data section */
+         free( rptr->psv_tags);
+         rptr->psv_tags = NULL;
+         rptr->n_psv_fields = 0;
+         }
+      }
+   return( 0);
+}
+
+/* Feeds 'len' bytes of ADES to the reader.  Returns zero if all went
+well,  a non-zero value from the callback if it asked to stop,  -1 if
+memory ran out,  or one of the negative ADES_* error codes.  */
+
+int ades_reader_feed( void *reader, const char *buff, size_t len)
+{
+   ades_reader_t *rptr = (ades_reader_t *)reader;
+   int err_code = 0;
+
+   while( len && !rptr->rval && !err_code)
+      {
+      const char *eol = (const char *)memchr( buff, '\n', len);
+      const size_t line_len = (eol ? (size_t)( eol - buff) : len);
+
+      if( rptr->partial_len || !eol)
+         {        /* line straddles chunks;  gather it in 'partial' */
+         if( rptr->partial_len + line_len > rptr->partial_alloced)
+            {
+            const size_t new_alloced = 2 * (rptr->partial_len + line_len) + 400;
+            char *new_partial = (char *)realloc( rptr->partial, new_alloced);
+
+            if( !new_partial)
+               return( -1);
+            rptr->partial = new_partial;
+            rptr->partial_alloced = new_alloced;
+            }
+         memcpy( rptr->partial + rptr->partial_len, buff, line_len);
+         rptr->partial_len += line_len;
+         if( eol)
+            {
+            err_code = read_ades_line( rptr, rptr->partial,
+                                             rptr->partial_len);
+            rptr->partial_len = 0;
+            }
+         }
+      else
+         err_code = read_ades_line( rptr, buff, line_len);
+      buff += line_len + (eol ? 1 : 0);
+      len -= line_len + (eol ? 1 : 0);
+      }
+   return( err_code ? err_code : rptr->rval);
+}
+
+/* Handles any final unterminated line,  frees the reader,  and returns
+the number of observations found.  */
+
+long free_ades_reader( void *reader)
+{
+   ades_reader_t *rptr = (ades_reader_t *)reader;
+   long rval;
+
+   if( rptr->partial_len && !rptr->rval)
+      read_ades_line( rptr, rptr->partial, rptr->partial_len);
+   rval = rptr->n_obs;
+   free( rptr->partial);
+   free( rptr->psv_tags);
+   free( rptr);
+   return( rval);
+}
+
+/* Convenience function to read an entire file through the above.
+Returns the number of observations,  or a negative error code.  */
+
+#define ADES_READ_CHUNK_SIZE    65536
+
+long read_ades_file( FILE *ifile, ades_obs_callback_t callback,
+                                             void *user_data)
+{
+   void *reader = init_ades_reader( callback, user_data);
+   char *buff = (char *)malloc( ADES_READ_CHUNK_SIZE);
+   size_t bytes_read;
+   int err_code = 0;
+   long rval;
+
+   if( !reader || !buff)
+      {
+      free( reader);
+      free( buff);
+      return( -1);
+      }
+   while( !err_code
+          && (bytes_read = fread( buff, 1, ADES_READ_CHUNK_SIZE, ifile)) > 0)
+      err_code = ades_reader_feed( reader, buff, bytes_read);
+   free( buff);
+   rval = free_ades_reader( reader);
+   return( err_code < 0 ? (long)err_code : rval);
+}
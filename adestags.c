@@ -1,15 +1,101 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 /* See 'ades2mpc.cpp'.  This takes a list of ADES tags,  in the order
 specified in the documentation,  and produces arrays suitable for use
-in 'ades2mpc.cpp'.  It also sorts the tags;  this will allow for a
-binary search,  gaining 0.001% (probably) in speed.
+in 'ades2mpc.cpp'.  It also sorts the tags,  and then finds a perfect
+hash for them :  a 'displacement' table of N_BUCKETS bytes and a 'slots'
+table of N_SLOTS bytes,  such that
 
-2022 Aug 02 : added shapeOcc, obsSubID, trkMPC elements.    */
+hash = seed;  for each char c,  hash = hash * 33 ^ c;
+slot = ((hash >> 8) ^ displacement[hash % N_BUCKETS]) % N_SLOTS;
+
+   puts each tag in a slot of its own.  This is the usual 'hash and
+displace' scheme :  we try seeds until no two tags in a bucket collide
+in the (hash >> 8) bits,  then place buckets in order of decreasing
+size,  trying displacements until all of a bucket's tags land in
+empty slots.
+
+2022 Aug 02 : added shapeOcc, obsSubID, trkMPC elements.
+2026 Oct 15 : added the perfect hash.    */
 
 #define INTENTIONALLY_UNUSED_PARAMETER( param) (void)(param)
 
+#define N_BUCKETS    64
+#define N_SLOTS     256
+#define MAX_TAGS    200
+
+static uint32_t tag_hash( const char *tag, const uint32_t seed)
+{
+   uint32_t hash = seed;
+
+   while( *tag)
+      hash = (hash * 33) ^ (uint32_t)(unsigned char)*tag++;
+   return( hash);
+}
+
+/* Returns 0 if 'seed' gives a perfect hash,  filling the tables;  -1 if not. */
+
+static int try_seed( const char **tags, const uint32_t seed,
+               unsigned char *displacement, unsigned char *slots)
+{
+   uint32_t hashes[MAX_TAGS];
+   int bucket_size[N_BUCKETS], i, j, b, n_tags;
+
+   memset( bucket_size, 0, sizeof( bucket_size));
+   memset( displacement, 0, N_BUCKETS);
+   memset( slots, 0, N_SLOTS);
+   for( n_tags = 0; tags[n_tags]; n_tags++)
+      {
+      hashes[n_tags] = tag_hash( tags[n_tags], seed);
+      bucket_size[hashes[n_tags] % N_BUCKETS]++;
+      for( j = 0; j < n_tags; j++)
+         if( hashes[j] % N_BUCKETS == hashes[n_tags] % N_BUCKETS
+              && (hashes[j] >> 8) % N_SLOTS == (hashes[n_tags] >> 8) % N_SLOTS)
+            return( -1);
+      }
+   while( 1)
+      {
+      int biggest = 0, displace;
+
+      for( b = 1; b < N_BUCKETS; b++)
+         if( bucket_size[b] > bucket_size[biggest])
+            biggest = b;
+      if( !bucket_size[biggest])
+         return( 0);          /* all buckets placed */
+      for( displace = 0; displace < N_SLOTS; displace++)
+         {
+         int fits = 1;
+
+         for( i = 0; fits && i < n_tags; i++)
+            if( hashes[i] % N_BUCKETS == (uint32_t)biggest
+                     && slots[((hashes[i] >> 8) ^ displace) % N_SLOTS])
+               fits = 0;
+         if( fits)
+            break;
+         }
+      if( displace == N_SLOTS)
+         return( -1);
+      displacement[biggest] = (unsigned char)displace;
+      for( i = 0; i < n_tags; i++)
+         if( hashes[i] % N_BUCKETS == (uint32_t)biggest)
+            slots[((hashes[i] >> 8) ^ displace) % N_SLOTS] = (unsigned char)( i + 1);
+      bucket_size[biggest] = 0;
+      }
+}
+
+static void show_table( const char *name, const unsigned char *table,
+                        const int n_entries)
+{
+   int i;
+
+   printf( "   static const unsigned char %s[%d] = {", name, n_entries);
+   for( i = 0; i < n_entries; i++)
+      printf( "%s%3d%s", (i % 16 ? "" : "\n       "), table[i],
+                           (i == n_entries - 1 ? " };\n" : ","));
+}
+
 int main( const int intentionally_unused_argc,
           const char **intentionally_unused_argv)
 {
@@ -53,6 +139,8 @@ int main( const int intentionally_unused_argc,
          "rmsTime",
          NULL };
    size_t i, j;
+   uint32_t seed = 5381;
+   unsigned char displacement[N_BUCKETS], slots[N_SLOTS];
 
    INTENTIONALLY_UNUSED_PARAMETER( intentionally_unused_argv);
    INTENTIONALLY_UNUSED_PARAMETER( intentionally_unused_argc);
@@ -78,11 +166,15 @@ int main( const int intentionally_unused_argc,
          printf( "\n       ");
          j = 0;
          }
-      printf( "\"%s\", ", tags[i]);
+      printf( "\"%s\"%s", tags[i], (tags[i + 1] ? ", " : " };\n"));
       j += len;
       }
 
-   printf( "\n   NULL };\n\n");
+   while( try_seed( tags, seed, displacement, slots))
+      seed++;
+   show_table( "displacement", displacement, N_BUCKETS);
+   show_table( "slots", slots, N_SLOTS);
+   printf( "   uint32_t hash = %u;\n\n", (unsigned)seed);
    for( i = 0; tags[i]; i++)
       printf( "#define ADES_%-27s%4d\n", tags[i], (int)i + 1);
    return( 0);
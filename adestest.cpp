@@ -1,6 +1,17 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+   #define WIN32_LEAN_AND_MEAN
+   #include <windows.h>
+#elif !defined( __WATCOMC__)
+   #include <pthread.h>
+#endif
+#include "watdefs.h"
+#include "date.h"
+#include "afuncs.h"
 #include "mpc_func.h"
 
 /* Given the name of a file containing XML or PSV ADES data as a command
@@ -17,28 +28,449 @@ the 80-column format knows nothing about) are stored in COM (comment)
 lines.  Dates/times are stored in a compacted form to allow millisecond
 precision (the usual MPC format allows only 10^-6 day = 86.4 ms
 precision).  The resulting "80-column data" will work with all of my
-tools,  but probably not with anyone else's. */
+tools,  but probably not with anyone else's.
+
+   With '-s',  the file is instead read with read_ades_file( ),  which
+skips the 80-column stage and hands out structured ades_obs_t records;
+these are shown one per line.
+
+   With '-t(n)',  the file is read into memory and translated using 'n'
+threads (see xlate_in_parallel( ) below);  output should be identical
+to that from the usual line-at-a-time translation.  '-B(n)' runs a
+benchmark on 'n' lines of synthetic PSV data (no input file needed),
+timing the line-at-a-time translation against one and 'n' threads and
+checking that all give the same output.  */
+
+static int show_ades_obs( void *user_data, const ades_obs_t *obs)
+{
+   const char *desig = (obs->perm_id[0] ? obs->perm_id :
+               (obs->prov_id[0] ? obs->prov_id :
+               (obs->art_sat[0] ? obs->art_sat : obs->trk_sub)));
+
+   printf( "%-12s %s %.9f %11.7f %+11.7f %6.3f %6.3f %6.3f %5.2f %s\n",
+            desig, obs->stn, obs->jd, obs->ra, obs->dec,
+            obs->rms_ra, obs->rms_dec, obs->rms_corr, obs->mag, obs->band);
+   (*(long *)user_data)++;
+   return( 0);
+}
+
+/* PSV data lines can be translated independently of each other,  once
+the PSV header has been read.  So for a big PSV file,  we translate
+everything up to and including the PSV header in the usual way,  then
+split the data lines into CHUNK_SIZE pieces at line boundaries.  Each
+thread gets a fresh context,  feeds it the PSV header,  and translates
+its chunk into its own buffer.  We run 'n_threads' chunks at a time and
+write out their results in input order.
+
+   If a chunk turns out to hold something other than PSV data lines --
+a blank line,  a new PSV header,  or lines with a different number of
+fields -- we translate from the start of that chunk onward in the
+usual single-threaded way,  so the output is exactly what the
+line-at-a-time translation would produce.
+
+   Output is written to 'ofile' (if non-NULL),  and a hash of it is
+accumulated so that outputs can be compared in benchmarking.  */
+
+#define CHUNK_SIZE (8 << 20)
+#define MAX_THREADS   64
+
+typedef struct
+{
+   const char *psv_header, *ibuff;
+   size_t psv_header_len, ilen;
+   char *obuff;
+   size_t olen, oalloced;
+   int n_fields;
+   bool irregular;
+} xlate_chunk_t;
+
+static void output_text( FILE *ofile, const char *text, const size_t len,
+                           uint64_t *hash, size_t *n_bytes)
+{
+   size_t i;
+
+   if( ofile)
+      fwrite( text, len, 1, ofile);
+   for( i = 0; i < len; i++)        /* FNV-1a */
+      *hash = (*hash ^ (uint64_t)(unsigned char)text[i]) * 0x100000001b3ull;
+   *n_bytes += len;
+}
+
+static bool all_psv_data( const char *buff, size_t len, const int n_fields)
+{
+   while( len)
+      {
+      const char *eol = (const char *)memchr( buff, '\n', len);
+      const size_t line_len = (eol ? (size_t)( eol - buff) + 1 : len);
+      const char *tptr = buff, *end = buff + line_len;
+      int n_found = 1;
+
+      while( (tptr = (const char *)memchr( tptr, '|', end - tptr)) != NULL)
+         {
+         tptr++;
+         n_found++;
+         }
+      if( n_found != n_fields || psv_header_field_count( buff, line_len))
+         return( false);
+      buff += line_len;
+      len -= line_len;
+      }
+   return( true);
+}
+
+static void xlate_chunk( xlate_chunk_t *chunk)
+{
+   void *context = init_ades2mpc( );
+   int err_code = 0;
+
+   assert( context);
+   chunk->olen = 0;
+   chunk->irregular = !all_psv_data( chunk->ibuff, chunk->ilen,
+                                     chunk->n_fields);
+   if( !chunk->irregular)
+      {
+      err_code = xlate_ades2mpc_buffer( context, chunk->psv_header,
+                                 chunk->psv_header_len, &chunk->obuff,
+                                 &chunk->olen, &chunk->oalloced);
+      if( !err_code)
+         err_code = xlate_ades2mpc_buffer( context, chunk->ibuff,
+                                 chunk->ilen, &chunk->obuff,
+                                 &chunk->olen, &chunk->oalloced);
+      }
+   assert( !err_code);
+   free_ades2mpc_context( context);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI xlate_thread( LPVOID arg)
+{
+   xlate_chunk( (xlate_chunk_t *)arg);
+   return( 0);
+}
+#elif !defined( __WATCOMC__)
+static void *xlate_thread( void *arg)
+{
+   xlate_chunk( (xlate_chunk_t *)arg);
+   return( NULL);
+}
+#endif
+
+static void run_chunks( xlate_chunk_t *chunks, const int n_chunks)
+{
+   int i;
+
+   if( n_chunks == 1)
+      xlate_chunk( chunks);
+#ifdef _WIN32
+   else
+      {
+      HANDLE threads[MAX_THREADS];
+
+      for( i = 0; i < n_chunks; i++)
+         {
+         threads[i] = CreateThread( NULL, 0, xlate_thread, chunks + i, 0, NULL);
+         if( !threads[i])        /* couldn't create a thread;  do it here */
+            xlate_chunk( chunks + i);
+         }
+      for( i = 0; i < n_chunks; i++)
+         if( threads[i])
+            {
+            WaitForSingleObject( threads[i], INFINITE);
+            CloseHandle( threads[i]);
+            }
+      }
+#elif !defined( __WATCOMC__)
+   else
+      {
+      pthread_t threads[MAX_THREADS];
+      bool started[MAX_THREADS];
+
+      for( i = 0; i < n_chunks; i++)
+         {
+         started[i] = !pthread_create( threads + i, NULL, xlate_thread,
+                                       chunks + i);
+         if( !started[i])        /* couldn't create a thread;  do it here */
+            xlate_chunk( chunks + i);
+         }
+      for( i = 0; i < n_chunks; i++)
+         if( started[i])
+            pthread_join( threads[i], NULL);
+      }
+#else
+   else
+      for( i = 0; i < n_chunks; i++)
+         xlate_chunk( chunks + i);
+#endif
+}
+
+static const char *end_of_line( const char *tptr, const char *end)
+{
+   tptr = (const char *)memchr( tptr, '\n', end - tptr);
+   return( tptr ? tptr + 1 : end);
+}
+
+static int xlate_in_parallel( const char *ibuff, const size_t ilen,
+                  FILE *ofile, int n_threads, uint64_t *hash, size_t *n_bytes)
+{
+   void *context = init_ades2mpc( );
+   const char *tptr = ibuff, *end = ibuff + ilen;
+   const char *psv_header = NULL;
+   char *obuff = NULL;
+   size_t olen = 0, oalloced = 0;
+   int i, n_fields = 0;
+   xlate_chunk_t chunks[MAX_THREADS];
+
+   assert( context);
+   if( n_threads > MAX_THREADS)
+      n_threads = MAX_THREADS;
+   memset( chunks, 0, sizeof( chunks));
+   while( tptr < end && !n_fields)
+      {
+      const char *eol = end_of_line( tptr, end);
+
+      n_fields = psv_header_field_count( tptr, eol - tptr);
+      if( n_fields)
+         psv_header = tptr;
+      tptr = eol;
+      }
+   if( !n_fields)          /* not PSV;  we'll do it all in the usual way */
+      tptr = ibuff;
+   xlate_ades2mpc_buffer( context, ibuff, tptr - ibuff, &obuff, &olen,
+                                          &oalloced);
+   output_text( ofile, obuff, olen, hash, n_bytes);
+   while( n_fields && tptr < end)
+      {
+      int n_chunks;
+
+      for( n_chunks = 0; n_chunks < n_threads && tptr < end; n_chunks++)
+         {
+         const char *chunk_end = (end - tptr > CHUNK_SIZE ?
+                        end_of_line( tptr + CHUNK_SIZE, end) : end);
+
+         chunks[n_chunks].psv_header = psv_header;
+         chunks[n_chunks].psv_header_len = end_of_line( psv_header, end)
+                                             - psv_header;
+         chunks[n_chunks].n_fields = n_fields;
+         chunks[n_chunks].ibuff = tptr;
+         chunks[n_chunks].ilen = chunk_end - tptr;
+         tptr = chunk_end;
+         }
+      run_chunks( chunks, n_chunks);
+      for( i = 0; i < n_chunks && !chunks[i].irregular; i++)
+         output_text( ofile, chunks[i].obuff, chunks[i].olen, hash, n_bytes);
+      if( i < n_chunks)       /* irregular chunk;  carry on with */
+         {                    /* the usual single-threaded way */
+         tptr = chunks[i].ibuff;
+         n_fields = 0;
+         }
+      }
+   while( tptr < end)      /* whatever's left after 'irregular' data */
+      {
+      const char *chunk_end = (end - tptr > CHUNK_SIZE ?
+                        end_of_line( tptr + CHUNK_SIZE, end) : end);
+
+      olen = 0;
+      xlate_ades2mpc_buffer( context, tptr, chunk_end - tptr, &obuff,
+                                             &olen, &oalloced);
+      output_text( ofile, obuff, olen, hash, n_bytes);
+      tptr = chunk_end;
+      }
+   for( i = 0; i < MAX_THREADS; i++)
+      free( chunks[i].obuff);
+   free( obuff);
+   return( free_ades2mpc_context( context));
+}
+
+/* Makes 'n_lines' of PSV data,  with a mix of numbered and provisional
+designations,  overlong RA/decs,  and uncertainties with and without
+correlations,  so that most of the translator gets exercised.  */
+
+static char *make_synthetic_psv( const long n_lines, size_t *len)
+{
+   const char *header =
+            "# version=2017\n# observatory\n! mpcCode T05\n"
+            "# submitter\n! name Synthetic Data\n"
+            "permID |provID     |trkSub  |mode|stn |obsTime"
+            "                    |ra          |dec         |rmsRA|rmsDec"
+            "|rmsCorr|astCat|mag  |rmsMag|band|remarks\n";
+   const char *stations = "T05T08F51G96703I41";
+   const size_t line_size = 200;
+   char *rval = (char *)malloc( strlen( header) + n_lines * line_size);
+   char *tptr = rval;
+   uint32_t seed = 12345;
+   long i;
+
+   assert( rval);
+   strcpy( rval, header);
+   tptr += strlen( header);
+   for( i = 0; i < n_lines; i++)
+      {
+      const double t = 8000. + (double)i * 1e-4;
+      const int day = (int)t, sec = (int)( (t - (double)day) * 86400.);
+      long year;
+      int month, n_written;
+      const double dday = decimal_day_to_dmy( 2451545. + (double)day,
+                                       &year, &month, CALENDAR_JULIAN_GREGORIAN);
+      char perm_id[10], prov_id[12], corr[8];
+
+      seed = seed * 1103515245u + 12345u;
+      *perm_id = *prov_id = *corr = '\0';
+      if( seed % 3 == 0)
+         snprintf( perm_id, sizeof( perm_id), "%u", (seed >> 8) % 600000 + 1);
+      else
+         snprintf( prov_id, sizeof( prov_id), "20%02u %c%c%u",
+                  (seed >> 4) % 25, 'A' + (seed >> 9) % 24,
+                  'A' + (seed >> 14) % 25, (seed >> 19) % 300);
+      if( seed & 0x100)
+         snprintf( corr, sizeof( corr), "%.3f", (double)( seed % 2000) / 1000. - 1.);
+      n_written = snprintf( tptr, line_size,
+               "%-7s|%-11s|a%07u| CCD|%.3s |%04ld-%02d-%02dT%02d:%02d:%02d.%03uZ"
+               "|%12.8f|%+12.8f|%5.3f|%6.3f|%7s|Gaia2 |%5.2f|%6.2f|%-4c|\n",
+               perm_id, prov_id, (seed >> 3) % 10000000,
+               stations + 3 * ((seed >> 7) % 6),
+               year, month, (int)dday, sec / 3600, (sec / 60) % 60,
+               sec % 60, (seed >> 5) % 1000,
+               (double)( seed % 3600000) / 10000.,
+               (double)( (seed >> 3) % 1700000) / 10000. - 85.,
+               (double)( (seed >> 11) % 500) / 1000. + .05,
+               (double)( (seed >> 13) % 500) / 1000. + .05, corr,
+               (double)( (seed >> 6) % 800) / 100. + 14.,
+               (double)( (seed >> 17) % 30) / 100. + .02,
+               "GVRrgiozw"[(seed >> 21) % 9]);
+      assert( n_written > 0 && (size_t)n_written < line_size);
+      tptr += n_written;
+      }
+   *len = tptr - rval;
+   return( rval);
+}
+
+static void benchmark( const long n_lines, const int n_threads)
+{
+   size_t len, n_bytes[3];
+   char *ibuff = make_synthetic_psv( n_lines, &len);
+   uint64_t hash[3];
+   FILE *ifile = tmpfile( );
+   void *ades_context = init_ades2mpc( );
+   char buff[400];
+   int64_t t0;
+   double run_time[3];
+   int i;
+
+   assert( ifile && ades_context);
+   fwrite( ibuff, len, 1, ifile);
+   fseek( ifile, 0L, SEEK_SET);
+   for( i = 0; i < 3; i++)
+      {
+      hash[i] = 0xcbf29ce484222325ull;
+      n_bytes[i] = 0;
+      }
+   printf( "%ld lines, %.1f MBytes of PSV\n", n_lines, (double)len / 1e+6);
+   t0 = nanoseconds_since_1970( );
+   while( fgets_with_ades_xlation( buff, sizeof( buff), ades_context, ifile))
+      {
+      strcat( buff, "\n");
+      output_text( NULL, buff, strlen( buff), hash, n_bytes);
+      }
+   run_time[0] = (double)( nanoseconds_since_1970( ) - t0) * 1e-9;
+   free_ades2mpc_context( ades_context);
+   fclose( ifile);
+   t0 = nanoseconds_since_1970( );
+   xlate_in_parallel( ibuff, len, NULL, 1, hash + 1, n_bytes + 1);
+   run_time[1] = (double)( nanoseconds_since_1970( ) - t0) * 1e-9;
+   t0 = nanoseconds_since_1970( );
+   xlate_in_parallel( ibuff, len, NULL, n_threads, hash + 2, n_bytes + 2);
+   run_time[2] = (double)( nanoseconds_since_1970( ) - t0) * 1e-9;
+   for( i = 0; i < 3; i++)
+      printf( "%-22s %7.3f s  %7.1f MB/s  %6.2f Mlines/s  %s\n",
+               (i == 0 ? "fgets_with_ades_xlation" : (i == 1 ? "buffer, 1 thread" : "buffer, threaded")),
+               run_time[i], (double)len / run_time[i] * 1e-6,
+               (double)n_lines / run_time[i] * 1e-6,
+               (hash[i] == hash[0] && n_bytes[i] == n_bytes[0] ?
+                              "output matches" : "OUTPUT DIFFERS"));
+   printf( "%d threads;  speedup %.2f over line-at-a-time\n", n_threads,
+                  run_time[0] / run_time[2]);
+   free( ibuff);
+}
 
 int main( const int argc, const char **argv)
 {
-   FILE *ifile = fopen( argv[1], "rb");
+   FILE *ifile;
    char buff[400];
-   void *ades_context = init_ades2mpc( );
-   int i, rval, show_data = 0;
+   void *ades_context;
+   const char *filename = NULL;
+   int i, rval, show_data = 0, structured = 0, n_threads = 0;
+   long n_benchmark_lines = 0;
 
-   assert( ifile);
-   assert( ades_context);
-   for( i = 2; i < argc; i++)
+   for( i = 1; i < argc; i++)
       if( argv[i][0] == '-')
          switch( argv[i][1])
             {
             case 'd':
                show_data = 1;
                break;
+            case 's':
+               structured = 1;
+               break;
+            case 't':
+               n_threads = atoi( argv[i] + 2);
+               break;
+            case 'B':
+               n_benchmark_lines = atol( argv[i] + 2);
+               break;
             default:
                fprintf( stderr, "'%s' not recognized\n", argv[i]);
                break;
             }
+      else if( !filename)
+         filename = argv[i];
+   if( n_benchmark_lines)
+      {
+      benchmark( n_benchmark_lines, (n_threads > 0 ? n_threads : 4));
+      return( 0);
+      }
+   if( !filename)
+      {
+      fprintf( stderr, "Usage: adestest (filename) [-d] [-s] [-t(n)]\n"
+                       "   or: adestest -B(n_lines) [-t(n)]\n");
+      return( -1);
+      }
+   ifile = fopen( filename, "rb");
+   ades_context = init_ades2mpc( );
+   assert( ifile);
+   assert( ades_context);
+   if( n_threads > 0)
+      {
+      size_t len, n_bytes = 0;
+      uint64_t hash = 0;
+      char *ibuff;
+
+      fseek( ifile, 0L, SEEK_END);
+      len = (size_t)ftell( ifile);
+      fseek( ifile, 0L, SEEK_SET);
+      ibuff = (char *)malloc( len + 1);
+      assert( ibuff);
+      if( len && !fread( ibuff, len, 1, ifile))
+         {
+         fprintf( stderr, "Couldn't read '%s'\n", filename);
+         return( -1);
+         }
+      fclose( ifile);
+      free_ades2mpc_context( ades_context);
+      rval = xlate_in_parallel( ibuff, len, stdout, n_threads, &hash, &n_bytes);
+      free( ibuff);
+      printf( "rval = %d\n", rval);
+      return( 0);
+      }
+   if( structured)
+      {
+      long n_found = 0;
+      const long n_read = read_ades_file( ifile, show_ades_obs, &n_found);
+
+      fclose( ifile);
+      free_ades2mpc_context( ades_context);
+      printf( "%ld observations read (%ld shown)\n", n_read, n_found);
+      return( n_read < 0 ? -1 : 0);
+      }
    while( fgets_with_ades_xlation( buff, sizeof( buff), ades_context, ifile))
       {
       printf( "%s\n", buff);
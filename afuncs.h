@@ -77,6 +77,16 @@ int DLL_FUNC setup_precession_with_nutation( double DLLPTR *matrix,
 int DLL_FUNC setup_precession_with_nutation_delta( double DLLPTR *matrix,
                     const double year,          /* precess.c */
              const double delta_nutation_lon, const double delta_nutation_obliq);
+         /* 'kind' for make_precession_interpolator( ) : */
+#define PRECESSION_ECLIPTIC       0   /* setup_ecliptic_precession( m, 2000., yr) */
+#define PRECESSION_EQUATORIAL     1   /* setup_precession( m, 2000., yr) */
+#define PRECESSION_WITH_NUTATION  2   /* setup_precession_with_nutation( m, yr) */
+
+void * DLL_FUNC make_precession_interpolator( const int kind,
+            const double year_start, const double year_end, double step);
+int DLL_FUNC free_precession_interpolator( void *interpolator);
+int DLL_FUNC interpolated_precession( const void *interpolator,
+                        const double year, double DLLPTR *matrix);
 int DLL_FUNC precess_vector( const double DLLPTR *matrix,
                                       const double DLLPTR *v1,
                                       double DLLPTR *v2);    /* precess.c */
@@ -29,6 +29,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 #else
    #include <sys/types.h>
    #include <unistd.h>
+   #ifndef __WATCOMC__
+      #include <pthread.h>
+      #include <sys/file.h>
+      #include <sys/mman.h>
+   #endif
 #endif
 #include "watdefs.h"
 #include "date.h"
@@ -44,30 +49,12 @@ const double radians_to_arcsec = 180. * 3600. / PI;
 int get_earth_loc( const double t_millennia, double *results);
 
 #if defined( __WATCOMC__) && !defined( _WIN32)
-void usleep( const long microseconds)
-{
-   INTENTIONALLY_UNUSED_PARAMETER( microseconds);
-}
-
 int getpid( void)
 {
    return( 1);
 }
 #endif
 
-static int get_mpc_data( const char *buff, double *jd, double *ra, double *dec)
-{
-   int err_code;
-
-   if( strlen( buff) < 80 || strlen( buff) > 83)
-      err_code = -5;
-   else
-      err_code = get_ra_dec_from_mpc_report( buff, NULL, ra, NULL,
-                                                NULL, dec, NULL);
-   *jd = extract_date_from_mpc_report( buff, NULL);
-   return( err_code);
-}
-
 static inline double law_of_cosines( const double a, const double b, const double c)
 {
    return( .5 * (a * a + b * b - c * c) / (a * b));
@@ -119,14 +106,18 @@ const char *data_path = NULL;
 char sof_header[MAX_SOF_SIZE];
 int32_t sof_checksum;
 
-static FILE *get_file_from_path( const char *filename, const char *permits)
+   /* Opens 'filename' in the data path,  if there is one,  else in
+   the current directory.  If 'path_used' is non-NULL,  it's set to the
+   name of the file actually opened.    */
+
+static FILE *get_file_from_path_ex( const char *filename, const char *permits,
+                                    char *path_used)
 {
    FILE *fp = NULL;
+   char buff[450];
 
    if( data_path && *data_path)
       {
-      char buff[450];
-
       strlcpy_error( buff, data_path);
       if( buff[strlen( buff) - 1] != '/')
          strlcat_error( buff, "/");
@@ -134,10 +125,158 @@ static FILE *get_file_from_path( const char *filename, const char *permits)
       fp = fopen( buff, permits);
       }
    if( !fp)
+      {
+      strlcpy_error( buff, filename);
       fp = fopen( filename, permits);
+      }
+   if( fp && path_used)
+      strcpy( path_used, buff);
    return( fp);
 }
 
+static FILE *get_file_from_path( const char *filename, const char *permits)
+{
+   return( get_file_from_path_ex( filename, permits, NULL));
+}
+
+static int process_id( void)
+{
+#ifdef _WIN32
+   return( (int)GetCurrentProcessId( ));
+#else
+   return( (int)getpid( ));
+#endif
+}
+
+   /* Cache files (.chk,  .idx,  compiled SOF) are written to a temporary
+   file which is then renamed,  so that other instances see either the
+   complete file or none at all.  (A crashed writer leaves only a stray
+   temporary file.)  Another instance may have beaten us to it;  if so,
+   on POSIX boxes,  the file is just replaced with an identical one.  On
+   Windows,  rename() fails if the target exists;  we then just delete
+   the temporary file.   */
+
+static FILE *create_temp_cache_file( const char *filename, char *temp_path)
+{
+   char temp_name[120];
+   FILE *ofile;
+
+   snprintf( temp_name, sizeof( temp_name), "%s%d.tmp", filename, process_id( ));
+   ofile = get_file_from_path_ex( temp_name, "w+b", temp_path);
+   if( !ofile)
+      {
+      fprintf( stderr, "Couldn't open '%s'\n", temp_name);
+      perror( "File open failure");
+      exit( -1);
+      }
+   return( ofile);
+}
+
+static void commit_temp_cache_file( FILE *ofile, const char *temp_path,
+                                    const char *filename, const bool ok)
+{
+   const char *tptr = strrchr( temp_path, '/');
+   char final_path[450];
+
+   if( fclose( ofile) || !ok)
+      {
+      remove( temp_path);
+      return;
+      }
+   strcpy( final_path, temp_path);
+   strcpy( final_path + (tptr ? tptr - temp_path + 1 : 0), filename);
+   if( rename( temp_path, final_path))
+      remove( temp_path);
+}
+
+/* Writers of .chk and .idx files hold an advisory lock on 'filename.lock'
+while building them.  Instances needing the same file then block on the
+lock until it's ready,  instead of all building it at once.  The lock is
+released when the file is closed,  or by the OS if the process dies.  The
+lock files are left in place;  removing them would open up races.  On
+Windows (and Watcom),  there's no locking;  instances may then duplicate
+each other's work,  but the rename() trick keeps that harmless.  */
+
+static FILE *lock_cache_file( const char *filename)
+{
+   FILE *rval = NULL;
+#if !defined( _WIN32) && !defined( __WATCOMC__)
+   char lock_name[120];
+
+   snprintf( lock_name, sizeof( lock_name), "%s.lock", filename);
+   rval = get_file_from_path( lock_name, "ab");
+   if( rval && flock( fileno( rval), LOCK_EX))
+      {
+      fclose( rval);
+      rval = NULL;
+      }
+#else
+   INTENTIONALLY_UNUSED_PARAMETER( filename);
+#endif
+   return( rval);
+}
+
+static void unlock_cache_file( FILE *lock_file)
+{
+   if( lock_file)
+      fclose( lock_file);
+}
+
+/* Completed cache files are mapped read-only and shared,  so that all
+astcheck instances running on a given day use one copy of the data (in
+the OS's page cache) instead of each reading in its own copy.  Windows
+just gets a malloc()ed copy.  Returns NULL if the file can't be read. */
+
+static void *map_open_file( FILE *ifile, size_t *size)
+{
+   void *rval = NULL;
+   long len;
+
+   fseek( ifile, 0L, SEEK_END);
+   len = ftell( ifile);
+   if( len > 0)
+      {
+#if defined( _WIN32) || defined( __WATCOMC__)
+      rval = malloc( (size_t)len);
+      fseek( ifile, 0L, SEEK_SET);
+      if( rval && !fread( rval, (size_t)len, 1, ifile))
+         {
+         free( rval);
+         rval = NULL;
+         }
+#else
+      rval = mmap( NULL, (size_t)len, PROT_READ, MAP_SHARED, fileno( ifile), 0);
+      if( rval == MAP_FAILED)
+         rval = NULL;
+#endif
+      }
+   *size = (size_t)len;
+   return( rval);
+}
+
+static void *map_cache_file( const char *filename, size_t *size)
+{
+   FILE *ifile = get_file_from_path( filename, "rb");
+   void *rval = NULL;
+
+   if( ifile)
+      {
+      rval = map_open_file( ifile, size);
+      fclose( ifile);
+      }
+   return( rval);
+}
+
+static void unmap_cache_file( const void *data, const size_t size)
+{
+#if defined( _WIN32) || defined( __WATCOMC__)
+   INTENTIONALLY_UNUSED_PARAMETER( size);
+   free( (void *)data);
+#else
+   munmap( (void *)data, size);
+#endif
+}
+
 static FILE *get_sof_file( const char *filename)
 {
    FILE *ifile = get_file_from_path( filename, "rb");
@@ -145,7 +284,6 @@ static FILE *get_sof_file( const char *filename)
    if( ifile)
       {
       int filelen;
-      size_t i, j;
       char buff[450];
 
       if( !fgets( buff, sizeof( buff), ifile))
@@ -164,16 +302,7 @@ static FILE *get_sof_file( const char *filename)
          exit( -5);
          }
       n_asteroids = filelen / record_length - 1;      /* there's a header line */
-      for( i = 0; i < 4; i++)
-         {
-         const int32_t big_prime = 1234567891;
-
-         fseek( ifile, (long)( i * (filelen - sizeof( buff))) / 3L, SEEK_SET);
-         if( fread( buff, sizeof( buff), 1, ifile))
-            for( j = 0; j < sizeof( buff); j++)
-               sof_checksum = sof_checksum * big_prime + (int32_t)buff[i];
-         }
-      fseek( ifile, 0L, SEEK_SET);
+      sof_checksum = compute_sof_checksum( ifile);
       if( verbose)
          printf( "'%s': %d objects; record size %d\n",
                       filename, n_asteroids, record_length);
@@ -181,10 +310,80 @@ static FILE *get_sof_file( const char *filename)
    return( ifile);
 }
 
-static double obj_sun_dist;
+/* Parsing the SOF file text is slow.  So we look for a 'compiled' version
+of it (see sof.cpp),  with the same name plus '.bin',  and map that into
+memory.  If it's not there,  or doesn't match the SOF file,  we compile it
+(mpc2sof also does this whenever it writes out a new SOF file.)  Either
+way,  orbits are then read straight out of the 'orbits' array,  with no
+parsing at all.      */
+
+static sof_record_t *orbits;
+
+static sof_record_t *load_compiled_orbits( const char *filename)
+{
+   char path[450];
+   FILE *ifile = get_file_from_path_ex( filename, "rb", path);
+   sof_record_t *rval = NULL;
+   int n_loaded;
+
+   if( ifile)
+      {
+      fclose( ifile);
+      rval = load_compiled_sof( path, sof_checksum, &n_loaded);
+      if( rval && n_loaded != n_asteroids)
+         {
+         free_compiled_sof( rval, n_loaded);
+         rval = NULL;
+         }
+      }
+   return( rval);
+}
+
+static sof_record_t *get_compiled_orbits( const char *sof_filename)
+{
+   char filename[100];
+   sof_record_t *rval;
+
+   strlcpy_error( filename, sof_filename);
+   strlcat_error( filename, ".bin");
+   rval = load_compiled_orbits( filename);
+   if( !rval)
+      {
+      FILE *lock_file = lock_cache_file( filename);
+
+      rval = load_compiled_orbits( filename);   /* may have been compiled */
+      if( !rval)                                /* while we waited */
+         {
+         char temp_path[450];
+         FILE *ofile = create_temp_cache_file( filename, temp_path);
+         const int n_written = write_compiled_sof( ofile, orbits_file);
+
+         if( verbose)
+            printf( "Compiled '%s'\n", filename);
+         if( n_written != n_asteroids)
+            {
+            printf( "'%s' doesn't parse correctly (%d)\n", sof_filename, n_written);
+            exit( -1);
+            }
+         commit_temp_cache_file( ofile, temp_path, filename, true);
+         rval = load_compiled_orbits( filename);
+         }
+      unlock_cache_file( lock_file);
+      }
+   if( !rval)
+      {
+      printf( "Couldn't load '%s'\n", filename);
+      exit( -1);
+      }
+   return( rval);
+}
+
+   /* Computes the (light-time lagged) geocentric RA/dec of the object
+   and returns its distance.  'obj_sun_dist' can be NULL.   */
 
 static double compute_asteroid_loc( const double *earth_loc,
-            ELEMENTS *elem, const double jd, double *ra, double *dec)
+            ELEMENTS *elem, const double jd, double *ra, double *dec,
+            double *obj_sun_dist)
 {
    double r1 = 0., dist, asteroid_loc[4];
    int i;
@@ -201,18 +400,118 @@ static double compute_asteroid_loc( const double *earth_loc,
    ecliptic_to_equatorial( asteroid_loc);
    *ra = atan2( asteroid_loc[1], asteroid_loc[0]);
    *dec = asin( asteroid_loc[2] / r1);
-   obj_sun_dist = asteroid_loc[3];
+   if( obj_sun_dist)
+      *obj_sun_dist = asteroid_loc[3];
    return( r1);
 }
 
+/* Computing day data can take a while (tens of seconds for a full MPCORB)
+and other astcheck instances may be waiting on it.  With '-j N',  the
+objects are split into N blocks which are computed in separate threads.
+The orbits are read-only and each object is written to its own slot in
+the output array,  so the threads needn't coordinate at all.    */
+
+static int n_threads = 1;
+
+typedef struct
+{
+   const double *earth_loc;
+   const void *kepler_batch;
+   double jd;
+   AST_DATA *rval;
+   int start, end;
+   bool show_progress;
+} day_data_block_t;
+
+/* Day data positions are computed DAY_CHUNK objects at a time,  using the
+batch two-body code (kepbatch.cpp).  The light-time loop is the same as in
+compute_asteroid_loc( ),  but unrolled:  a position at jd,  then one at
+jd - light_time.  That's almost always enough;  for the rare objects where
+it isn't,  we just fall back to compute_asteroid_loc( ).  */
+
+#define DAY_CHUNK 256
+
+static void compute_day_data_block( const day_data_block_t *block)
+{
+   const int n_objects = block->end - block->start;
+   int i, j, counter = 0;
+   double t[DAY_CHUNK], loc[DAY_CHUNK * 4], r1[DAY_CHUNK];
+
+   for( i = block->start; i < block->end; i += DAY_CHUNK)
+      {
+      const int n = (block->end - i < DAY_CHUNK ? block->end - i : DAY_CHUNK);
+
+      for( j = 0; j < n; j++)
+         t[j] = block->jd;
+      batch_comet_posn( block->kepler_batch, i, n, t, loc, NULL);
+      for( j = 0; j < n; j++)
+         {
+         double *lptr = loc + j * 4;
+
+         lptr[0] -= block->earth_loc[0];
+         lptr[1] -= block->earth_loc[1];
+         lptr[2] -= block->earth_loc[2];
+         r1[j] = vector3_length( lptr);
+         t[j] = block->jd - r1[j] / AU_PER_DAY;
+         }
+      batch_comet_posn( block->kepler_batch, i, n, t, loc, NULL);
+      for( j = 0; j < n; j++)
+         {
+         double *lptr = loc + j * 4;
+         double ra, dec, r2;
+
+         lptr[0] -= block->earth_loc[0];
+         lptr[1] -= block->earth_loc[1];
+         lptr[2] -= block->earth_loc[2];
+         r2 = vector3_length( lptr);
+         if( fabs( r2 - r1[j]) > .001)
+            {
+            ELEMENTS class_elem = orbits[i + j].elem;
+
+            compute_asteroid_loc( block->earth_loc, &class_elem, block->jd,
+                                    &ra, &dec, NULL);
+            }
+         else
+            {
+            ecliptic_to_equatorial( lptr);
+            ra = atan2( lptr[1], lptr[0]);
+            dec = asin( lptr[2] / r2);
+            }
+         block->rval[i + j].ra = integerize_angle( ra);
+         block->rval[i + j].dec = integerize_angle( dec);
+         }
+      while( block->show_progress
+                  && counter <= (i + n - block->start) * 80 / n_objects)
+         {
+         printf( "%d", counter % 10);
+         counter++;
+         }
+      }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI day_data_thread( LPVOID arg)
+{
+   compute_day_data_block( (const day_data_block_t *)arg);
+   return( 0);
+}
+#elif !defined( __WATCOMC__)
+static void *day_data_thread( void *arg)
+{
+   compute_day_data_block( (const day_data_block_t *)arg);
+   return( NULL);
+}
+#endif
+
 AST_DATA *compute_day_data( const long ijd)
 {
-   char tbuff[300];
-   int i, counter = 0;
+   int i, n_blocks = n_threads;
    AST_DATA *rval;
    const double jd = (double)ijd;
    double earth_loc[6];
-   clock_t t0 = clock( );
+   day_data_block_t *blocks;
+   void *kepler_batch;
+   const int64_t t0 = nanoseconds_since_1970( );
 
    if( verbose)
       printf( "Computing data for %ld (%d asteroids)\n", ijd, n_asteroids);
@@ -223,32 +522,73 @@ AST_DATA *compute_day_data( const long ijd)
       return( NULL);
       }
    get_earth_loc( (jd      - 2451545.) / 365250., earth_loc);
-   fseek( orbits_file, (long)record_length, SEEK_SET);
-   tbuff[record_length] = '\0';
-   for( i = 0; i < n_asteroids && fgets( tbuff, sizeof( tbuff), orbits_file); i++)
+#ifdef __WATCOMC__
+   n_blocks = 1;
+#endif
+   if( n_blocks > n_asteroids)
+      n_blocks = (n_asteroids ? n_asteroids : 1);
+   kepler_batch = init_kepler_batch( &orbits[0].elem, sizeof( sof_record_t),
+                                          n_asteroids);
+   blocks = (day_data_block_t *)calloc( n_blocks, sizeof( day_data_block_t));
+   assert( blocks && kepler_batch);
+   for( i = 0; i < n_blocks; i++)
+      {
+      blocks[i].earth_loc = earth_loc;
+      blocks[i].kepler_batch = kepler_batch;
+      blocks[i].jd = jd;
+      blocks[i].rval = rval;
+      blocks[i].start = (int)( (int64_t)n_asteroids * i / n_blocks);
+      blocks[i].end = (int)( (int64_t)n_asteroids * (i + 1) / n_blocks);
+      blocks[i].show_progress = (verbose && !i);
+      }
+   if( n_blocks == 1)
+      compute_day_data_block( blocks);
+#ifdef _WIN32
+   else
       {
-      ELEMENTS class_elem;
-      double ra, dec;
+      HANDLE *threads = (HANDLE *)calloc( n_blocks, sizeof( HANDLE));
 
-      if( extract_sof_data( &class_elem, tbuff, sof_header))
+      assert( threads);
+      for( i = 0; i < n_blocks; i++)
          {
-         printf( "'mpcorb.sof' data doesn't parse correctly:\n%s\n", tbuff);
-         exit( -1);
+         threads[i] = CreateThread( NULL, 0, day_data_thread, blocks + i, 0, NULL);
+         if( !threads[i])        /* couldn't create a thread;  do it here */
+            compute_day_data_block( blocks + i);
          }
+      for( i = 0; i < n_blocks; i++)
+         if( threads[i])
+            {
+            WaitForSingleObject( threads[i], INFINITE);
+            CloseHandle( threads[i]);
+            }
+      free( threads);
+      }
+#elif !defined( __WATCOMC__)
+   else
+      {
+      pthread_t *threads = (pthread_t *)calloc( n_blocks, sizeof( pthread_t));
+      bool *started = (bool *)calloc( n_blocks, sizeof( bool));
 
-      compute_asteroid_loc( earth_loc, &class_elem, jd, &ra, &dec);
-
-      rval[i].ra = integerize_angle( ra);
-      rval[i].dec = integerize_angle( dec);
-      if( verbose && counter <= i * 80 / n_asteroids)
+      assert( threads && started);
+      for( i = 0; i < n_blocks; i++)
          {
-         printf( "%d", counter % 10);
-         counter++;
+         started[i] = !pthread_create( threads + i, NULL, day_data_thread,
+                                       blocks + i);
+         if( !started[i])        /* couldn't create a thread;  do it here */
+            compute_day_data_block( blocks + i);
          }
+      for( i = 0; i < n_blocks; i++)
+         if( started[i])
+            pthread_join( threads[i], NULL);
+      free( threads);
+      free( started);
       }
+#endif
+   free( blocks);
+   free_kepler_batch( kepler_batch);
    if( verbose)
-      printf( "\nTime: %.1f seconds\n",
-                  (clock( ) - t0) / (double)CLOCKS_PER_SEC);
+      printf( "\nTime: %.1f seconds (%d threads)\n",
+                  (double)( nanoseconds_since_1970( ) - t0) * 1e-9, n_blocks);
    return( rval);
 }
 
@@ -265,10 +605,9 @@ static double centralize_angle( double ang)
 the geocentric position of each asteroid as of a certain day),  we
 attempt to open a file for that day of the form YYYYMMDD.chk.  If
 the file is opened,  and the header indicates the correct version,
-number of asteroids,  and checksum, we just load up the data
-from the file and return.   Otherwise,  this function creates the
-'day data' file,  saves it for future use,  and returns the data
-it's just generated.
+number of asteroids,  and checksum, we just map the data from the file
+and return.   Otherwise,  this function creates the 'day data' file,
+saves it for future use,  and returns the data it's just generated.
 
 It used to be as simple as that,  but 'astcheck' now gets used in a
 mode where many instances are run in parallel.  Run seventeen
@@ -277,119 +616,104 @@ instances for the same day, and all seventeen would start generating
 wait for the file to be ready.  So accessing and building of .chk
 files now works as follows :
 
-(1) We try to open the .chk day data file we need and read in the data.
-The file may not exist,  or may contain outdated data (the 'sof_checksum'
-or other header data may not match what we're looking for).  If that's
-the case,  we drop through the code to the point where we generate the
-day data and create the day data file.  Right away,  we write out the
-header information and fflush() it.  That way,  the other sixteen
-processes will see a header with no data (yet) and realize that they
-should wait a bit for the data to become available.
-
-(2) If we read in the header and it's what we're looking for (its
-"magic number",  checksum,  and the number of asteroids match),
-we try to read in the actual asteroid data.  That part may simply
-succeed (because the .chk file in question has already been completed).
-If we only get none or some of the data,  we assume we'll have to
-wait for some other process to finish creating and writing the file.
-
-In that case,  we 'sleep' for one second and try reading the data
-again.  Ideally,  we eventually get all the data.  Just as a check,
-if this takes more than sixty seconds, we assume something has gone
-seriously wrong and bomb out;  this is to avoid having phantom
-processes left hanging.  (Haven't seen that actually happen yet.) We
-also close the input file and reopen it and fseek() to the start of
-the remaining data.  That's just to force an update to the input
-file size.         */
+(1) We try to map the .chk day data file we need.  If it's there and
+complete,  with the right header,  we're done.  .chk files are only
+ever created by renaming a completed temporary file,  so we'll never see
+a partly-written one.
+
+(2) Otherwise,  we take the lock for that file (see lock_cache_file()).
+If another instance is building the file,  this blocks until it's done.
+Once we have the lock,  we try again to map the file,  since another
+instance may have just built it.  If it's still not there,  we compute
+the day data,  write it to a temporary file,  rename that to the .chk
+file,  release the lock,  and map the result.
+
+   (This replaces an older scheme in which the writer fflush()ed the header
+first,  and readers polled once a second for up to a minute for the rest
+of the data to show up.  That added latency,  and a crashed writer left
+a truncated file that other instances would wait on.)       */
 
 #define HEADER_SIZE 4
 
-static AST_DATA *get_cached_day_data( const int ijd)
+            /* Create a filename in 'YYYYMMDD.chk' (or other extension) form: */
+static void make_cache_filename( char *filename, const int ijd,
+                                                 const char *extension)
 {
-   char filename[20];
-   FILE *ifile, *ofile;
-   int32_t header[HEADER_SIZE];
-   const int32_t magic_version_number = 1314159266;
-   AST_DATA *rval;
-
-                  /* Create a filename in 'YYYYMMDD.chk' form: */
    full_ctime( filename, (double)ijd, FULL_CTIME_YMD | FULL_CTIME_NO_SPACES
                      | FULL_CTIME_DATE_ONLY | FULL_CTIME_MONTHS_AS_DIGITS
                      | FULL_CTIME_LEADING_ZEROES);
-   strlcat_error( filename, ".chk");
-   if( verbose > 2)
-      printf( "Creating '%s'\n", filename);
-   ifile = get_file_from_path( filename, "rb");
-   if( ifile)
+   strcat( filename, extension);
+}
+
+static const int32_t magic_version_number = 1314159266;
+
+static int32_t *map_day_data( const char *filename)
+{
+   const size_t expected_size = HEADER_SIZE * sizeof( int32_t)
+                                 + n_asteroids * sizeof( AST_DATA);
+   size_t size;
+   int32_t *rval = (int32_t *)map_cache_file( filename, &size);
+
+   if( rval && (size != expected_size || rval[0] != magic_version_number
+                   || rval[1] != sof_checksum || rval[2] != n_asteroids))
       {
-      if( !fread( header, HEADER_SIZE, sizeof( int), ifile))
-         {
-         printf( "Error reading header data in '%s'\n", filename);
-         exit( -2);
-         }
-      if( header[0] != magic_version_number
-                   || header[1] != sof_checksum || header[2] != n_asteroids)
-         fclose( ifile);
-      else   /* appears to be legitimate cached data */
-         {
-         int n_read = 0, n_iterations = 0;
+      unmap_cache_file( rval, size);
+      rval = NULL;
+      }
+   return( rval);
+}
 
-         rval = (AST_DATA *)malloc( n_asteroids * sizeof( AST_DATA));
-         if( !rval)
-            {
-            printf( "Ran out of memory\n");
+static AST_DATA *get_cached_day_data( const int ijd)
+{
+   char filename[20];
+   int32_t *rval;
+
+   make_cache_filename( filename, ijd, ".chk");
+   rval = map_day_data( filename);
+   if( !rval)
+      {
+      FILE *lock_file = lock_cache_file( filename);
+
+      rval = map_day_data( filename);  /* may have been made while we waited */
+      if( !rval)
+         {
+         int32_t header[HEADER_SIZE];
+         char temp_path[450];
+         FILE *ofile = create_temp_cache_file( filename, temp_path);
+         AST_DATA *data;
+         bool ok;
+
+         if( verbose > 2)
+            printf( "Creating '%s'\n", filename);
+         header[0] = magic_version_number;
+         header[1] = sof_checksum;
+         header[2] = n_asteroids;
+         header[3] = -1;         /* not currently used */
+         data = compute_day_data( ijd);
+         if( !data)
             exit( -4);
-            }
-         while( n_read != n_asteroids)
-            {
-            n_read += (int)fread( rval + n_read, sizeof( AST_DATA),
-                                        n_asteroids - n_read, ifile);
-            if( n_read != n_asteroids)
-               {
-               if( n_iterations++ == 60)
-                  {               /* Give up after one minute */
-                  fprintf( stderr, "Overtime\n");
-                  exit( -3);
-                  }
-#ifndef _WIN32
-               if( verbose)
-                  printf( "(%d) %d of %d read, iter %d\n", (int)getpid( ),
-                        n_read, n_asteroids, n_iterations);
-#endif
-                                 /* Close/reopen file.  Gets around some */
-                                 /* caching issues.   */
-               fclose( ifile);
-#ifndef _WIN32
-               usleep( 1000000);    /* 1000000 microseconds = 1 second */
-#else
-               Sleep( 1000);        /* 1000 milliseconds = 1 second */
-#endif
-               ifile = get_file_from_path( filename, "rb");
-               fseek( ifile, 16 + 4L * n_read, SEEK_SET);
-               }
-            }
-         fclose( ifile);
-         return( rval);
+         ok = (fwrite( header, sizeof( int32_t), HEADER_SIZE, ofile) == HEADER_SIZE
+               && fwrite( data, sizeof( AST_DATA), n_asteroids, ofile)
+                                             == (size_t)n_asteroids);
+         commit_temp_cache_file( ofile, temp_path, filename, ok);
+         free( data);
+         rval = map_day_data( filename);
          }
+      unlock_cache_file( lock_file);
       }
-   header[0] = magic_version_number;
-   header[1] = sof_checksum;
-   header[2] = n_asteroids;
-   header[3] = -1;         /* not currently used */
-   ofile = get_file_from_path( filename, "wb");
-   if( !ofile)
+   if( !rval)
       {
-      fprintf( stderr, "Couldn't open '%s'\n", filename);
-      perror( "File open failure");
+      fprintf( stderr, "Couldn't create/read '%s'\n", filename);
       exit( -1);
       }
-   fwrite( header, HEADER_SIZE, sizeof( int), ofile);
-   fflush( ofile);
-   rval = compute_day_data( ijd);
-   fwrite( rval, n_asteroids, sizeof( AST_DATA), ofile);
-   fclose( ofile);
+   return( (AST_DATA *)( rval + HEADER_SIZE));
+}
 
-   return( rval);
+static void release_day_data( AST_DATA *day_data)
+{
+   if( day_data)
+      unmap_cache_file( (int32_t *)day_data - HEADER_SIZE,
+               HEADER_SIZE * sizeof( int32_t) + n_asteroids * sizeof( AST_DATA));
 }
 
          /* Figuring out if an RA 'x' is between two RAs 'bound1' */
@@ -419,80 +743,298 @@ static int is_between( int bound1, int bound2, int x, int tolerance)
    return( rval);
 }
 
-int qsort_mpc_cmp( const void *elem1, const void *elem2)
+/* Rather than run is_between( ) on every object for every observation,
+we sort the objects into a grid of 256 x 256 'cells',  each 256 of the
+above angular units (about 1.4 degrees) on a side.  An object goes into
+every cell touched by the RA/dec box it sweeps out between the two days
+of day data.  For a given observation,  only objects in cells within
+'tolerance' of it need be checked with is_between( ).  That check is
+still done,  so the results are exactly those of a linear scan.
+
+   Objects moving more than MAX_INDEX_SPAN units in a day would land in
+a lot of cells.  Those,  and objects crossing RA=180 degrees (for which
+is_between( ) has some rather odd behavior),  go into a 'wide' list
+which is always checked.
+
+   The index for the day pair (ijd, ijd + 1) is saved as 'YYYYMMDD.idx'
+next to the .chk files,  so that other instances needn't rebuild it.
+It's written to a temporary file and then renamed,  so that other
+instances see either the complete index or none at all.  The layout is
+a header of HEADER_SIZE int32_ts (magic number,  sof_checksum,
+n_asteroids,  number of entries),  then N_INDEX_CELLS + 2 offsets (cell
+i runs from offsets[i] to offsets[i + 1];  the last cell is the 'wide'
+list),  then the entries (object indices,  in increasing order within
+each cell).  It's used as a single array of int32_ts in memory,  too. */
+
+#define INDEX_CELL_SHIFT      8
+#define N_INDEX_ROW           (65536 >> INDEX_CELL_SHIFT)
+#define N_INDEX_CELLS         (N_INDEX_ROW * N_INDEX_ROW)
+#define WIDE_INDEX_CELL       N_INDEX_CELLS
+#define MAX_INDEX_SPAN        (16 << INDEX_CELL_SHIFT)
+#define INDEX_OFFSETS         HEADER_SIZE
+#define INDEX_ENTRIES         (INDEX_OFFSETS + N_INDEX_CELLS + 2)
+
+static inline int index_cell( const int angle)
 {
-   const char **buff1 = (const char **)elem1;
-   const char **buff2 = (const char **)elem2;
-   int compare = memcmp( *buff1, *buff2, 12);
-
-   if( !compare)     /* same ID;  now compare times */
-      compare = memcmp( (*buff1) + 15, (*buff2) + 15, 16);
-   return( compare);
+   return( (angle + 32768) >> INDEX_CELL_SHIFT);
 }
 
-   /* To compute observed object motion,  this code grabs the RA/dec */
-   /* of the first observation;  then looks ahead for observations   */
-   /* of the same object from the same station.  The difference      */
-   /* between the pair gives motion.  Except we want to use a pair   */
-   /* far enough apart to show real motion,  but not so far apart    */
-   /* that sky curvature or acceleration are factors.                */
-   /*    Return value is the JD of the observation used to determine */
-   /* the motion.  If there was only one observation,  we give the   */
-   /* time of that observation plus epsilon,  to evade division by   */
-   /* zero.                                                          */
+   /* Counts the cell entries for each object (if 'entries' is NULL),  or
+   fills them in,  using 'counts' as the current fill point for each cell. */
 
-static double compute_motion( const char **lines, const int n_lines,
-                           double *ra_motion, double *dec_motion)
+static void add_to_day_index( const AST_DATA *day0, const AST_DATA *day1,
+                              int32_t *counts, int32_t *entries)
 {
-   double ra, dec, jd, rval;
-   int i;
+   int i, ra_cell, dec_cell;
 
-   *ra_motion = *dec_motion = 0.;
-   get_mpc_data( lines[0], &jd, &ra, &dec);
-   rval = jd + 1e-6;
-   for( i = 1; i < n_lines && !memcmp( lines[0], lines[i], 12); i++)
-      if( !memcmp( lines[0] + 77, lines[i] + 77, 3))
-         {
-         double ra1, dec1, jd1;
-         const double five_degrees = PI / 36.;
+   for( i = 0; i < n_asteroids; i++)
+      {
+      const int ra0 = day0[i].ra, ra1 = day1[i].ra;
+      const int dec0 = day0[i].dec, dec1 = day1[i].dec;
 
-         if( !get_mpc_data( lines[i], &jd1, &ra1, &dec1)
-                && fabs( jd1 - jd) < 10.   /* within ten days... */
-                && fabs( ra1 - ra) < five_degrees
-                && fabs( dec1 - dec) < five_degrees)
-            {
-            *ra_motion = (ra1 - ra) / (jd1 - jd);
-            *dec_motion = (dec1 - dec) / (jd1 - jd);
-            *ra_motion *= cos( dec);
-                     /* cvt radians/day to arcsec/hr: */
-            *ra_motion *= radians_to_arcsec  / 24.;
-            *dec_motion *= radians_to_arcsec / 24.;
-            rval = jd1;
-            }
+      if( abs( ra1 - ra0) > MAX_INDEX_SPAN || abs( dec1 - dec0) > MAX_INDEX_SPAN)
+         {
+         if( entries)
+            entries[counts[WIDE_INDEX_CELL]] = i;
+         counts[WIDE_INDEX_CELL]++;
          }
-   return( rval);
+      else
+         for( dec_cell = index_cell( dec0 < dec1 ? dec0 : dec1);
+                       dec_cell <= index_cell( dec0 < dec1 ? dec1 : dec0); dec_cell++)
+            for( ra_cell = index_cell( ra0 < ra1 ? ra0 : ra1);
+                       ra_cell <= index_cell( ra0 < ra1 ? ra1 : ra0); ra_cell++)
+               {
+               const int cell = dec_cell * N_INDEX_ROW + ra_cell;
+
+               if( entries)
+                  entries[counts[cell]] = i;
+               counts[cell]++;
+               }
+      }
 }
 
-void observer_cartesian_coords( const double jd, const double lon,
-              const double rho_cos_phi, const double rho_sin_phi,
-              double *vect)
+static const int32_t index_magic_number = 1314159267;
+
+static int32_t *build_day_index( const AST_DATA *day0, const AST_DATA *day1)
 {
-   const double angle = lon + green_sidereal_time( jd);
-   const double earth_major_axis = 6378140. / AU_IN_METERS;
+   int32_t *counts = (int32_t *)calloc( N_INDEX_CELLS + 1, sizeof( int32_t));
+   int32_t *rval, *offsets, n_entries = 0;
+   int i;
 
-   *vect++ = cos( angle) * rho_cos_phi * earth_major_axis;
-   *vect++ = sin( angle) * rho_cos_phi * earth_major_axis;
-   *vect++ = rho_sin_phi               * earth_major_axis;
+   assert( counts);
+   add_to_day_index( day0, day1, counts, NULL);
+   for( i = 0; i <= N_INDEX_CELLS; i++)
+      n_entries += counts[i];
+   rval = (int32_t *)malloc( (INDEX_ENTRIES + n_entries) * sizeof( int32_t));
+   if( !rval)
+      {
+      printf( "Ran out of memory\n");
+      exit( -4);
+      }
+   rval[0] = index_magic_number;
+   rval[1] = sof_checksum;
+   rval[2] = n_asteroids;
+   rval[3] = n_entries;
+   offsets = rval + INDEX_OFFSETS;
+   offsets[0] = 0;
+   for( i = 0; i <= N_INDEX_CELLS; i++)
+      {
+      offsets[i + 1] = offsets[i] + counts[i];
+      counts[i] = offsets[i];
+      }
+   add_to_day_index( day0, day1, counts, rval + INDEX_ENTRIES);
+   free( counts);
+   return( rval);
 }
 
-static double get_topo_loc( const double jd, double *topo_loc, const double lon,
-              const double rho_cos_phi, const double rho_sin_phi)
+static int32_t *map_day_index( const char *filename)
+{
+   size_t size;
+   int32_t *rval = (int32_t *)map_cache_file( filename, &size);
+
+   if( rval && (size < INDEX_ENTRIES * sizeof( int32_t)
+                  || rval[0] != index_magic_number
+                  || rval[1] != sof_checksum || rval[2] != n_asteroids
+                  || rval[3] < 0
+                  || size != (INDEX_ENTRIES + (size_t)rval[3]) * sizeof( int32_t)))
+      {
+      unmap_cache_file( rval, size);
+      rval = NULL;
+      }
+   return( rval);
+}
+
+static int32_t *get_cached_day_index( const int ijd, const AST_DATA *day0,
+                                                     const AST_DATA *day1)
+{
+   char filename[20];
+   int32_t *rval;
+
+   make_cache_filename( filename, ijd, ".idx");
+   rval = map_day_index( filename);
+   if( !rval)
+      {
+      FILE *lock_file = lock_cache_file( filename);
+
+      rval = map_day_index( filename);
+      if( !rval)
+         {
+         int32_t *index;
+         char temp_path[450];
+         FILE *ofile = create_temp_cache_file( filename, temp_path);
+         size_t n_ints;
+
+         if( verbose)
+            printf( "Building index '%s'\n", filename);
+         index = build_day_index( day0, day1);
+         n_ints = INDEX_ENTRIES + index[3];
+         commit_temp_cache_file( ofile, temp_path, filename,
+                  fwrite( index, sizeof( int32_t), n_ints, ofile) == n_ints);
+         free( index);
+         rval = map_day_index( filename);
+         }
+      unlock_cache_file( lock_file);
+      }
+   if( !rval)
+      {
+      fprintf( stderr, "Couldn't create/read '%s'\n", filename);
+      exit( -1);
+      }
+   return( rval);
+}
+
+static void release_day_index( int32_t *index)
+{
+   if( index)
+      unmap_cache_file( index, (INDEX_ENTRIES + (size_t)index[3]) * sizeof( int32_t));
+}
+
+static int int32_compare( const void *a, const void *b)
+{
+   const int32_t ia = *(const int32_t *)a, ib = *(const int32_t *)b;
+
+   return( ia > ib ? 1 : (ia < ib ? -1 : 0));
+}
+
+   /* Gathers (in increasing order,  without duplicates) the indices of
+   all objects in the cells within 'tolerance' of (ra, dec),  plus those
+   in the 'wide' list.  Returns -1 if that would cover so much of the
+   sky that the caller may as well just check every object,  or if the
+   tolerance is outside the range the cell arithmetic can handle (in
+   which case the caller's linear scan gives the same answers anyway). */
+
+static int find_index_candidates( const int32_t *index, const int ra,
+            const int dec, const int tolerance, int32_t **candidates,
+            int *n_allocated)
+{
+   const int32_t *offsets = index + INDEX_OFFSETS;
+   const int32_t *entries = index + INDEX_ENTRIES;
+            /* offset by 65536 * 2 to keep the shifted values positive */
+   const int ra_lo = index_cell( ra - tolerance + 131072);
+   const int n_ra = index_cell( ra + tolerance + 131072) - ra_lo + 1;
+   const int dec_lo = (dec - tolerance < -32768 ? 0 : index_cell( dec - tolerance));
+   const int dec_hi = (dec + tolerance > 32767 ? N_INDEX_ROW - 1
+                                                : index_cell( dec + tolerance));
+   const int max_cells = N_INDEX_CELLS / 8;
+   int cells[N_INDEX_CELLS / 8 + 1];
+   int i, j, n_cells = 0, n_found = 0, n_unique = 0;
+
+   if( tolerance < 0 || tolerance >= 65536)
+      return( -1);
+   if( (dec_hi - dec_lo + 1) * (n_ra < N_INDEX_ROW ? n_ra : N_INDEX_ROW) > max_cells)
+      return( -1);
+   for( i = dec_lo; i <= dec_hi; i++)
+      for( j = 0; j < n_ra && j < N_INDEX_ROW; j++)
+         cells[n_cells++] = i * N_INDEX_ROW + (ra_lo + j) % N_INDEX_ROW;
+   cells[n_cells++] = WIDE_INDEX_CELL;
+   for( i = 0; i < n_cells; i++)
+      n_found += offsets[cells[i] + 1] - offsets[cells[i]];
+   if( n_found > *n_allocated)
+      {
+      *n_allocated = n_found + n_found / 2;
+      *candidates = (int32_t *)realloc( *candidates,
+                                    *n_allocated * sizeof( int32_t));
+      assert( *candidates);
+      }
+   n_found = 0;
+   for( i = 0; i < n_cells; i++)
+      {
+      const int32_t n_entries = offsets[cells[i] + 1] - offsets[cells[i]];
+
+      memcpy( *candidates + n_found, entries + offsets[cells[i]],
+                                 n_entries * sizeof( int32_t));
+      n_found += n_entries;
+      }
+   qsort( *candidates, n_found, sizeof( int32_t), int32_compare);
+   for( i = 0; i < n_found; i++)          /* remove duplicates */
+      if( !i || (*candidates)[i] != (*candidates)[i - 1])
+         (*candidates)[n_unique++] = (*candidates)[i];
+   return( n_unique);
+}
+
+int qsort_mpc_cmp( const void *elem1, const void *elem2)
+{
+   const mpc_obs_t *obs1 = (const mpc_obs_t *)elem1;
+   const mpc_obs_t *obs2 = (const mpc_obs_t *)elem2;
+   int compare = memcmp( obs1->desig, obs2->desig, 12);
+
+   if( !compare)     /* same ID;  now compare times */
+      compare = (obs1->jd > obs2->jd) - (obs1->jd < obs2->jd);
+   return( compare);
+}
+
+   /* To compute observed object motion,  this code grabs the RA/dec */
+   /* of the first observation;  then looks ahead for observations   */
+   /* of the same object from the same station.  The difference      */
+   /* between the pair gives motion.  Except we want to use a pair   */
+   /* far enough apart to show real motion,  but not so far apart    */
+   /* that sky curvature or acceleration are factors.                */
+   /*    Return value is the JD of the observation used to determine */
+   /* the motion.  If there was only one observation,  we give the   */
+   /* time of that observation plus epsilon,  to evade division by   */
+   /* zero.                                                          */
+
+static double compute_motion( const mpc_obs_t *obs, const int n_obs,
+                           double *ra_motion, double *dec_motion)
+{
+   const double ra = obs->ra, dec = obs->dec, jd = obs->jd;
+   double rval = jd + 1e-6;
+   int i;
+
+   *ra_motion = *dec_motion = 0.;
+   for( i = 1; i < n_obs && !memcmp( obs->desig, obs[i].desig, 12); i++)
+      if( obs->station == obs[i].station)
+         {
+         const double ra1 = obs[i].ra, dec1 = obs[i].dec, jd1 = obs[i].jd;
+         const double five_degrees = PI / 36.;
+
+         if( fabs( jd1 - jd) < 10.   /* within ten days... */
+                && fabs( ra1 - ra) < five_degrees
+                && fabs( dec1 - dec) < five_degrees)
+            {
+            *ra_motion = (ra1 - ra) / (jd1 - jd);
+            *dec_motion = (dec1 - dec) / (jd1 - jd);
+            *ra_motion *= cos( dec);
+                     /* cvt radians/day to arcsec/hr: */
+            *ra_motion *= radians_to_arcsec  / 24.;
+            *dec_motion *= radians_to_arcsec / 24.;
+            rval = jd1;
+            }
+         }
+   return( rval);
+}
+
+   /* 'observer' is the geocentric J2000 equatorial position of the
+   observer,  from compute_observer_vectors( );  'jd' is in TT.  */
+
+static double get_topo_loc( const double jd, double *topo_loc,
+                            const double *observer)
 {
    double earth_loc[6];
    int i;
 
    get_earth_loc( (jd - 2451545.) / 365250., earth_loc);
-   observer_cartesian_coords( jd, lon, rho_cos_phi, rho_sin_phi, topo_loc);
+   memcpy( topo_loc, observer, 3 * sizeof( double));
    equatorial_to_ecliptic( topo_loc);
    for( i = 0; i < 3; i++)
       topo_loc[i] += earth_loc[i];
@@ -527,46 +1069,53 @@ static int get_mpcorb_dot_dat_line( const char *filename, const int line_no,
    return( rval);
 }
 
-static char _dummy_filename[40];
+   /* For '-c' (list) mode,  we make up an 80-column observation at the
+   given time and place,  and check that.  */
 
-static void make_fake_file( const char **argv)
+static void make_fake_line( char *buff, const char *date, const char *ra_str,
+                  const char *dec_str, const char *mpc_code)
 {
-   char buff[81];
-   const double jd = get_time_from_string( 0., argv[2], 0, NULL);
-   const double ra = atof( argv[3]);
-   const double dec = atof( argv[4]);
-   FILE *ofile = fopen( _dummy_filename, "wb");
+   const double jd = get_time_from_string( 0., date, 0, NULL);
+   const double ra = atof( ra_str);
+   const double dec = atof( dec_str);
 
-   strlcpy_error( buff, "    dummy     C");
+   strlcpy_err( buff, "    dummy     C", 81);
    snprintf_append( buff, 56, "%16.8f %011.7f %+011.7f", jd, ra, dec);
-   strlcat_error( buff, "                 Synth");
-   strlcat_error( buff, argv[5]);          /* MPC code */
-   fprintf( ofile, "%s\n", buff);
-   fclose( ofile);
+   strlcat_err( buff, "                 Synth", 81);
+   strlcat_err( buff, mpc_code, 81);
    assert( strlen( buff) == 80);
 }
 
 static void err_message( void)
 {
    printf( "\nastcheck needs the name of a file containing MPC-formatted (80-column)\n");
-   printf( "astrometric data.  It will then attempt to match the records to known\n");
-   printf( "objects in the 'mpcorb.sof' file.\n\n");
+   printf( "or ADES astrometric data.  It will then attempt to match the records to\n");
+   printf( "known objects in the 'mpcorb.sof' file.\n\n");
    printf( "Command-line options are:\n\n");
    printf( "   -r(dist)   Set search distance to 'dist' arcseconds. Default is 3600.\n");
    printf( "   -z(tol)    Set motion match tolerance to 'tol' arcsec/hr. Default is 10.\n");
    printf( "   -m(mag)    Set limiting mag to 'mag'.  Default is 22.\n");
    printf( "   -l         Show distance from line of variations. Experimental.\n");
+   printf( "   -j(n)      Use 'n' threads when computing day data.  Default is 1.\n");
    printf( "Alternatively,  one can get a list of asteroids/comets within a desired\n");
    printf( "area with\n\n");
    printf( "astcheck -c (date) (RA in degrees) (dec in degrees) (MPC code) (options)\n\n");
    printf( "For example, 'astcheck -c 2022apr3.1415 292.653 -7.653 E12 -r7200' would get\n");
-   printf( "a list of asteroids within two degrees of that RA/dec as seen from (E12).\n");
+   printf( "a list of asteroids within two degrees of that RA/dec as seen from (E12).\n\n");
+   printf( "astcheck can also run as a server,  keeping orbits and day data loaded\n");
+   printf( "and checking batches of observations as they come in :\n\n");
+   printf( "astcheck -s (options)          reads batches from stdin\n");
+   printf( "astcheck -S(socket) (options)  accepts connections on a Unix socket\n");
+   printf( "   -w(n)      Use 'n' worker threads for socket connections.  Default is 4.\n\n");
+   printf( "Each batch is an optional line of options (as above,  or '-c' followed\n");
+   printf( "by date, RA, dec,  and MPC code),  then the observations,  then a line\n");
+   printf( "reading 'END'.  The results are followed by an 'END' line.\n");
 }
 
-static void show_astcheck_info( void)
+static void show_astcheck_info( FILE *ofile)
 {
-   printf( "ASTCHECK version %s %s\n", __DATE__, __TIME__);
-   printf( "%d objects\n", n_asteroids);
+   fprintf( ofile, "ASTCHECK version %s %s\n", __DATE__, __TIME__);
+   fprintf( ofile, "%d objects\n", n_asteroids);
 }
 
 /* An oversimplified getopt(). */
@@ -579,7 +1128,6 @@ static const char *get_arg( const int argc, const char **argv, const int idx)
       return( argv[idx + 1]);
 }
 
-#define IS_POWER_OF_TWO( n)    (((n) & ((n)-1)) == 0)
 
 #if defined(_MSC_VER) && _MSC_VER < 1900
                       /* For older MSVCs,  we have to supply our own  */
@@ -587,171 +1135,300 @@ static const char *get_arg( const int argc, const char **argv, const int idx)
 int snprintf( char *string, const size_t max_len, const char *format, ...);
 #endif
 
+/* Settings that apply to a batch of observations.  On the command line,
+these are set with the usual switches.  In server mode,  those become the
+defaults,  and each batch can override them.   */
+
+typedef struct
+{
+   double tolerance_in_arcsec, mag_limit, motion_tolerance;
+   int max_results;
+   char mpcorb_extracts[200];
+   bool show_lov, show_header, is_list_file, html_output;
+} check_options_t;
+
+static void default_check_options( check_options_t *opts)
+{
+   memset( opts, 0, sizeof( check_options_t));
+   opts->tolerance_in_arcsec = 18000.;       /* = five degrees */
+   opts->mag_limit = 22.;
+   opts->motion_tolerance = 10.;  /* require a match to within 10"/hr */
+   opts->max_results = 100;
+   opts->show_header = true;
 #ifdef CGI_VERSION
-int astcheck_main( const int argc, const char **argv)
-#else
-int main( const int argc, const char **argv)
+   opts->html_output = true;
 #endif
+}
+
+   /* '-e' gives a list of 'start,count' pairs,  separated by ';',  of
+   columns from mpcorb.dat to be appended to each match.  That's checked
+   when the option is set;  a bad list just means no extracts,  rather
+   than (say) a server bailing out in mid-batch.  */
+
+static bool check_mpcorb_extracts( const char *extracts)
 {
-   double jd, ra, dec;
-   FILE *ifile;
-   const char *sof_filename = "mpcorb.sof";
-   char buff[90];
-   char **ilines = NULL;
-   int show_lov = 0;
-   int i, n_ilines = 0, n, max_results = 100;
-   int n_lines_printed = 0;
-   double tolerance_in_arcsec = 18000.;       /* = five degrees */
-   double mag_limit = 22.;
-   AST_DATA *day_data[2] = { NULL, NULL};
-   long curr_loaded_day_data = 0;
-   FILE *mpc_station_file;
-   char curr_station[7];
-   double rho_sin_phi = 0., rho_cos_phi = 0., longitude = 0.;
-   double motion_tolerance = 10.;  /* require a match to within 10"/hr */
-   int results_array_size = 5;
-   char **results = (char **)calloc( results_array_size, sizeof( char *));
-   bool is_list_file = false;
-   bool show_header = true;
-   const char *mpcorb_extracts = "";
+   int start, count, total = 0;
 
-   if( argc < 2)
+   while( *extracts)
       {
-      err_message( );
-      return( -1);
+      if( sscanf( extracts, "%d,%d", &start, &count) != 2
+               || start < 1 || count < 0 || start + count > 204
+               || (total += count + 1) > 100)
+         {
+         fprintf( stderr, "Error parsing mpcorb extracts at '%s'\n", extracts);
+         return( false);
+         }
+      while( *extracts > ' ' && *extracts != ';')
+         extracts++;
+      while( *extracts == ' ' || *extracts == ';')
+         extracts++;
       }
-#ifdef _WIN32
-   strlcpy_error( _dummy_filename, "astcheck.tmp");
+   return( true);
+}
+
+   /* Returns false if 'option' isn't one of the per-batch options. */
+
+static bool set_check_option( check_options_t *opts, const char option,
+                              const char *arg)
+{
+   switch( option)
+      {
+      case 'e':
+         if( check_mpcorb_extracts( arg))
+            strlcpy_error( opts->mpcorb_extracts, arg);
+         break;
+      case 'h':
+         opts->show_header = false;
+         break;
+      case 'H':
+         opts->html_output = true;
+         break;
+      case 'r':
+         opts->tolerance_in_arcsec = atof( arg);
+         break;
+      case 'm':
+         opts->mag_limit = atof( arg);
+         break;
+      case 'l':
+         opts->show_lov = true;
+         break;
+      case 'z':
+         opts->motion_tolerance = atof( arg);
+         break;
+      case 'M':
+         opts->max_results = atoi( arg);
+         break;
+      default:
+         return( false);
+      }
+   return( true);
+}
+
+/* In server mode,  several threads may be checking batches at once.
+They share the day data (see below),  the station file,  and the state
+in get_mpcorb_dot_dat_line( ).  All of that is guarded by one mutex.
+Without pthreads,  there's only one thread and the lock macros do nothing. */
+
+#if !defined( _WIN32) && !defined( __WATCOMC__)
+   #define ASTCHECK_SERVER
+   #include <signal.h>
+   #include <sys/socket.h>
+   #include <sys/un.h>
+
+   static pthread_mutex_t astcheck_mutex = PTHREAD_MUTEX_INITIALIZER;
+   static pthread_cond_t astcheck_cond = PTHREAD_COND_INITIALIZER;
+   #define LOCK_ASTCHECK( )      pthread_mutex_lock( &astcheck_mutex)
+   #define UNLOCK_ASTCHECK( )    pthread_mutex_unlock( &astcheck_mutex)
+   #define WAIT_ASTCHECK( )      pthread_cond_wait( &astcheck_cond, &astcheck_mutex)
+   #define SIGNAL_ASTCHECK( )    pthread_cond_broadcast( &astcheck_cond)
 #else
-   snprintf( _dummy_filename, sizeof( _dummy_filename), "astcheck%d.tmp",
-                        (int)getpid( ));
+   #define LOCK_ASTCHECK( )
+   #define UNLOCK_ASTCHECK( )
+   #define WAIT_ASTCHECK( )      assert( 0)
+   #define SIGNAL_ASTCHECK( )
 #endif
-   if( !strcmp( argv[1], "-c"))
+
+/* Day data and indices are kept for the N_DAY_PAIRS most recently used
+days.  A pair in use by a batch can't be dropped.  A pair being loaded
+(which may mean computing it) is flagged,  so that other batches wanting
+that day wait for it,  while batches wanting other days carry on.  */
+
+typedef struct
+{
+   int ijd, n_users;
+   AST_DATA *day_data[2];
+   int32_t *index;
+   long last_used;
+   bool loading;
+} day_pair_t;
+
+#define N_DAY_PAIRS 6
+
+static day_pair_t day_pairs[N_DAY_PAIRS];
+
+static day_pair_t *acquire_day_pair( const int ijd)
+{
+   static long n_uses;
+   day_pair_t *rval = NULL;
+   bool must_load = false;
+
+   LOCK_ASTCHECK( );
+   while( !rval)
       {
-      assert( argc > 5);
-      make_fake_file( argv);
-      is_list_file = true;
-      max_results = 20000;
-      }
-   memset( curr_station, 0, sizeof( curr_station));
-   for( i = (is_list_file ? 6 : 2); i < argc; i++)
-      if( argv[i][0] == '-')
+      day_pair_t *match = NULL, *unused = NULL;
+      int i;
+
+      for( i = 0; i < N_DAY_PAIRS; i++)
          {
-         const char *arg = get_arg( argc, argv, i);
+         day_pair_t *pair = day_pairs + i;
 
-         assert( arg);
-         switch( argv[i][1])
-            {
-            case 'e':
-               mpcorb_extracts = arg;
-               break;
-            case 'h':
-               show_header = false;
-               break;
-            case 'r':
-               tolerance_in_arcsec = atof( arg);
-               break;
-            case 'v':
-               setvbuf( stdout, NULL, _IONBF, 0);
-               verbose = 1 + atoi( arg);
-               break;
-            case 'm':
-               mag_limit = atof( arg);
-               break;
-            case 'p':
-               data_path = arg;
-               break;
-            case 'l':
-               show_lov = 1;
-               break;
-            case 'z':
-               motion_tolerance = atof( arg);
-               break;
-            case 'M':
-               max_results = atoi( arg);
-               break;
-#ifdef NOT_READY_QUITE_YET
-            case 'e':
-               show_uncertainty = 1;
-               break;
-#endif
-            case 'f':
-               sof_filename = arg;
-               break;
-            default:
-               printf( "%s: unrecognized command-line option\n", argv[i]);
-               break;
-            }
+         if( pair->ijd == ijd && (pair->index || pair->loading))
+            match = pair;
+         else if( !pair->n_users && !pair->loading
+                     && (!unused || pair->last_used < unused->last_used))
+            unused = pair;
          }
-   mpc_station_file = get_file_from_path( "ObsCodes.html", "rb");
-   if( !mpc_station_file)        /* perhaps stored with truncated extension? */
-      mpc_station_file = get_file_from_path( "ObsCodes.htm", "rb");
-   if( !mpc_station_file)
-      {
-      printf( "ObsCodes.html not found; parallax won't be included!\n");
-      printf( "Astcheck can run without this file,  but will produce better\n");
-      printf( "results if it has it :\n\n");
-      printf( "https://www.minorplanetcenter.net/iau/lists/ObsCodes.html\n\n");
-      printf( "Download this file and put it in the directory in which\n");
-      printf( "astcheck is running.\n");
+      if( match && !match->loading)
+         rval = match;
+      else if( !match && unused)
+         {
+         rval = unused;
+         release_day_data( rval->day_data[0]);
+         release_day_data( rval->day_data[1]);
+         release_day_index( rval->index);
+         memset( rval, 0, sizeof( day_pair_t));
+         rval->ijd = ijd;
+         rval->loading = must_load = true;
+         }
+      else        /* wait for a load to finish or a pair to be released */
+         WAIT_ASTCHECK( );
       }
-   if( argc < 2)
+   rval->n_users++;
+   rval->last_used = ++n_uses;
+   UNLOCK_ASTCHECK( );
+   if( must_load)
       {
-      printf( "No input file name specified\n");
-      err_message( );
-      return( -1);
+      AST_DATA *day0 = get_cached_day_data( ijd);
+      AST_DATA *day1 = get_cached_day_data( ijd + 1);
+      int32_t *index = get_cached_day_index( ijd, day0, day1);
+
+      LOCK_ASTCHECK( );
+      rval->day_data[0] = day0;
+      rval->day_data[1] = day1;
+      rval->index = index;
+      rval->loading = false;
+      SIGNAL_ASTCHECK( );
+      UNLOCK_ASTCHECK( );
       }
+   return( rval);
+}
 
-   orbits_file = get_sof_file( sof_filename);
-   if( !orbits_file)
+static void release_day_pair( day_pair_t *pair)
+{
+   LOCK_ASTCHECK( );
+   pair->n_users--;
+   SIGNAL_ASTCHECK( );
+   UNLOCK_ASTCHECK( );
+}
+
+static void free_day_pairs( void)
+{
+   int i;
+
+   for( i = 0; i < N_DAY_PAIRS; i++)
       {
-      printf( "Couldn't open '%s'\n", sof_filename);
-      printf( "Astcheck gets orbital elements from 'mpcorb.sof'.  See\n"
-              "https://www.projectpluto.com/astcheck.htm#setup for details on\n"
-              "how to create/maintain that file.\n");
-      return( -2);
+      release_day_data( day_pairs[i].day_data[0]);
+      release_day_data( day_pairs[i].day_data[1]);
+      release_day_index( day_pairs[i].index);
       }
+   memset( day_pairs, 0, sizeof( day_pairs));
+}
+
+static void *station_registry;
 
-   ifile = fopen( is_list_file ? _dummy_filename : argv[1], "rb");
+   /* ObsCodes.html and (if found) 'rovers.txt' are parsed once at
+   startup into a hashed registry;  see mpc_code.cpp.  Codes in ObsCodes
+   take precedence.  Returns NULL if the station isn't found,  or isn't
+   on the earth.   */
+
+static const mpc_code_t *get_station_data( const char *code)
+{
+   const mpc_code_t *code_info = find_mpc_code( station_registry, code);
+
+   if( code_info && code_info->planet != 3)
+      code_info = NULL;
+   return( code_info);
+}
+
+static void *load_station_registry( void)
+{
+   FILE *ifile = get_file_from_path( "ObsCodes.html", "rb");
+   void *rval;
+
+   if( !ifile)        /* perhaps stored with truncated extension? */
+      ifile = get_file_from_path( "ObsCodes.htm", "rb");
    if( !ifile)
+      return( NULL);
+   rval = init_mpc_code_registry( );
+   if( rval)
       {
-      printf( "%s not opened\n", argv[1]);
-      err_message( );
-      return( -3);
+      add_mpc_codes_to_registry( rval, ifile);
+      fclose( ifile);
+      ifile = get_file_from_path( "rovers.txt", "rb");
+      if( ifile)
+         add_mpc_codes_to_registry( rval, ifile);
       }
+   if( ifile)
+      fclose( ifile);
+   return( rval);
+}
 
-               /* Read astrometry lines and allocate memory for them : */
-   ilines = (char **)malloc( (n_ilines + 1) * sizeof( char *));
-   n_ilines = 0;
-   while( fgets( buff, sizeof( buff), ifile))
-      if( !get_mpc_data( buff, &jd, &ra, &dec))
-         {
-         n_ilines++;
-         if( IS_POWER_OF_TWO( n_ilines))
-            ilines = (char **)realloc( ilines, n_ilines * 2 * sizeof( char *));
-         ilines[n_ilines - 1] = (char *)malloc( strlen( buff) + 1);
-         strcpy( ilines[n_ilines - 1], buff);
-         }
-   fclose( ifile);
-   if( is_list_file)
-#ifdef _WIN32                /* MS is different. */
-      _unlink( _dummy_filename);
-#else
-      unlink( _dummy_filename);
-#endif
-   if( !n_ilines)
-      {
-      printf( "No astrometry found in '%s'\n", argv[1]);
-      err_message( );
-      return( -1);
-      }
-   qsort( ilines, n_ilines, sizeof( char **), qsort_mpc_cmp);
-   for( n = 0; n < n_ilines; n++)
-      if( strlen( ilines[n]) >= 80
-                     && (!n || memcmp( ilines[n], ilines[n - 1], 12))
-                     && !get_mpc_data( ilines[n], &jd, &ra, &dec))
+   /* get_mpcorb_dot_dat_line( ) remembers the line length and offset
+   in static variables,  hence the lock.  */
+
+static int get_mpcorb_info( const int line_no, char *buff)
+{
+   int rval;
+
+   LOCK_ASTCHECK( );
+   rval = get_mpcorb_dot_dat_line( "mpcorb.dat", line_no, buff);
+   if( rval)
+      rval = get_mpcorb_dot_dat_line( "MPCORB.DAT", line_no, buff);
+   UNLOCK_ASTCHECK( );
+   return( rval);
+}
+
+   /* Checks the observations in 'obs' (which get sorted by object
+   and time) against the orbits,  writing results to 'ofile'.  Returns
+   the number of lines written,  or -1 on error.   */
+
+static int check_observations( mpc_obs_t *obs, const int n_obs,
+                  const check_options_t *opts, FILE *ofile)
+{
+   char buff[90];
+   int i, n;
+   int n_lines_printed = 0;
+   day_pair_t *day_pair = NULL;
+   int32_t *candidates = NULL;
+   int n_candidates_allocated = 0;
+   char curr_station[7];
+   int curr_station_code = -1;
+   const mpc_code_t *station = NULL;
+   void *locator = init_observer_locator( );
+   int results_array_size = 5;
+   char **results = (char **)calloc( results_array_size, sizeof( char *));
+   const double tolerance_in_arcsec = opts->tolerance_in_arcsec;
+   const bool is_list_file = opts->is_list_file;
+   const char *mpcorb_extracts = opts->mpcorb_extracts;
+
+   memset( curr_station, 0, sizeof( curr_station));
+   qsort( obs, n_obs, sizeof( mpc_obs_t), qsort_mpc_cmp);
+   for( n = 0; n < n_obs; n++)
+      if( !n || memcmp( obs[n].desig, obs[n - 1].desig, 12))
          {
-         double earth_loc[6], earth_loc2[6];
+         double jd = obs[n].jd;
+         const double ra = obs[n].ra, dec = obs[n].dec;
+         double earth_loc[6], earth_loc2[6], observer[6];
          double ra_motion = 0., dec_motion = 0., earth_sun_dist;
          const double cos_dec = cos( dec);
          const int16_t int_dec = (int16_t)integerize_angle( dec);
@@ -762,158 +1439,116 @@ int main( const int argc, const char **argv)
                           ( tolerance_in_arcsec * 65536 / (360. * 3600.));
          char tbuff[300];
          int n_results = 0;
-         int n_checked = 0;
+         int n_checked = 0, n_candidates, k;
          bool singleton_observation;
+         const AST_DATA *day0, *day1;
 
          jd += delta_t;
-         if( mpc_station_file && memcmp( ilines[n] + 77, curr_station, 3))
+         if( station_registry && obs[n].station != curr_station_code)
             {
-            int got_station_data = 0;
-
-            strlcpy_error( curr_station, ilines[n] + 77);
+            curr_station_code = obs[n].station;
+            memcpy( curr_station, obs[n].line + 77, 3);
             curr_station[3] = '\0';
-            fseek( mpc_station_file, 0L, SEEK_SET);
-            rho_sin_phi = rho_cos_phi = longitude = 0.;
-            while( !got_station_data &&
-                           fgets( tbuff, sizeof( tbuff), mpc_station_file))
-               got_station_data = !memcmp( tbuff, curr_station, 3);
-            if( !got_station_data)
-               {
-               FILE *rovers_file = get_file_from_path( "rovers.txt", "rb");
-
-               if( !rovers_file)
-                  {
-                  fprintf( stderr, "Couldn't open 'rovers.txt'\n");
-                  return( -1);
-                  }
-               while( !got_station_data &&
-                           fgets( tbuff, sizeof( tbuff), rovers_file))
-                  got_station_data = !memcmp( tbuff, curr_station, 3);
-               fclose( rovers_file);
-               }
-            if( got_station_data)
-               {
-               mpc_code_t code_info;
-               const int err_code = get_mpc_code_info( &code_info, tbuff);
-
-               if( err_code < 0)
-                  {
-                  fprintf( stderr, "Code '%s' not found; error %d\n", tbuff, err_code);
-                  got_station_data = 0;
-                  }
-               else
-                  {
-                  longitude = code_info.lon * 180. / PI;
-                  rho_cos_phi= code_info.rho_cos_phi;
-                  rho_sin_phi= code_info.rho_sin_phi;
-                  }
-               }
-            if( !got_station_data)
-               printf( "FAILED to find MPC code %s\n", curr_station);
-            longitude *= PI / 180.;
+            station = get_station_data( curr_station);
+            if( !station)
+               fprintf( ofile, "FAILED to find MPC code %s\n", curr_station);
             }
 
-         if( curr_loaded_day_data != (int)jd || !day_data[0] || !day_data[1])
+         if( !day_pair || day_pair->ijd != (int)jd)
             {
-            if( day_data[0])
-               free( day_data[0]);
-            if( day_data[1])
-               free( day_data[1]);
-            day_data[0] = get_cached_day_data( (int)jd);
-            day_data[1] = get_cached_day_data( (int)jd + 1);
-            curr_loaded_day_data = (int)jd;
+            if( day_pair)
+               release_day_pair( day_pair);
+            day_pair = acquire_day_pair( (int)jd);
             }
-         if( !n && show_header)     /* on our very first object: */
+         day0 = day_pair->day_data[0];
+         day1 = day_pair->day_data[1];
+         assert( day0);
+         assert( day1);
+         if( !n && opts->show_header)     /* on our very first object: */
             {
-            show_astcheck_info( );
-            printf( "An explanation of these data is given at the bottom of the list.\n");
+            show_astcheck_info( ofile);
+            fprintf( ofile, "An explanation of these data is given at the bottom of the list.\n");
             if( is_list_file)
                {
-               printf( "                           RA  (J2000)  dec       mag ");
-               printf( "  dRA/dt    dDec/dt\n");
+               fprintf( ofile, "                           RA  (J2000)  dec       mag ");
+               fprintf( ofile, "  dRA/dt    dDec/dt\n");
                }
             else
-               printf( "                             d_ra   d_dec    dist    mag  motion \n");
+               fprintf( ofile, "                             d_ra   d_dec    dist    mag  motion \n");
             }
          if( verbose)
-            printf( "JD %f, RA %f, dec %f\n",
+            fprintf( ofile, "JD %f, RA %f, dec %f\n",
                      jd, ra * 180. / PI, dec * 180. / PI);
-         jd2 = compute_motion( (const char **)ilines + n, n_ilines - n,
-                                 &ra_motion, &dec_motion);
+         jd2 = compute_motion( obs + n, n_obs - n, &ra_motion, &dec_motion);
          jd2 += delta_t;
-         earth_sun_dist =
-               get_topo_loc( jd, earth_loc, longitude, rho_cos_phi, rho_sin_phi);
-         get_topo_loc( jd2, earth_loc2, longitude, rho_cos_phi, rho_sin_phi);
-         memcpy( buff, ilines[n], 12);
+         memset( observer, 0, sizeof( observer));
+         if( station)
+            {
+            const double jd_utc[2] = { jd - delta_t, jd2 - delta_t };
+
+            compute_observer_vectors( locator, station, 2, jd_utc,
+                                          observer, NULL);
+            }
+         earth_sun_dist = get_topo_loc( jd, earth_loc, observer);
+         get_topo_loc( jd2, earth_loc2, observer + 3);
+         memcpy( buff, obs[n].desig, 12);
          buff[12] = '\0';
          singleton_observation = ( !ra_motion && !dec_motion);
          if( singleton_observation)
             {
             if( !is_list_file)
-               printf( "\n%s: only one observation\n", buff);
+               fprintf( ofile, "\n%s: only one observation\n", buff);
             }
          else
-#ifdef CGI_VERSION
-            printf( "\n<b>%s: %.0f\"/hr in RA, %.0f\"/hr in dec (%.2f hours)</b>\n",
-#else
-            printf( "\n%s: %.0f\"/hr in RA, %.0f\"/hr in dec (%.2f hours)\n",
-#endif
+            fprintf( ofile, (opts->html_output ?
+                  "\n<b>%s: %.0f\"/hr in RA, %.0f\"/hr in dec (%.2f hours)</b>\n" :
+                  "\n%s: %.0f\"/hr in RA, %.0f\"/hr in dec (%.2f hours)\n"),
                         buff, ra_motion, dec_motion, (jd2 - jd) * 24.);
          n_lines_printed++;
-         for( i = 0; i < n_asteroids; i++)
+         n_candidates = find_index_candidates( day_pair->index, int_ra, int_dec,
+                  tolerance + 5, &candidates, &n_candidates_allocated);
+         if( verbose)
+            fprintf( ofile, "%d candidates from index\n", n_candidates);
+         for( k = 0; k < (n_candidates < 0 ? n_asteroids : n_candidates); k++)
             {
             const int16_t tolerance2 = tolerance;
 
-            assert( day_data[0]);
-            assert( day_data[1]);
-            if( is_between( day_data[0][i].ra, day_data[1][i].ra, int_ra, tolerance2 + 5))
-               if( is_between( day_data[0][i].dec, day_data[1][i].dec, int_dec, tolerance2 + 5))
+            i = (n_candidates < 0 ? k : candidates[k]);   /* if < 0,  the  */
+                           /* search area was too big for the index to help */
+            if( is_between( day0[i].ra, day1[i].ra, int_ra, tolerance2 + 5))
+               if( is_between( day0[i].dec, day1[i].dec, int_dec, tolerance2 + 5))
                   {
-                  ELEMENTS class_elem;
+                  ELEMENTS class_elem = orbits[i].elem;
                   double ra1, dec1, mag;
                   double d_ra, d_dec;
-                  double earth_obj_dist, dist;
-                  int sof_rval = -999;
+                  double earth_obj_dist, dist, obj_sun_dist;
 
                   n_checked++;
-                  fseek( orbits_file, (i + 1) * record_length, SEEK_SET);
-                  if( fgets( tbuff, sizeof( tbuff), orbits_file))
-                     sof_rval = extract_sof_data( &class_elem, tbuff, sof_header);
-                  if( sof_rval)
-                     {
-                     fprintf( stderr, "Couldn't read .sof elements: ast %d, rval %d\n",
-                                    i, sof_rval);
-                     if( sof_rval != -999)
-                        fprintf( stderr, "%s", tbuff);
-                     exit( -1);
-                     }
-                  class_elem.is_asteroid = 1;
-                  if( tbuff[1] == '/' || strchr( "APXCD", tbuff[3]))
-                     class_elem.is_asteroid = 0;   /* it's a comet */
+                  memcpy( tbuff, orbits[i].name, 12);
                   earth_obj_dist = compute_asteroid_loc( earth_loc, &class_elem, jd,
-                           &ra1, &dec1);
+                           &ra1, &dec1, &obj_sun_dist);
                   mag = calc_obs_magnitude( &class_elem, obj_sun_dist,
                               earth_obj_dist, earth_sun_dist);
                   d_ra = centralize_angle( ra1 - ra) * cos_dec;
                   d_dec = dec1 - dec;
                   dist = sqrt( d_ra * d_ra + d_dec * d_dec);
                   dist *= radians_to_arcsec;
-                  if( mag < mag_limit && dist < tolerance_in_arcsec)
+                  if( mag < opts->mag_limit && dist < tolerance_in_arcsec)
                      {
                      double computed_ra_motion, computed_dec_motion;
                      double dt_in_hours = (jd2 - jd) * 24.;
 
                          /* Compute asteroid posn at second time for motion: */
                      compute_asteroid_loc( earth_loc2, &class_elem, jd2,
-                              &computed_ra_motion, &computed_dec_motion);
+                              &computed_ra_motion, &computed_dec_motion, NULL);
                      computed_ra_motion =
                            centralize_angle( computed_ra_motion - ra1) * cos_dec;
                      computed_dec_motion -= dec1;
                                  /* cvt motions from radians/day to "/hour: */
                      computed_ra_motion *=  radians_to_arcsec / dt_in_hours;
                      computed_dec_motion *= radians_to_arcsec / dt_in_hours;
-                     if( (fabs( computed_dec_motion - dec_motion) < motion_tolerance &&
-                           fabs( computed_ra_motion - ra_motion) < motion_tolerance)
+                     if( (fabs( computed_dec_motion - dec_motion) < opts->motion_tolerance &&
+                           fabs( computed_ra_motion - ra_motion) < opts->motion_tolerance)
                                     || singleton_observation)
                         {
                         char mpcorb_info[240];
@@ -923,7 +1558,7 @@ int main( const int argc, const char **argv)
                              /* Compute asteroid posn .1 days later, but same */
                              /* earth loc, for LOV computation:               */
                         compute_asteroid_loc( earth_loc, &class_elem, jd + .1,
-                              &ra2, &dec2);
+                              &ra2, &dec2, NULL);
                         ra2 = centralize_angle( ra2 - ra) * cos_dec;
                         dec2 -= dec;
                         ra2 -= d_ra;       /* (ra2, dec2) is now a vector pointing */
@@ -951,14 +1586,12 @@ int main( const int argc, const char **argv)
                         memset( tbuff + 12, ' ', 14);
 //                      snprintf( tbuff + strlen( tbuff), sizeof( tbuff) - strlen( tbuff),
 //                                            "  %.4f", earth_obj_dist);
-                        if( show_lov)
+                        if( opts->show_lov)
                            snprintf( tbuff + strlen( tbuff),
                                            sizeof( tbuff) - strlen( tbuff),
                                            "  %6.0f",
                                            dist_from_lov * radians_to_arcsec);
-                        if( mpcorb_extracts &&
-                                   (!get_mpcorb_dot_dat_line( "mpcorb.dat", i, mpcorb_info)
-                                 || !get_mpcorb_dot_dat_line( "MPCORB.DAT", i, mpcorb_info)))
+                        if( *mpcorb_extracts && !get_mpcorb_info( i, mpcorb_info))
                            {
                            const char *tptr = mpcorb_extracts;
 
@@ -968,10 +1601,8 @@ int main( const int argc, const char **argv)
                               char *endptr = tbuff + strlen( tbuff);
 
                               if( sscanf( tptr, "%d,%d", &start, &count) != 2)
-                                 {
-                                 fprintf( stderr, "Error parsing mpcorb extracts at '%s'\n", tptr);
-                                 exit( -1);
-                                 }
+                                 break;      /* shouldn't happen;  see */
+                                             /* check_mpcorb_extracts() */
                               *endptr++ = ' ';
                               memcpy( endptr, mpcorb_info + start - 1, count);
                               endptr[count] = '\0';
@@ -1004,42 +1635,453 @@ int main( const int argc, const char **argv)
             }
          for( i = 0; i < n_results; i++)
             {
-            if( i < max_results)
+            if( i < opts->max_results)
                {
-               printf( "%s\n", results[i]);
+               fprintf( ofile, "%s\n", results[i]);
                n_lines_printed++;
                }
             free( results[i]);
             }
          if( verbose)
-            printf( "%d objects had to be checked\n", n_checked);
+            fprintf( ofile, "%d objects had to be checked\n", n_checked);
          }
-   for( i= 0; i < n_ilines; i++)
-      free( ilines[i]);
-   free( ilines);
+   if( day_pair)
+      release_day_pair( day_pair);
    free( results);
-   if( day_data[0])
-      free( day_data[0]);
-   if( day_data[1])
-      free( day_data[1]);
-   fclose( orbits_file);
-   if( show_header)
-      printf( "The apparent motion and arc length for each object are shown,  followed\n"
+   if( candidates)
+      free( candidates);
+   free_observer_locator( locator);
+   return( n_lines_printed);
+}
+
+static void show_explanation( FILE *ofile, const check_options_t *opts,
+                  const int n_lines_printed, const double run_time)
+{
+   if( opts->show_header)
+      fprintf( ofile, "The apparent motion and arc length for each object are shown,  followed\n"
            "by a list of possible matches,  in order of increasing distance.  For\n"
            "each match,  the separation is shown,  both in RA and dec,  and then\n"
            "the 'total' separation,  all in arcseconds.  Next,  the magnitude and\n"
            "apparent motion of the possible match are shown.  All motions are in\n"
            "arcseconds per hour.\n");
-   if( !mpc_station_file)
-      printf( "ObsCodes.html not found; parallax wasn't included!\n");
-   else
-      fclose( mpc_station_file);
-   if( show_header)
-      printf( "\nRun time: %.1f seconds\n",
-                  (double)clock( ) / (double)CLOCKS_PER_SEC);
+   if( !station_registry)
+      fprintf( ofile, "ObsCodes.html not found; parallax wasn't included!\n");
+   if( opts->show_header)
+      fprintf( ofile, "\nRun time: %.1f seconds\n", run_time);
                      /* If the output was quite long,  re-display */
                      /* the explanation of the output :           */
-   if( n_lines_printed > 40 && show_header)
-      show_astcheck_info( );
+   if( n_lines_printed > 40 && opts->show_header)
+      show_astcheck_info( ofile);
+}
+
+   /* Input astrometry is kept as one block of text,  either a mapped
+   file of 80-column data or lines gathered into a single buffer (from
+   ADES,  or in server mode).  The text is parsed once,  into an array
+   of mpc_obs_t records pointing back into it.   */
+
+typedef struct
+{
+   char *text;
+   size_t text_size, text_alloced;
+   bool is_mapped;
+   mpc_obs_t *obs;
+   int n_obs;
+} obs_input_t;
+
+static void add_input_line( obs_input_t *input, const char *buff)
+{
+   size_t len = strlen( buff);
+
+   while( len && (buff[len - 1] == 10 || buff[len - 1] == 13))
+      len--;
+   if( input->text_size + len + 1 > input->text_alloced)
+      {
+      input->text_alloced = 2 * (input->text_size + len + 1) + 4096;
+      input->text = (char *)realloc( input->text, input->text_alloced);
+      assert( input->text);
+      }
+   memcpy( input->text + input->text_size, buff, len);
+   input->text_size += len;
+   input->text[input->text_size++] = '\n';
+}
+
+   /* Reads astrometry (80-column or ADES) from 'ifile'.  In server mode,
+   reading stops at a line reading 'END'.   */
+
+static void read_observations( FILE *ifile, obs_input_t *input,
+                                          const bool is_server)
+{
+   void *ades_context = init_ades2mpc( );
+   char buff[400];
+
+   while( fgets_with_ades_xlation( buff, sizeof( buff), ades_context, ifile)
+                  && (!is_server || strcmp( buff, "END")))
+      add_input_line( input, buff);
+   free_ades2mpc_context( ades_context);
+}
+
+   /* Plain 80-column files can just be mapped and used in place.  If the
+   file looks like ADES (XML or PSV),  we return false and it gets read
+   through the ADES translator instead.   */
+
+static bool map_observations( FILE *ifile, obs_input_t *input)
+{
+   size_t size;
+   char *text = (char *)map_open_file( ifile, &size);
+
+   if( !text)
+      return( false);
+   if( memchr( text, '<', size) || memchr( text, '|', size))
+      {
+      unmap_cache_file( text, size);
+      fseek( ifile, 0L, SEEK_SET);
+      return( false);
+      }
+   input->text = text;
+   input->text_size = size;
+   input->is_mapped = true;
+   return( true);
+}
+
+static int parse_input( obs_input_t *input)
+{
+   free( input->obs);
+   input->obs = NULL;
+   input->n_obs = 0;
+   if( input->text_size)
+      input->obs = parse_mpc_obs_buffer( input->text, input->text_size,
+                                        &input->n_obs);
+   return( input->n_obs);
+}
+
+static void free_input( obs_input_t *input)
+{
+   free( input->obs);
+   if( input->is_mapped)
+      unmap_cache_file( input->text, input->text_size);
+   else
+      free( input->text);
+   memset( input, 0, sizeof( obs_input_t));
+}
+
+/* Server mode.  Loading orbits and day data is a big part of astcheck's
+run time for small batches,  so we can instead keep running and check
+batch after batch.  Each batch may begin with a line of options,  e.g.,
+
+-r7200 -m20.5 -h
+
+   or,  to get a list of objects in an area,
+
+-c 2022apr3.1415 292.653 -7.653 E12 -r7200
+
+   followed by 80-column or ADES astrometry,  then a line reading 'END'.
+Results are written out followed by an 'END' line.  Batches can come in
+on stdin (results to stdout) with '-s',  or over a Unix socket with
+'-S(path)';  in the latter case,  each of the worker threads accepts
+connections and handles batches until the client hangs up.  */
+
+#define MAX_BATCH_ARGS 40
+
+static int run_one_batch( FILE *ifile, FILE *ofile,
+                               const check_options_t *default_opts)
+{
+   check_options_t opts = *default_opts;
+   char buff[400];
+   char fake_line[81];
+   obs_input_t input;
+   int c, n_lines_printed;
+   const int64_t t0 = nanoseconds_since_1970( );
+
+   memset( &input, 0, sizeof( input));
+   while( (c = getc( ifile)) == '-')      /* options line */
+      {
+      const char *argv[MAX_BATCH_ARGS];
+      char *tptr = buff;
+      int i, argc = 0;
+
+      buff[0] = '-';
+      if( !fgets( buff + 1, sizeof( buff) - 1, ifile))
+         break;
+      while( argc < MAX_BATCH_ARGS && *tptr)
+         {              /* split into tokens;  strtok() isn't reentrant */
+         while( *tptr && *tptr <= ' ')
+            *tptr++ = '\0';
+         if( *tptr)
+            argv[argc++] = tptr;
+         while( *tptr > ' ')
+            tptr++;
+         }
+      i = 0;
+      if( !strcmp( argv[0], "-c") && argc > 4)
+         {
+         make_fake_line( fake_line, argv[1], argv[2], argv[3], argv[4]);
+         add_input_line( &input, fake_line);
+         opts.is_list_file = true;
+         opts.max_results = 20000;
+         i = 5;
+         }
+      for( ; i < argc; i++)
+         if( argv[i][0] == '-' && argv[i][1])
+            if( !set_check_option( &opts, argv[i][1], get_arg( argc, argv, i)))
+               fprintf( ofile, "%s: unrecognized option\n", argv[i]);
+      }
+   if( c == EOF)
+      {
+      free_input( &input);
+      return( -1);
+      }
+   ungetc( c, ifile);
+   if( !opts.is_list_file)
+      read_observations( ifile, &input, true);
+   else        /* list mode has no observations;  just skip to the 'END' */
+      while( fgets( buff, sizeof( buff), ifile) && memcmp( buff, "END", 3))
+         ;
+   if( !parse_input( &input))
+      fprintf( ofile, "No astrometry found\n");
+   else
+      {
+      n_lines_printed = check_observations( input.obs, input.n_obs,
+                                                &opts, ofile);
+      if( n_lines_printed >= 0)
+         show_explanation( ofile, &opts, n_lines_printed,
+                     (double)( nanoseconds_since_1970( ) - t0) * 1e-9);
+      }
+   fprintf( ofile, "END\n");
+   fflush( ofile);
+   free_input( &input);
+   return( 0);
+}
+
+static void run_batches( FILE *ifile, FILE *ofile,
+                               const check_options_t *default_opts)
+{
+   while( !run_one_batch( ifile, ofile, default_opts))
+      ;
+}
+
+#ifdef ASTCHECK_SERVER
+typedef struct
+{
+   int listen_fd;
+   const check_options_t *default_opts;
+} server_t;
+
+static void *server_thread( void *arg)
+{
+   const server_t *server = (const server_t *)arg;
+   int fd;
+
+   while( (fd = accept( server->listen_fd, NULL, NULL)) >= 0)
+      {
+      FILE *ifile = fdopen( fd, "rb");
+      FILE *ofile = fdopen( dup( fd), "wb");
+
+      if( ifile && ofile)
+         run_batches( ifile, ofile, server->default_opts);
+      if( ofile)
+         fclose( ofile);
+      if( ifile)
+         fclose( ifile);
+      else
+         close( fd);
+      }
+   return( NULL);
+}
+
+static int run_socket_server( const char *socket_name, const int n_workers,
+                              const check_options_t *default_opts)
+{
+   struct sockaddr_un addr;
+   server_t server;
+   pthread_t *threads = (pthread_t *)calloc( n_workers, sizeof( pthread_t));
+   int i;
+
+   memset( &addr, 0, sizeof( addr));
+   addr.sun_family = AF_UNIX;
+   strlcpy_error( addr.sun_path, socket_name);
+   server.default_opts = default_opts;
+   server.listen_fd = socket( AF_UNIX, SOCK_STREAM, 0);
+   unlink( socket_name);
+   if( server.listen_fd < 0
+            || bind( server.listen_fd, (struct sockaddr *)&addr, sizeof( addr))
+            || listen( server.listen_fd, 16))
+      {
+      perror( socket_name);
+      free( threads);
+      return( -1);
+      }
+   signal( SIGPIPE, SIG_IGN);      /* clients hanging up shouldn't kill us */
+   fprintf( stderr, "astcheck: listening on '%s' with %d workers\n",
+                  socket_name, n_workers);
+   for( i = 0; i < n_workers; i++)
+      pthread_create( threads + i, NULL, server_thread, &server);
+   for( i = 0; i < n_workers; i++)
+      pthread_join( threads[i], NULL);
+   close( server.listen_fd);
+   unlink( socket_name);
+   free( threads);
+   return( 0);
+}
+#endif
+
+#ifdef CGI_VERSION
+int astcheck_main( const int argc, const char **argv)
+#else
+int main( const int argc, const char **argv)
+#endif
+{
+   FILE *ifile;
+   const char *sof_filename = "mpcorb.sof";
+   char fake_line[81];
+   obs_input_t input;
+   int i, first_option = 2, n_lines_printed;
+   int n_workers = 4;
+   const char *socket_name = NULL;
+   bool stdin_server = false;
+   FILE *msg_file = stdout;
+   check_options_t opts;
+
+   if( argc < 2)
+      {
+      err_message( );
+      return( -1);
+      }
+   default_check_options( &opts);
+   memset( &input, 0, sizeof( input));
+   if( !strcmp( argv[1], "-c"))
+      {
+      assert( argc > 5);
+      make_fake_line( fake_line, argv[2], argv[3], argv[4], argv[5]);
+      add_input_line( &input, fake_line);
+      opts.is_list_file = true;
+      opts.max_results = 20000;
+      first_option = 6;
+      }
+   else if( argv[1][0] == '-' && (argv[1][1] == 's' || argv[1][1] == 'S'))
+      {
+      first_option = 1;
+      msg_file = stderr;      /* stdout may be carrying results */
+      }
+   for( i = first_option; i < argc; i++)
+      if( argv[i][0] == '-')
+         {
+         const char *arg = get_arg( argc, argv, i);
+
+         assert( arg);
+         if( !set_check_option( &opts, argv[i][1], arg))
+            switch( argv[i][1])
+               {
+               case 'j':
+                  n_threads = atoi( arg);
+                  if( n_threads < 1)
+                     n_threads = 1;
+                  break;
+               case 'v':
+                  setvbuf( stdout, NULL, _IONBF, 0);
+                  verbose = 1 + atoi( arg);
+                  break;
+               case 'p':
+                  data_path = arg;
+                  break;
+#ifdef NOT_READY_QUITE_YET
+               case 'e':
+                  show_uncertainty = 1;
+                  break;
+#endif
+               case 'f':
+                  sof_filename = arg;
+                  break;
+               case 's':
+                  stdin_server = true;
+                  break;
+               case 'S':
+                  socket_name = (argv[i][2] ? argv[i] + 2 : "astcheck.sock");
+                  break;
+               case 'w':
+                  n_workers = atoi( arg);
+                  if( n_workers < 1)
+                     n_workers = 1;
+                  break;
+               default:
+                  fprintf( msg_file, "%s: unrecognized command-line option\n", argv[i]);
+                  break;
+               }
+         }
+   station_registry = load_station_registry( );
+   if( !station_registry)
+      {
+      fprintf( msg_file, "ObsCodes.html not found; parallax won't be included!\n");
+      fprintf( msg_file, "Astcheck can run without this file,  but will produce better\n");
+      fprintf( msg_file, "results if it has it :\n\n");
+      fprintf( msg_file, "https://www.minorplanetcenter.net/iau/lists/ObsCodes.html\n\n");
+      fprintf( msg_file, "Download this file and put it in the directory in which\n");
+      fprintf( msg_file, "astcheck is running.\n");
+      }
+
+   orbits_file = get_sof_file( sof_filename);
+   if( !orbits_file)
+      {
+      fprintf( msg_file, "Couldn't open '%s'\n", sof_filename);
+      fprintf( msg_file, "Astcheck gets orbital elements from 'mpcorb.sof'.  See\n"
+              "https://www.projectpluto.com/astcheck.htm#setup for details on\n"
+              "how to create/maintain that file.\n");
+      return( -2);
+      }
+
+   orbits = get_compiled_orbits( sof_filename);
+   fclose( orbits_file);
+
+   if( stdin_server || socket_name)
+      {
+      int rval = 0;
+
+      if( socket_name)
+#ifdef ASTCHECK_SERVER
+         rval = run_socket_server( socket_name, n_workers, &opts);
+#else
+         {
+         fprintf( stderr, "Socket server mode isn't available in this build\n");
+         rval = -4;
+         }
+#endif
+      else
+         run_batches( stdin, stdout, &opts);
+      free_day_pairs( );
+      free_compiled_sof( orbits, n_asteroids);
+      if( station_registry)
+         free_mpc_code_registry( station_registry);
+      return( rval);
+      }
+
+   if( !opts.is_list_file)
+      {
+      ifile = fopen( argv[1], "rb");
+      if( !ifile)
+         {
+         printf( "%s not opened\n", argv[1]);
+         err_message( );
+         return( -3);
+         }
+      if( !map_observations( ifile, &input))
+         read_observations( ifile, &input, false);
+      fclose( ifile);
+      }
+   if( !parse_input( &input))
+      {
+      printf( "No astrometry found in '%s'\n", argv[1]);
+      err_message( );
+      return( -1);
+      }
+   n_lines_printed = check_observations( input.obs, input.n_obs,
+                                                &opts, stdout);
+   free_input( &input);
+   free_day_pairs( );
+   free_compiled_sof( orbits, n_asteroids);
+   if( n_lines_printed < 0)
+      return( -1);
+   show_explanation( stdout, &opts, n_lines_printed,
+                  (double)clock( ) / (double)CLOCKS_PER_SEC);
+   if( station_registry)
+      free_mpc_code_registry( station_registry);
    return( 0);
 }
@@ -19,6 +19,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include "watdefs.h"
 #include "lunar.h"
@@ -91,39 +92,46 @@ the final series actually ends.)
    Since each header entry is a short int,  we're looking at 290 bytes.
 
    In a possibly misguided effort to save space (well,  it _did_ make
-lots of sense back in 1993!),  I store the header data needed for
-one particular planet in RAM at a given time.  If someone asks for
-a "new planet" (in big_vsop.cpp,  'if( curr_planet != planet)'),
-then we dig through 'big_vsop.bin' for the required header data
-and store it in a static array.  That requirement is for nineteen
-short integers:  there are three values to be computed (lat/lon/r)
-and six series for each of them (1, t, t^2, ...t^5),  and we need
-to know where the last of them ends.  So the static array 'cache'
-is dimensioned for 19 shorts.
-
-   We then use that data stored in 'cache' to go forth and grab
-VSOP data.  For longitude,  the coefficients for the (1, t, ...t^5)
-series are stored at offsets indicated by cache[0], cache[1], ...
-cache[5],  with the latter ending at cache[6] (that is,  the t^5
-series would have cache[6]-cache[5] terms.)  For latitude,
-the coefficients would be at offsets indicated by cache[6...11],
-and for heliocentric radius,  cache[12...17],  with the last
-t^5 term having cache[18]-cache[17] terms.
+lots of sense back in 1993!),  calc_big_vsop_loc( ) only reads in the
+data needed for one particular planet.  That requires nineteen short
+integers from the header:  there are three values to be computed
+(lat/lon/r) and six series for each of them (1, t, t^2, ...t^5),  and
+we need to know where the last of them ends.
+
+   We then use those offsets to go forth and grab VSOP data.  For
+longitude,  the coefficients for the (1, t, ...t^5) series are stored
+at offsets indicated by loc[0], loc[1], ... loc[5],  with the latter
+ending at loc[6] (that is,  the t^5 series would have loc[6]-loc[5]
+terms.)  For latitude,  the coefficients would be at offsets indicated
+by loc[6...11],  and for heliocentric radius,  loc[12...17],  with the
+last t^5 term having loc[18]-loc[17] terms.
 
    The actual file offset,  in bytes,  is going to be 24 bytes
 per term (each term consumes three double-precision floats) plus
 the 290 bytes for the header.  That's why the actual 'fseek' call
-in 'big_vsop.cpp' reads as
+in calc_big_vsop_loc( ) reads as
 
       fseek( ifile, 290L + (long)loc[0] * 24L, SEEK_SET);
-*/
+
+   Nowadays,  the whole file is but a few MBytes,  and it's better to
+read it all in once with load_big_vsop_data( ) and then call
+get_big_vsop_loc( ) for as many positions as you like.  See below. */
+
+#define BIG_VSOP_HEADER_SIZE 290L
+#define BIG_VSOP_TERM_SIZE (3L * (long)sizeof( double))
+#define N_BIG_VSOP_SERIES (8 * 3 * 6)
+
+/* Older,  slower way,  still supported.  This now reads only the header
+data for the planet in question,  then all of that planet's terms in one
+go,  and keeps no static data.  Note that 'prec' here is scaled by 1/t
+for each power of t.  */
 
 int DLL_FUNC calc_big_vsop_loc( FILE *ifile, const int planet,
                       double *ovals, double t, const double prec0)
 {
-   static int16_t cache[19];
-   static int curr_planet = 99;
-   int close_it = 0, value;
+   int16_t loc[19];
+   double *terms = NULL;
+   int close_it = 0, value, rval = 0;
 
    ovals[0] = ovals[1] = ovals[2] = 0.;
    if( !planet)
@@ -135,54 +143,416 @@ int DLL_FUNC calc_big_vsop_loc( FILE *ifile, const int planet,
       }
    if( !ifile)
       return( -1);                              /* ...then give up. */
-   if( curr_planet != planet)
-      {                             /* reload the cache */
-      fseek( ifile, (size_t)(planet - 1) * 6L * 3L * sizeof( int16_t), SEEK_SET);
-      if( !fread( cache, 3 * 6 + 1, sizeof( int16_t), ifile))
-         return( -2);
-      curr_planet = planet;
+   fseek( ifile, (long)(planet - 1) * 6L * 3L * (long)sizeof( int16_t), SEEK_SET);
+   if( !fread( loc, 3 * 6 + 1, sizeof( int16_t), ifile) || loc[18] < loc[0])
+      rval = -2;
+   else
+      {
+      const size_t n_terms = (size_t)( loc[18] - loc[0]);
+
+      terms = (double *)malloc( n_terms * BIG_VSOP_TERM_SIZE + 1);
+      fseek( ifile, BIG_VSOP_HEADER_SIZE + (long)loc[0] * BIG_VSOP_TERM_SIZE,
+                                 SEEK_SET);
+      if( !terms || (n_terms && !fread( terms, n_terms, BIG_VSOP_TERM_SIZE, ifile)))
+         rval = -3;
       }
+   if( close_it)
+      fclose( ifile);
 
    t /= 10.;         /* convert to julian millennia */
-   for( value = 0; value < 3; value++)
+   for( value = 0; !rval && value < 3; value++)
       {
-      double sum, rval = 0., power = 1., prec = prec0;
-      int16_t *loc = cache + value * 6;
+      double sum, total = 0., power = 1., prec = prec0;
+      const int16_t *lptr = loc + value * 6;
+      const double *tptr = terms + (lptr[0] - loc[0]) * 3;
       int i, j;
 
-      fseek( ifile, 290L + (size_t)loc[0] * 24L, SEEK_SET);
       if( prec < 0.)
          prec = -prec;
 
-      for( i = 6; i; i--, loc++)
+      for( i = 6; i; i--, lptr++)
          {
-         double idata[3];
-
          sum = 0.;
-         for( j = loc[1] - loc[0]; j; j--)
-            {
-            if( !fread( idata, 3, sizeof( double), ifile))
-               return( -3);
-            if( idata[0] > prec || idata[0] < -prec)
+         for( j = lptr[1] - lptr[0]; j; j--, tptr += 3)
+            if( tptr[0] > prec || tptr[0] < -prec)
                {
-               double argument = idata[1] + idata[2] * t;
+               double argument = tptr[1] + tptr[2] * t;
 
-               sum += idata[0] * cos( argument);
+               sum += tptr[0] * cos( argument);
                }
-            }
-         rval += sum * power;
+         total += sum * power;
          power *= t;
          if( t)
             prec /= t;
          }
-      ovals[value] = rval;
+      ovals[value] = total;
       }
+   free( terms);
+   if( rval)
+      return( rval);
 
+   ovals[0] = fmod( ovals[0], 2. * PI);
+   if( ovals[0] < 0.)
+      ovals[0] += 2. * PI;
+   return( 0);
+}
+
+/* The resident form of the data:  for each of the 144 series,  the terms
+with amplitude above the requested precision,  with the amplitudes,
+angles and rates each in their own array (so that the 'fast trig' code
+below can work on them a vector at a time.)  Series (planet - 1) * 18 +
+value * 6 + power is the one multiplied by t^power for 'value' (0=lon,
+1=lat,  2=r) for 'planet'.  */
+
+typedef struct
+{
+   int n_terms;
+   double *amplitude, *angle, *rate;
+} big_vsop_series_t;
+
+typedef struct
+{
+   int flags;
+   big_vsop_series_t series[N_BIG_VSOP_SERIES];
+} big_vsop_data_t;
+
+/* Reads in all of 'ifile' (or 'big_vsop.bin',  if ifile is NULL),
+keeping terms whose amplitude exceeds 'prec' (radians,  or AU for the
+radius.)  Unlike calc_big_vsop_loc( ),  'prec' isn't scaled with t;  for
+|t| < 1 millennium,  any dropped term contributes less than 'prec'.  If
+'flags' includes BIG_VSOP_FAST_TRIG,  get_big_vsop_loc( ) will use
+the vectorizable cosine/sine code below instead of the math library's.
+As with the PS-1996 series (see de_plan.cpp),  it's all one block of
+memory;  free it with unload_big_vsop_data( ).  The data are only read
+after this,  so any number of threads can use them at once.  */
+
+void * DLL_FUNC load_big_vsop_data( FILE *ifile, const double prec,
+                                        const int flags)
+{
+   int16_t offsets[N_BIG_VSOP_SERIES + 1];
+   big_vsop_data_t *rval = NULL;
+   double *raw = NULL, abs_prec = fabs( prec);
+   long n_raw, n_kept = 0;
+   int i, j, close_it = 0;
+
+   if( !ifile)
+      {
+      ifile = fopen( "big_vsop.bin", "rb");
+      if( !ifile)
+         return( NULL);
+      close_it = 1;
+      }
+   fseek( ifile, 0L, SEEK_SET);
+   if( fread( offsets, sizeof( int16_t), N_BIG_VSOP_SERIES + 1, ifile)
+                         == N_BIG_VSOP_SERIES + 1 && offsets[0] >= 0)
+      {
+      n_raw = (long)offsets[N_BIG_VSOP_SERIES];
+      for( i = 0; i < N_BIG_VSOP_SERIES; i++)
+         if( offsets[i + 1] < offsets[i])
+            n_raw = -1;
+      if( n_raw >= 0)
+         raw = (double *)malloc( (size_t)n_raw * BIG_VSOP_TERM_SIZE + 1);
+      if( raw && n_raw && !fread( raw, (size_t)n_raw, BIG_VSOP_TERM_SIZE, ifile))
+         {
+         free( raw);
+         raw = NULL;
+         }
+      }
    if( close_it)
       fclose( ifile);
+   if( !raw)
+      return( NULL);
+   for( i = 0; i < (int)n_raw; i++)
+      if( raw[i * 3] > abs_prec || raw[i * 3] < -abs_prec)
+         n_kept++;
+   rval = (big_vsop_data_t *)malloc( sizeof( big_vsop_data_t)
+                              + (size_t)n_kept * 3 * sizeof( double));
+   if( rval)
+      {
+      double *dptr = (double *)( rval + 1);
+
+      rval->flags = flags;
+      for( i = 0; i < N_BIG_VSOP_SERIES; i++)
+         {
+         big_vsop_series_t *series = rval->series + i;
+         int n = 0;
+
+         for( j = offsets[i]; j < offsets[i + 1]; j++)
+            if( raw[j * 3] > abs_prec || raw[j * 3] < -abs_prec)
+               n++;
+         series->n_terms = n;
+         series->amplitude = dptr;
+         series->angle = dptr + n;
+         series->rate = dptr + n * 2;
+         dptr += n * 3;
+         n = 0;
+         for( j = offsets[i]; j < offsets[i + 1]; j++)
+            if( raw[j * 3] > abs_prec || raw[j * 3] < -abs_prec)
+               {
+               series->amplitude[n] = raw[j * 3];
+               series->angle[n] = raw[j * 3 + 1];
+               series->rate[n] = raw[j * 3 + 2];
+               n++;
+               }
+         }
+      }
+   free( raw);
+   return( rval);
+}
+
+int DLL_FUNC unload_big_vsop_data( void *big_vsop_data)
+{
+   free( big_vsop_data);
+   return( 0);
+}
+
+/* Cosines and sines of n angles,  with no branches or library calls,  so
+the loop can be vectorized.  The angle is reduced to within pi/4 of a
+multiple of pi/2 (Cody-Waite reduction,  with pi/2 split into three parts
+as in fdlibm),  then the fdlibm kernel polynomials are evaluated for both
+cosine and sine and swapped/negated according to the quadrant.  Errors
+are at the 1e-16 level for the angles that arise in VSOP (up to a few
+million radians),  i.e.,  about the same as the rounding error in the
+angle itself.  The rounding to a multiple of pi/2 is done by adding and
+subtracting 1.5 * 2^52,  which leaves the nearest integer.  Also used by
+batch_comet_posn( ) in kepbatch.cpp.  */
+
+#define TWO_OVER_PI  6.36619772367581382433e-01
+#define PIO2_1       1.57079632673412561417e+00
+#define PIO2_2       6.07710050630396597660e-11
+#define PIO2_3       2.02226624871116645580e-21
+#define ROUNDER      6755399441055744.
+
+void DLL_FUNC fast_cos_sin( const double *angle, double *cos_angle,
+                                    double *sin_angle, const int n)
+{
+   int i;
+
+   for( i = 0; i < n; i++)
+      {
+      const double q = (angle[i] * TWO_OVER_PI + ROUNDER) - ROUNDER;
+      const double r = ((angle[i] - q * PIO2_1) - q * PIO2_2) - q * PIO2_3;
+      const double r2 = r * r;
+      const double s = r + r * r2 * (-1.66666666666666324348e-01
+               + r2 * (8.33333333332248946124e-03
+               + r2 * (-1.98412698298579493134e-04
+               + r2 * (2.75573137070700676789e-06
+               + r2 * (-2.50507602534068634195e-08
+               + r2 * 1.58969099521155010221e-10)))));
+      const double c = 1. - .5 * r2 + r2 * r2 * (4.16666666666666019037e-02
+               + r2 * (-1.38888888888741095749e-03
+               + r2 * (2.48015872894767294178e-05
+               + r2 * (-2.75573143513906633035e-07
+               + r2 * (2.08757232129817482790e-09
+               + r2 * -1.13596475577881948265e-11)))));
+      const int quadrant = (int)q & 3;
+      const double cs = ((quadrant & 1) ? s : c);
+      const double sn = ((quadrant & 1) ? c : s);
+
+      cos_angle[i] = (((quadrant + 1) & 2) ? -cs : cs);
+      sin_angle[i] = ((quadrant & 2) ? -sn : sn);
+      }
+}
+
+#define FAST_TRIG_CHUNK 64
+
+/* Sums amplitude * cos( angle + rate * t) over a series and,  if dsum
+isn't NULL,  the derivative of that with respect to t.  With the math
+library,  the sum is done term by term as in calc_big_vsop_loc( ),  so
+that (with prec=0) the results are identical.  */
+
+static double sum_big_vsop_series( const big_vsop_series_t *series,
+                     const double t, const int flags, double *dsum)
+{
+   double sum = 0., dsum_total = 0.;
+   int i, j;
+
+   if( !(flags & BIG_VSOP_FAST_TRIG))
+      for( i = 0; i < series->n_terms; i++)
+         {
+         const double argument = series->angle[i] + series->rate[i] * t;
+
+         sum += series->amplitude[i] * cos( argument);
+         if( dsum)
+            dsum_total -= series->amplitude[i] * series->rate[i]
+                                       * sin( argument);
+         }
+   else
+      for( i = 0; i < series->n_terms; i += FAST_TRIG_CHUNK)
+         {
+         const int n = (series->n_terms - i < FAST_TRIG_CHUNK ?
+                                 series->n_terms - i : FAST_TRIG_CHUNK);
+         const double *amplitude = series->amplitude + i;
+         const double *rate = series->rate + i;
+         double argument[FAST_TRIG_CHUNK], cos_arg[FAST_TRIG_CHUNK];
+         double sin_arg[FAST_TRIG_CHUNK];
+
+         for( j = 0; j < n; j++)
+            argument[j] = series->angle[i + j] + rate[j] * t;
+         fast_cos_sin( argument, cos_arg, sin_arg, n);
+         for( j = 0; j < n; j++)
+            sum += amplitude[j] * cos_arg[j];
+         if( dsum)
+            for( j = 0; j < n; j++)
+               dsum_total -= amplitude[j] * rate[j] * sin_arg[j];
+         }
+   if( dsum)
+      *dsum = dsum_total;
+   return( sum);
+}
+
+/* Computes the same mean heliocentric ecliptic longitude,  latitude (in
+radians) and radius (in AU) as calc_big_vsop_loc( ),  but from data loaded
+with load_big_vsop_data( ),  and without touching any other data;  any
+number of threads can call this at once.  't_cen' is in Julian centuries
+from J2000.  If 'ovals_rates' isn't NULL,  it gets the rates of change
+of the three values,  per day.  Returns -1 for a planet other than 0
+(the sun,  for which everything is zero) through 8.   */
+
+int DLL_FUNC get_big_vsop_loc( const void *big_vsop_data, const int planet,
+                  const double t_cen, double *ovals, double *ovals_rates)
+{
+   const big_vsop_data_t *vsop = (const big_vsop_data_t *)big_vsop_data;
+   const double t = t_cen / 10.;         /* convert to julian millennia */
+   int value;
+
+   for( value = 0; value < 3; value++)
+      {
+      ovals[value] = 0.;
+      if( ovals_rates)
+         ovals_rates[value] = 0.;
+      }
+   if( planet < 0 || planet > 8)
+      return( -1);
+   if( !planet)
+      return( 0);       /* the sun */
+   for( value = 0; value < 3; value++)
+      {
+      const big_vsop_series_t *series =
+                     vsop->series + (planet - 1) * 18 + value * 6;
+      double rval = 0., rate = 0., power = 1., prev_power = 0.;
+      int i;
+
+      for( i = 0; i < 6; i++, series++)
+         {
+         double dsum;
+         const double sum = sum_big_vsop_series( series, t, vsop->flags,
+                                 (ovals_rates ? &dsum : NULL));
+
+         rval += sum * power;
+         if( ovals_rates)
+            rate += dsum * power + (double)i * sum * prev_power;
+         prev_power = power;
+         power *= t;
+         }
+      ovals[value] = rval;
+      if( ovals_rates)
+         ovals_rates[value] = rate / 365250.;
+      }
 
    ovals[0] = fmod( ovals[0], 2. * PI);
    if( ovals[0] < 0.)
       ovals[0] += 2. * PI;
    return( 0);
 }
+
+#ifdef TEST_CODE
+
+/* Compares get_big_vsop_loc( ),  with and without BIG_VSOP_FAST_TRIG,  to
+calc_big_vsop_loc( ),  both for speed and for the largest differences in
+position (in AU) and in the rates (checked against numerical
+differentiation).  Run as
+
+big_vsop (n_times) (step in days)     */
+
+#include <time.h>
+
+static double seconds( void)
+{
+   return( (double)clock( ) / (double)CLOCKS_PER_SEC);
+}
+
+static double lbr_diff( const double *loc1, const double *loc2)
+{
+   double d_lon = loc1[0] - loc2[0];
+   const double d_lat = loc1[1] - loc2[1], d_r = loc1[2] - loc2[2];
+
+   if( d_lon > PI)
+      d_lon -= 2. * PI;
+   if( d_lon < -PI)
+      d_lon += 2. * PI;
+   return( sqrt( d_r * d_r + loc1[2] * loc1[2] * (d_lat * d_lat + d_lon * d_lon)));
+}
+
+int main( const int argc, const char **argv)
+{
+   FILE *ifile = fopen( "big_vsop.bin", "rb");
+   const int n_times = (argc > 1 ? atoi( argv[1]) : 100);
+   const double dt = (argc > 2 ? atof( argv[2]) : 10.) / 36525.;
+   const double t0 = -.05;
+   double time_old = 0., time_new = 0., time_fast = 0.;
+   double max_diff = 0., max_fast_diff = 0., max_rate_diff = 0.;
+   void *vsop_data, *fast_data;
+   int planet, i, j;
+
+   if( !ifile)
+      {
+      printf( "Couldn't open 'big_vsop.bin'\n");
+      return( -1);
+      }
+   vsop_data = load_big_vsop_data( ifile, 0., 0);
+   fast_data = load_big_vsop_data( ifile, 0., BIG_VSOP_FAST_TRIG);
+   if( !vsop_data || !fast_data)
+      {
+      printf( "Couldn't load 'big_vsop.bin'\n");
+      return( -2);
+      }
+   for( planet = 1; planet <= 8; planet++)
+      for( i = 0; i < n_times; i++)
+         {
+         const double t_cen = t0 + (double)i * dt;
+         double loc[3], loc2[3], loc3[3], rates[3], before[3], after[3];
+         double t = seconds( ), diff;
+         const double delta = .001;       /* days */
+
+         calc_big_vsop_loc( ifile, planet, loc, t_cen, 0.);
+         time_old += seconds( ) - t;
+         t = seconds( );
+         get_big_vsop_loc( vsop_data, planet, t_cen, loc2, rates);
+         time_new += seconds( ) - t;
+         t = seconds( );
+         get_big_vsop_loc( fast_data, planet, t_cen, loc3, NULL);
+         time_fast += seconds( ) - t;
+         diff = lbr_diff( loc, loc2);
+         if( max_diff < diff)
+            max_diff = diff;
+         diff = lbr_diff( loc, loc3);
+         if( max_fast_diff < diff)
+            max_fast_diff = diff;
+         get_big_vsop_loc( vsop_data, planet, t_cen - delta / 36525., before, NULL);
+         get_big_vsop_loc( vsop_data, planet, t_cen + delta / 36525., after, NULL);
+         if( after[0] < before[0] - PI)
+            after[0] += 2. * PI;
+         if( after[0] > before[0] + PI)
+            after[0] -= 2. * PI;
+         for( j = 0; j < 3; j++)
+            {
+            diff = fabs( (after[j] - before[j]) / (2. * delta) - rates[j]);
+            if( j < 2)
+               diff *= loc2[2];
+            if( max_rate_diff < diff)
+               max_rate_diff = diff;
+            }
+         }
+   printf( "calc_big_vsop_loc( ) : %f seconds\n", time_old);
+   printf( "get_big_vsop_loc( )  : %f seconds;  max diff %g AU\n",
+                     time_new, max_diff);
+   printf( "  (fast trig)        : %f seconds;  max diff %g AU\n",
+                     time_fast, max_fast_diff);
+   printf( "Max rate error %g AU/day\n", max_rate_diff);
+   fclose( ifile);
+   unload_big_vsop_data( vsop_data);
+   unload_big_vsop_data( fast_data);
+   return( 0);
+}
+#endif
@@ -21,6 +21,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 #include "cgi_func.h"
 #include "watdefs.h"
 #include "stringex.h"
+#ifndef _WIN32
+   #include <unistd.h>
+   #include <sys/socket.h>
+   #include <sys/un.h>
+#endif
 
 /* Code to invoke the 'astcheck' routine from an HTML form.
 You'll see a _lot_ of overlap between this and 'sat_id2.cpp',
@@ -35,10 +40,68 @@ or the Lowell astorb.dat files,  or both,  present (note that the code
 expects the lowercase filenames).  The results are similar with either
 database of orbital elements,  except that 'astorb' gives you current
 ephemeris uncertainties.
+
+   If an astcheck server is running (see 'astcheck.cpp'),  we just hand
+the observations to it and pass back the results,  avoiding the time
+spent loading orbits and day data.  The socket is given by the
+ASTCHECK_SOCKET environment variable,  defaulting to 'astcheck.sock'.
+If no server answers,  we run the check ourselves.
 */
 
 int astcheck_main( const int argc, const char **argv);    /* astcheck.c */
 
+   /* Returns 0 if the observations were checked by a server,  or -1 if
+   we couldn't connect to one.   */
+
+static int check_via_server( const int argc, const char **argv)
+{
+#ifdef _WIN32
+   INTENTIONALLY_UNUSED_PARAMETER( argc);
+   INTENTIONALLY_UNUSED_PARAMETER( argv);
+   return( -1);
+#else
+   const char *socket_name = getenv( "ASTCHECK_SOCKET");
+   struct sockaddr_un addr;
+   const int fd = socket( AF_UNIX, SOCK_STREAM, 0);
+   FILE *ifile, *ofile, *obs_file;
+   char buff[400];
+   int i;
+
+   if( fd < 0)
+      return( -1);
+   memset( &addr, 0, sizeof( addr));
+   addr.sun_family = AF_UNIX;
+   strlcpy_error( addr.sun_path, (socket_name ? socket_name : "astcheck.sock"));
+   if( connect( fd, (struct sockaddr *)&addr, sizeof( addr)))
+      {
+      close( fd);
+      return( -1);
+      }
+   ofile = fdopen( dup( fd), "wb");
+   ifile = fdopen( fd, "rb");
+   fprintf( ofile, "-H");              /* options,  then observations */
+   for( i = 2; i < argc; i++)
+      fprintf( ofile, " %s", argv[i]);
+   fprintf( ofile, "\n");
+   obs_file = fopen( argv[1], "rb");
+   if( obs_file)
+      {
+      *buff = '\0';
+      while( fgets( buff, sizeof( buff), obs_file))
+         fputs( buff, ofile);
+      fclose( obs_file);
+      if( *buff && buff[strlen( buff) - 1] != '\n')
+         fprintf( ofile, "\n");        /* make sure 'END' is on its own line */
+      }
+   fprintf( ofile, "END\n");
+   fclose( ofile);
+   while( fgets( buff, sizeof( buff), ifile) && strcmp( buff, "END\n"))
+      printf( "%s", buff);
+   fclose( ifile);
+   return( 0);
+#endif
+}
+
 int main( const int unused_argc, const char **unused_argv)
 {
    const char *argv[20];
@@ -123,7 +186,8 @@ int main( const int unused_argc, const char **unused_argv)
    snprintf_err( field, sizeof( field), "-r%.2f", search_radius * 3600.);  /* cvt degrees to arcsec */
    argv[argc++] = field;
    argv[argc] = NULL;
-   astcheck_main( argc, argv);
+   if( verbose || check_via_server( argc, argv))   /* verbose runs are */
+      astcheck_main( argc, argv);                   /* done in-process  */
    printf( "</pre> </body> </html>");
    return( 0);
 }
@@ -0,0 +1,513 @@
+/* cheb_eph.cpp: pre-fitted Chebyshev ephemerides
+
+Copyright (C) 2026, Project Pluto
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+02110-1301, USA.    */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#if !defined( _WIN32) && !defined( __WATCOMC__)
+   #include <sys/mman.h>
+#endif
+#include "watdefs.h"
+#include "lunar.h"
+
+/* Most of the theories in this library (VSOP,  ELP-82,  PS1996,  the
+satellite theories...) are evaluated term by term,  which can mean
+thousands of trig calls per position.  The functions in this file let
+you evaluate such a theory once,  over a range of dates,  and store it
+as a set of Chebyshev series,  much as JPL does for the DE ephemerides.
+After that,  getting a position (and velocity) just means finding the
+right segment and summing a dozen or so terms.
+
+   make_cheby_ephem( ) does the fitting.  You give it a 'source' function
+that returns a position (in whatever frame and units you like) for a
+given body and JD,  the body IDs wanted,  the date range,  the number of
+Chebyshev coefficients per segment,  and the largest error you'll accept.
+For each body,  the range is split into 1, 2, 4, 8... equal segments
+until every segment fits to within the tolerance.  Each segment is fitted
+by interpolating at the Chebyshev nodes (which gets you very close to the
+best possible fit),  and the error is checked at the points midway
+between the nodes and at the segment ends.  The 'cheb_gen' program shows
+how to do this for most of the theories in this library.
+
+   The resulting file can then be loaded with load_cheby_ephem( ),  and
+positions and velocities found with get_cheby_ephem_state( ).  The file
+is memory-mapped (on Windows,  just read in),  and never written to,  so
+any number of threads can use one loaded ephemeris.
+
+   The file layout is :
+
+   header (112 bytes) :
+      char magic[8]              "ChebEph"
+      int32_t byte_order         CHEBY_BYTE_ORDER,  as written
+      int32_t n_bodies
+      double jd_start, jd_end
+      char description[80]       frame/units/source,  as given by caller
+   n_bodies body records (64 bytes each) :
+      int32_t body_id, n_coeffs, n_segments, offset (from file start)
+      double seg_len (days), max_err
+      char name[24]
+      int32_t reserved[2]
+   coefficients for each body :  for each segment,  n_coeffs for x,
+      then n_coeffs for y,  then n_coeffs for z.
+
+   Data are in the byte order of the machine that wrote them;  a file
+written on a machine with the other byte order won't load.  */
+
+#define CHEBY_MAGIC          "ChebEph"
+#define CHEBY_BYTE_ORDER     0x01020304
+#define CHEBY_HEADER_SIZE    112
+#define CHEBY_BODY_SIZE      64
+#define CHEBY_DESC_LEN       80
+#define CHEBY_NAME_LEN       24
+#define MAX_CHEBY_COEFFS     32
+#define MAX_CHEBY_SEGMENTS   (1L << 22)
+
+typedef struct
+{
+   int32_t body_id, n_coeffs, n_segments, offset;
+   double seg_len, max_err;
+   char name[CHEBY_NAME_LEN];
+   int32_t reserved[2];
+} cheby_body_t;
+
+typedef struct
+{
+   char *data;
+   size_t size;
+   int n_bodies;
+   double jd_start, jd_end;
+   cheby_body_t *bodies;
+   const double **coeffs;
+} cheby_ephem_t;
+
+/* Sets tvals[0...n_coeffs-1] to T_j(x),  and (if dvals isn't NULL)
+dvals[] to the derivatives dT_j/dx.  */
+
+static void cheby_polys( double *tvals, double *dvals, const int n_coeffs,
+                                             const double x)
+{
+   int j;
+
+   tvals[0] = 1.;
+   tvals[1] = x;
+   for( j = 2; j < n_coeffs; j++)
+      tvals[j] = 2. * x * tvals[j - 1] - tvals[j - 2];
+   if( dvals)
+      {
+      dvals[0] = 0.;
+      dvals[1] = 1.;
+      for( j = 2; j < n_coeffs; j++)
+         dvals[j] = 2. * tvals[j - 1] + 2. * x * dvals[j - 1] - dvals[j - 2];
+      }
+}
+
+static double cheby_sum( const double *coeffs, const double *tvals,
+                                       const int n_coeffs)
+{
+   double rval = 0.;
+   int j;
+
+   for( j = n_coeffs - 1; j >= 0; j--)
+      rval += coeffs[j] * tvals[j];
+   return( rval);
+}
+
+/* Fits one segment,  running from jd0 to jd0 + seg_len,  by interpolating
+at the n_coeffs Chebyshev nodes.  'posns' is scratch space for the
+3 * n_coeffs positions.  Returns the largest error found at the points
+between the nodes and at the ends of the segment,  or a negative value
+if the source failed.  */
+
+static double fit_one_segment( cheby_source_t source, void *context,
+            const int body_id, const double jd0, const double seg_len,
+            const int n_coeffs, double *coeffs, double *posns)
+{
+   double tvals[MAX_CHEBY_COEFFS], max_err = 0.;
+   const double half_len = seg_len / 2., jd_mid = jd0 + half_len;
+   const double pi = 3.1415926535897932384626433832795028841971693993751;
+   int i, j, k;
+
+   for( k = 0; k < n_coeffs; k++)
+      {
+      const double x = cos( pi * ((double)k + .5) / (double)n_coeffs);
+
+      if( (*source)( context, body_id, jd_mid + half_len * x, posns + k * 3))
+         return( -1.);
+      }
+   for( j = 0; j < n_coeffs; j++)
+      {
+      double sum[3];
+
+      sum[0] = sum[1] = sum[2] = 0.;
+      for( k = 0; k < n_coeffs; k++)
+         {
+         const double tval =
+                  cos( pi * (double)j * ((double)k + .5) / (double)n_coeffs);
+
+         for( i = 0; i < 3; i++)
+            sum[i] += posns[k * 3 + i] * tval;
+         }
+      for( i = 0; i < 3; i++)
+         coeffs[i * n_coeffs + j] = sum[i] * (j ? 2. : 1.) / (double)n_coeffs;
+      }
+                  /* x = cos( pi * k / n_coeffs) puts us at the segment */
+                  /* ends (k = 0 and n_coeffs) or between two nodes :   */
+   for( k = 0; k <= n_coeffs; k++)
+      {
+      const double x = cos( pi * (double)k / (double)n_coeffs);
+      double loc[3];
+
+      if( (*source)( context, body_id, jd_mid + half_len * x, loc))
+         return( -1.);
+      cheby_polys( tvals, NULL, n_coeffs, x);
+      for( i = 0; i < 3; i++)
+         {
+         const double err = fabs( loc[i]
+                        - cheby_sum( coeffs + i * n_coeffs, tvals, n_coeffs));
+
+         if( max_err < err)
+            max_err = err;
+         }
+      }
+   return( max_err);
+}
+
+/* Fits all segments for one body,  doubling the number of segments until
+they all fit to within 'tolerance'.  On success,  *coeffs_out is a
+malloc()ed array of n_segments * 3 * n_coeffs coefficients.  */
+
+static int fit_one_body( cheby_source_t source, void *context,
+            cheby_body_t *body, const double jd_start, const double jd_end,
+            const double tolerance, double **coeffs_out)
+{
+   const int n_coeffs = body->n_coeffs;
+   double posns[MAX_CHEBY_COEFFS * 3];
+   long n_segments;
+
+   for( n_segments = 1; n_segments <= MAX_CHEBY_SEGMENTS; n_segments *= 2)
+      {
+      const double seg_len = (jd_end - jd_start) / (double)n_segments;
+      double *coeffs = (double *)malloc( (size_t)n_segments * 3
+                                 * (size_t)n_coeffs * sizeof( double));
+      double max_err = 0.;
+      long seg;
+
+      if( !coeffs)
+         return( -1);
+      for( seg = 0; seg < n_segments && max_err <= tolerance; seg++)
+         {
+         const double err = fit_one_segment( source, context, body->body_id,
+                  jd_start + (double)seg * seg_len, seg_len, n_coeffs,
+                  coeffs + seg * 3 * n_coeffs, posns);
+
+         if( err < 0.)
+            {
+            free( coeffs);
+            return( -2);
+            }
+         if( max_err < err)
+            max_err = err;
+         }
+      if( max_err <= tolerance)
+         {
+         body->n_segments = (int32_t)n_segments;
+         body->seg_len = seg_len;
+         body->max_err = max_err;
+         *coeffs_out = coeffs;
+         return( 0);
+         }
+      free( coeffs);
+      }
+   return( -3);
+}
+
+/* Fits the bodies listed in 'body_ids' and writes the result to 'ofile'.
+'names' can be NULL,  or give a name for each body;  'description' (can
+also be NULL) should say what frame,  units,  and theory were used.
+Returns 0 on success,  -1 if memory ran out,  -2 if the source function
+returned an error,  -3 if some body couldn't be fitted to 'tolerance'
+with any reasonable number of segments,  -4 for a write error,  -5 for
+bad parameters.  */
+
+int DLL_FUNC make_cheby_ephem( FILE *ofile, cheby_source_t source,
+            void *context, const int n_bodies, const int *body_ids,
+            const char **names, const char *description,
+            const double jd_start, const double jd_end,
+            const int n_coeffs, const double tolerance)
+{
+   char header[CHEBY_HEADER_SIZE];
+   const int32_t byte_order = CHEBY_BYTE_ORDER, n_bodies32 = n_bodies;
+   cheby_body_t *bodies;
+   double **coeffs;
+   long offset = CHEBY_HEADER_SIZE + (long)n_bodies * CHEBY_BODY_SIZE;
+   int i, rval = 0;
+
+   if( n_bodies < 1 || n_coeffs < 2 || n_coeffs > MAX_CHEBY_COEFFS
+                  || jd_end <= jd_start || tolerance <= 0.)
+      return( -5);
+   bodies = (cheby_body_t *)calloc( (size_t)n_bodies,
+                     sizeof( cheby_body_t) + sizeof( double *));
+   if( !bodies)
+      return( -1);
+   coeffs = (double **)( bodies + n_bodies);
+   for( i = 0; i < n_bodies && !rval; i++)
+      {
+      bodies[i].body_id = body_ids[i];
+      bodies[i].n_coeffs = n_coeffs;
+      if( names && names[i])
+         strncpy( bodies[i].name, names[i], CHEBY_NAME_LEN - 1);
+      rval = fit_one_body( source, context, bodies + i, jd_start, jd_end,
+                           tolerance, coeffs + i);
+      bodies[i].offset = (int32_t)offset;
+      offset += (long)bodies[i].n_segments * 3L * (long)n_coeffs
+                                          * (long)sizeof( double);
+      if( !rval && offset > 0x7fffffffL)     /* offsets are 32 bits */
+         rval = -3;
+      }
+   if( !rval)
+      {
+      memset( header, 0, CHEBY_HEADER_SIZE);
+      memcpy( header, CHEBY_MAGIC, strlen( CHEBY_MAGIC));
+      memcpy( header + 8, &byte_order, sizeof( int32_t));
+      memcpy( header + 12, &n_bodies32, sizeof( int32_t));
+      memcpy( header + 16, &jd_start, sizeof( double));
+      memcpy( header + 24, &jd_end, sizeof( double));
+      if( description)
+         strncpy( header + 32, description, CHEBY_DESC_LEN - 1);
+      if( !fwrite( header, CHEBY_HEADER_SIZE, 1, ofile)
+            || fwrite( bodies, CHEBY_BODY_SIZE, (size_t)n_bodies, ofile)
+                        != (size_t)n_bodies)
+         rval = -4;
+      }
+   for( i = 0; i < n_bodies && !rval; i++)
+      {
+      const size_t n_doubles = (size_t)bodies[i].n_segments * 3
+                                    * (size_t)n_coeffs;
+
+      if( fwrite( coeffs[i], sizeof( double), n_doubles, ofile) != n_doubles)
+         rval = -4;
+      }
+   for( i = 0; i < n_bodies; i++)
+      if( coeffs[i])
+         free( coeffs[i]);
+   free( bodies);
+   return( rval);
+}
+
+/* The binary ephemeris loaders (this file,  'de_plan.cpp' for PS-1996,
+'elp82dat.cpp' for ELP-82) all 'memory-map' their input (on Windows,  just
+read it in) and decode straight from it.  Returns NULL if the file is
+shorter than 'min_size' bytes or can't be mapped;  otherwise,  the mapped
+size goes to '*size',  to be passed back to unmap_file_data( ).   */
+
+char * DLL_FUNC map_file_for_reading( FILE *ifile, const size_t min_size,
+                                    size_t *size)
+{
+   char *rval = NULL;
+   long len;
+
+   fseek( ifile, 0L, SEEK_END);
+   len = ftell( ifile);
+   if( len < 0 || (size_t)len < min_size)
+      return( NULL);
+#if defined( _WIN32) || defined( __WATCOMC__)
+   rval = (char *)malloc( (size_t)len);
+   fseek( ifile, 0L, SEEK_SET);
+   if( rval && !fread( rval, (size_t)len, 1, ifile))
+      {
+      free( rval);
+      rval = NULL;
+      }
+#else
+   rval = (char *)mmap( NULL, (size_t)len, PROT_READ, MAP_SHARED,
+                           fileno( ifile), 0);
+   if( rval == (char *)MAP_FAILED)
+      rval = NULL;
+#endif
+   *size = (size_t)len;
+   return( rval);
+}
+
+void DLL_FUNC unmap_file_data( char *data, const size_t size)
+{
+#if defined( _WIN32) || defined( __WATCOMC__)
+   INTENTIONALLY_UNUSED_PARAMETER( size);
+   free( data);
+#else
+   munmap( data, size);
+#endif
+}
+
+/* Loads a file written by make_cheby_ephem( ).  Returns NULL if the file
+couldn't be read,  isn't a Chebyshev ephemeris file,  is truncated,  or
+was written with the other byte order.  */
+
+void * DLL_FUNC load_cheby_ephem( FILE *ifile)
+{
+   size_t size;
+   char *data = map_file_for_reading( ifile, CHEBY_HEADER_SIZE, &size);
+   cheby_ephem_t *rval;
+   int32_t byte_order, n_bodies;
+   int i;
+
+   if( !data)
+      return( NULL);
+   memcpy( &byte_order, data + 8, sizeof( int32_t));
+   memcpy( &n_bodies, data + 12, sizeof( int32_t));
+   if( memcmp( data, CHEBY_MAGIC, strlen( CHEBY_MAGIC))
+            || byte_order != CHEBY_BYTE_ORDER || n_bodies < 1
+            || size < CHEBY_HEADER_SIZE + (size_t)n_bodies * CHEBY_BODY_SIZE)
+      {
+      unmap_file_data( data, size);
+      return( NULL);
+      }
+   rval = (cheby_ephem_t *)malloc( sizeof( cheby_ephem_t)
+            + (size_t)n_bodies * (sizeof( cheby_body_t) + sizeof( double *)));
+   if( !rval)
+      {
+      unmap_file_data( data, size);
+      return( NULL);
+      }
+   rval->data = data;
+   rval->size = size;
+   rval->n_bodies = (int)n_bodies;
+   memcpy( &rval->jd_start, data + 16, sizeof( double));
+   memcpy( &rval->jd_end, data + 24, sizeof( double));
+   rval->bodies = (cheby_body_t *)( rval + 1);
+   rval->coeffs = (const double **)( rval->bodies + n_bodies);
+   memcpy( rval->bodies, data + CHEBY_HEADER_SIZE,
+                     (size_t)n_bodies * CHEBY_BODY_SIZE);
+   for( i = 0; i < n_bodies; i++)
+      {
+      const cheby_body_t *body = rval->bodies + i;
+
+      if( body->n_coeffs < 2 || body->n_coeffs > MAX_CHEBY_COEFFS
+               || body->n_segments < 1 || body->offset < 0
+               || body->offset % (int32_t)sizeof( double)
+               || (size_t)body->offset + (size_t)body->n_segments * 3
+                  * (size_t)body->n_coeffs * sizeof( double) > size)
+         {
+         unload_cheby_ephem( rval);
+         return( NULL);
+         }
+      rval->coeffs[i] = (const double *)( data + body->offset);
+      }
+   return( rval);
+}
+
+int DLL_FUNC unload_cheby_ephem( void *ephem)
+{
+   cheby_ephem_t *e = (cheby_ephem_t *)ephem;
+
+   unmap_file_data( e->data, e->size);
+   free( e);
+   return( 0);
+}
+
+/* For idx = 0 to n_bodies - 1,  sets *body_id,  name (which should have
+room for 24 bytes) and info[0...4] = start and end JDs,  segment length
+in days,  largest fitting error,  and number of coefficients,  and
+returns the number of bodies.  For idx = -1,  'name' gets the file's
+description (up to 80 bytes),  and info[0, 1] the JD range.  Returns -1
+if idx is out of range.  Any of the pointers can be NULL.  */
+
+int DLL_FUNC get_cheby_ephem_info( const void *ephem, const int idx,
+                           int *body_id, char *name, double *info)
+{
+   const cheby_ephem_t *e = (const cheby_ephem_t *)ephem;
+
+   if( idx < -1 || idx >= e->n_bodies)
+      return( -1);
+   if( info)
+      {
+      info[0] = e->jd_start;
+      info[1] = e->jd_end;
+      }
+   if( idx == -1)
+      {
+      if( name)
+         {
+         memcpy( name, e->data + 32, CHEBY_DESC_LEN);
+         name[CHEBY_DESC_LEN - 1] = '\0';
+         }
+      }
+   else
+      {
+      const cheby_body_t *body = e->bodies + idx;
+
+      if( body_id)
+         *body_id = body->body_id;
+      if( name)
+         {
+         memcpy( name, body->name, CHEBY_NAME_LEN);
+         name[CHEBY_NAME_LEN - 1] = '\0';
+         }
+      if( info)
+         {
+         info[2] = body->seg_len;
+         info[3] = body->max_err;
+         info[4] = (double)body->n_coeffs;
+         }
+      }
+   return( e->n_bodies);
+}
+
+/* Sets state_vect[0...2] to the position of 'body_id' at 'jd',  and (if
+compute_velocity is non-zero) state_vect[3...5] to the velocity,  in
+units per day.  Returns 0 on success,  -1 if the body isn't in the file,
+-2 if the JD is outside the range covered.  */
+
+int DLL_FUNC get_cheby_ephem_state( const void *ephem, const int body_id,
+            const double jd, double *state_vect, const int compute_velocity)
+{
+   const cheby_ephem_t *e = (const cheby_ephem_t *)ephem;
+   double tvals[MAX_CHEBY_COEFFS], dvals[MAX_CHEBY_COEFFS];
+   const cheby_body_t *body;
+   const double *coeffs;
+   double x;
+   int i, idx, n_coeffs;
+   long seg;
+
+   for( idx = 0; idx < e->n_bodies && e->bodies[idx].body_id != body_id;
+                  idx++)
+      ;
+   if( idx == e->n_bodies)
+      return( -1);
+   if( jd < e->jd_start || jd > e->jd_end)
+      return( -2);
+   body = e->bodies + idx;
+   n_coeffs = body->n_coeffs;
+   seg = (long)( (jd - e->jd_start) / body->seg_len);
+   if( seg >= body->n_segments)        /* can happen at jd == jd_end */
+      seg = body->n_segments - 1;
+   x = 2. * (jd - e->jd_start - (double)seg * body->seg_len) / body->seg_len
+                  - 1.;
+   cheby_polys( tvals, compute_velocity ? dvals : NULL, n_coeffs, x);
+   coeffs = e->coeffs[idx] + seg * 3 * n_coeffs;
+   for( i = 0; i < 3; i++, coeffs += n_coeffs)
+      {
+      state_vect[i] = cheby_sum( coeffs, tvals, n_coeffs);
+      if( compute_velocity)
+         state_vect[i + 3] = cheby_sum( coeffs, dvals, n_coeffs)
+                                    * 2. / body->seg_len;
+      }
+   return( 0);
+}
@@ -0,0 +1,484 @@
+/* cheb_gen.cpp: fits theories to Chebyshev series (see 'cheb_eph.cpp')
+
+Copyright (C) 2026, Project Pluto
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+02110-1301, USA.    */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "watdefs.h"
+#include "lunar.h"
+#include "afuncs.h"
+#include "gust86.h"
+
+/* 'cheb_gen' evaluates one of the series theories in this library over a
+range of dates,  and stores the result as Chebyshev series with
+make_cheby_ephem( ),  so that positions can then be had quickly with
+get_cheby_ephem_state( ).  Whatever the theory,  the output is in
+ecliptic J2000 coordinates,  in AU.  Body IDs are 1=Mercury,  ...
+9=Pluto,  10=Moon for the planetary theories,  and the NAIF numbers
+(501=Io,  601=Mimas,  etc.) for the satellite theories :
+
+   vsop      VSOP87 from 'vsop.bin';  heliocentric 1-8, geocentric 10
+   bigvsop   full VSOP87 from 'big_vsop.bin';  heliocentric 1-8
+   ps1996    PS1996 from 'ps_1996.dat';  heliocentric 1-9
+   elp       ELP-82 from 'elp82.dat';  geocentric 10
+   jsats     Galileans (Meeus/Lieske);  jovicentric 501-504
+   ssats     Saturnian satellites (Dourneau);  saturnicentric 601-609
+   gust86    Uranian satellites (GUST86);  uranicentric 701-705
+
+   For example,
+
+cheb_gen vsop 2415020.5 2488069.5 vsop.cheb -t 1 -v
+
+would fit the eight planets and the moon from VSOP and ELP-2000/82 (the
+truncated version in 'vsop.bin') over 1900-2100 to within a kilometre,
+then check the result and compare timings.
+
+   The fit can only be as smooth as the source.  PS1996,  for example,
+comes in blocks,  and positions jump slightly where blocks meet;  ask
+for a tolerance smaller than those jumps and the fitting will fail.  */
+
+#define PI 3.1415926535897932384626433832795028841971693993751058209749445923
+#define J2000 2451545.
+#define JUPITER_RADIUS_IN_KM 71492.
+#define GUST86_AU_IN_KM 149597870.
+#define DEFAULT_N_COEFFS 12
+#define MAX_BODIES 20
+
+typedef struct
+{
+   int source;
+   char *vsop_data;
+   void *data;
+} gen_context_t;
+
+#define SOURCE_VSOP           0
+#define SOURCE_BIG_VSOP       1
+#define SOURCE_PS1996         2
+#define SOURCE_ELP            3
+#define SOURCE_JSATS          4
+#define SOURCE_SSATS          5
+#define SOURCE_GUST86         6
+
+static const char *source_names[] = { "vsop", "bigvsop", "ps1996", "elp",
+                  "jsats", "ssats", "gust86", NULL };
+
+static const char *default_files[] = { "vsop.bin", "big_vsop.bin",
+                  "ps_1996.dat", "elp82.dat", NULL, NULL, NULL };
+
+static const char *descriptions[] = {
+      "VSOP87 (vsop.bin): heliocentric, Moon geocentric; ecliptic J2000, AU",
+      "VSOP87 (big_vsop.bin): heliocentric; ecliptic J2000, AU",
+      "PS1996: heliocentric; ecliptic J2000, AU",
+      "ELP-82: geocentric; ecliptic J2000, AU",
+      "Galileans (Lieske E5): jovicentric; ecliptic J2000, AU",
+      "Saturnian sats (Dourneau): saturnicentric; ecliptic J2000, AU",
+      "Uranian sats (GUST86): uranicentric; ecliptic J2000, AU" };
+
+static const char *planet_names[] = { "Sun", "Mercury", "Venus", "Earth",
+         "Mars", "Jupiter", "Saturn", "Uranus", "Neptune", "Pluto", "Moon" };
+
+static const char *sat_names[] = { "Io", "Europa", "Ganymede", "Callisto",
+         "Mimas", "Enceladus", "Tethys", "Dione", "Rhea", "Titan",
+         "Hyperion", "Iapetus", "Phoebe",
+         "Ariel", "Umbriel", "Titania", "Oberon", "Miranda" };
+
+static const char *body_name( const int body_id)
+{
+   if( body_id >= 0 && body_id <= 10)
+      return( planet_names[body_id]);
+   if( body_id > 500 && body_id < 505)
+      return( sat_names[body_id - 501]);
+   if( body_id > 600 && body_id < 610)
+      return( sat_names[body_id - 601 + 4]);
+   if( body_id > 700 && body_id < 706)
+      return( sat_names[body_id - 701 + 13]);
+   return( "?");
+}
+
+static int is_valid_body( const int source, const int body_id)
+{
+   switch( source)
+      {
+      case SOURCE_VSOP:
+         return( (body_id > 0 && body_id < 9) || body_id == 10);
+      case SOURCE_BIG_VSOP:
+         return( body_id > 0 && body_id < 9);
+      case SOURCE_PS1996:
+         return( body_id > 0 && body_id < 10);
+      case SOURCE_ELP:
+         return( body_id == 10);
+      case SOURCE_JSATS:
+         return( body_id > 500 && body_id < 505);
+      case SOURCE_SSATS:
+         return( body_id > 600 && body_id < 610);
+      case SOURCE_GUST86:         /* NAIF and GUST86 orders match */
+         return( body_id > 700 && body_id < 706);
+      }
+   return( 0);
+}
+
+/* The satellite theories and the full VSOP give ecliptic coordinates of
+date;  this takes them to J2000.  */
+
+static void ecliptic_of_date_to_j2000( double *xyz, const double jd)
+{
+   double matrix[9], tval[3];
+
+   setup_ecliptic_precession( matrix, 2000. + (jd - J2000) / 365.25, 2000.);
+   precess_vector( matrix, xyz, tval);
+   memcpy( xyz, tval, 3 * sizeof( double));
+}
+
+static void equatorial_to_ecliptic_j2000( double *xyz)
+{
+   const double obliq_2000 = 23.4392911 * PI / 180.;
+
+   rotate_vector( xyz, -obliq_2000, 0);
+}
+
+static int get_source_posn( void *context, const int body_id,
+                  const double jd, double *xyz)
+{
+   gen_context_t *c = (gen_context_t *)context;
+   const double t_cen = (jd - J2000) / 36525.;
+   double ovals[15], tbuff[15];
+   int rval = 0;
+
+   switch( c->source)
+      {
+      case SOURCE_VSOP:
+         compute_planet_frames( c->vsop_data, body_id, t_cen,
+                              PLANET_ECLIPTIC_J2000, NULL, ovals);
+         memcpy( xyz, ovals + 12, 3 * sizeof( double));
+         break;
+      case SOURCE_BIG_VSOP:
+         rval = get_big_vsop_loc( c->data, body_id, t_cen, ovals, NULL);
+         polar3_to_cartesian( xyz, ovals[0], ovals[1]);
+         xyz[0] *= ovals[2];
+         xyz[1] *= ovals[2];
+         xyz[2] *= ovals[2];
+         ecliptic_of_date_to_j2000( xyz, jd);
+         break;
+      case SOURCE_PS1996:
+         rval = get_ps1996_state( c->data, body_id, jd, tbuff, 0);
+         memcpy( xyz, tbuff, 3 * sizeof( double));
+         equatorial_to_ecliptic_j2000( xyz);
+         break;
+      case SOURCE_ELP:
+         rval = get_elp82_position( c->data, t_cen, tbuff);
+         xyz[0] = tbuff[0] / AU_IN_KM;
+         xyz[1] = tbuff[1] / AU_IN_KM;
+         xyz[2] = tbuff[2] / AU_IN_KM;
+         break;
+      case SOURCE_JSATS:
+         calc_jsat_loc( jd, tbuff, 1 << (body_id - 501), 0L);
+         xyz[0] = tbuff[(body_id - 501) * 3] * JUPITER_RADIUS_IN_KM / AU_IN_KM;
+         xyz[1] = tbuff[(body_id - 501) * 3 + 1] * JUPITER_RADIUS_IN_KM / AU_IN_KM;
+         xyz[2] = tbuff[(body_id - 501) * 3 + 2] * JUPITER_RADIUS_IN_KM / AU_IN_KM;
+         ecliptic_of_date_to_j2000( xyz, jd);
+         break;
+      case SOURCE_SSATS:
+         rval = calc_ssat_loc( jd, xyz, body_id - 601, 0L);
+         ecliptic_of_date_to_j2000( xyz, jd);
+         break;
+      case SOURCE_GUST86:     /* gives equatorial J2000,  in old 'AU's */
+         gust86_posn( jd, body_id - 701, tbuff);
+         xyz[0] = tbuff[0] * GUST86_AU_IN_KM / AU_IN_KM;
+         xyz[1] = tbuff[1] * GUST86_AU_IN_KM / AU_IN_KM;
+         xyz[2] = tbuff[2] * GUST86_AU_IN_KM / AU_IN_KM;
+         equatorial_to_ecliptic_j2000( xyz);
+         break;
+      }
+   return( rval);
+}
+
+static char *load_vsop_data( const char *filename)
+{
+   FILE *ifile = fopen( filename, "rb");
+   const size_t vsop_size = 60874u;
+   char *rval = NULL;
+
+   if( ifile)
+      {
+      rval = (char *)malloc( vsop_size);
+      if( rval && fread( rval, 1, vsop_size, ifile) != vsop_size)
+         {
+         free( rval);
+         rval = NULL;
+         }
+      fclose( ifile);
+      }
+   return( rval);
+}
+
+/* Compares the fitted ephemeris to the source at 'n_checks' random times,
+showing the worst position and velocity differences for each body and
+the time taken for each method.  */
+
+static void check_ephem( const void *ephem, gen_context_t *context,
+               const int n_bodies, const int *body_ids,
+               const double jd_start, const double jd_end, const int n_checks)
+{
+   int i, j, k;
+
+   srand( 1);
+   for( i = 0; i < n_bodies; i++)
+      {
+      double max_err = 0., max_verr = 0., src_time, cheb_time, sum = 0.;
+      double *jds = (double *)malloc( (size_t)n_checks * sizeof( double));
+      clock_t t0;
+
+      if( !jds)
+         return;
+      for( j = 0; j < n_checks; j++)
+         jds[j] = jd_start + (jd_end - jd_start) * (double)rand()
+                                    / (double)RAND_MAX;
+      for( j = 0; j < n_checks; j++)
+         {
+         const double delta = .001;        /* days */
+         double loc[3], loc1[3], loc2[3], state[6];
+
+         get_source_posn( context, body_ids[i], jds[j], loc);
+         get_cheby_ephem_state( ephem, body_ids[i], jds[j], state, 1);
+         if( jds[j] - delta >= jd_start && jds[j] + delta <= jd_end)
+            {
+            get_source_posn( context, body_ids[i], jds[j] - delta, loc1);
+            get_source_posn( context, body_ids[i], jds[j] + delta, loc2);
+            for( k = 0; k < 3; k++)
+               {
+               const double vel = (loc2[k] - loc1[k]) / (2. * delta);
+
+               if( max_verr < fabs( vel - state[k + 3]))
+                  max_verr = fabs( vel - state[k + 3]);
+               }
+            }
+         for( k = 0; k < 3; k++)
+            if( max_err < fabs( loc[k] - state[k]))
+               max_err = fabs( loc[k] - state[k]);
+         }
+      t0 = clock( );
+      for( j = 0; j < n_checks; j++)
+         {
+         double loc[3];
+
+         get_source_posn( context, body_ids[i], jds[j], loc);
+         sum += loc[0];
+         }
+      src_time = (double)( clock( ) - t0) / (double)CLOCKS_PER_SEC;
+      t0 = clock( );
+      for( j = 0; j < n_checks; j++)
+         {
+         double state[6];
+
+         get_cheby_ephem_state( ephem, body_ids[i], jds[j], state, 0);
+         sum -= state[0];
+         }
+      cheb_time = (double)( clock( ) - t0) / (double)CLOCKS_PER_SEC;
+      printf( "%-9s max err %.3g km;  vel err %.3g km/day;  "
+               "%.3g vs %.3g us/call\n", body_name( body_ids[i]),
+               max_err * AU_IN_KM, max_verr * AU_IN_KM,
+               src_time * 1e+6 / (double)n_checks,
+               cheb_time * 1e+6 / (double)n_checks);
+      if( fabs( sum) > 1.)    /* just to keep the loops from being */
+         printf( "?\n");      /* optimized out                     */
+      free( jds);
+      }
+}
+
+static void error_exit( void)
+{
+   size_t i;
+
+   printf( "Usage: cheb_gen (source) (JD start) (JD end) (output file) [options]\n"
+      "\n"
+      "Options are:\n"
+      "   -b(list)  Bodies to fit,  comma separated (default is all)\n"
+      "   -f(name)  Data file for the source (default depends on source)\n"
+      "   -n(#)     Number of Chebyshev coefficients per segment (default %d)\n"
+      "   -t(#)     Largest allowed error,  in km (default 1)\n"
+      "   -v        Check the result against the source,  and time both\n"
+      "\nSources are:", DEFAULT_N_COEFFS);
+   for( i = 0; source_names[i]; i++)
+      printf( " %s", source_names[i]);
+   printf( "\nSee 'cheb_gen.cpp' for details.\n");
+   exit( -1);
+}
+
+int main( const int argc, const char **argv)
+{
+   gen_context_t context;
+   const char *filename = NULL;
+   const char *names[MAX_BODIES];
+   int body_ids[MAX_BODIES], n_bodies = 0, n_coeffs = DEFAULT_N_COEFFS;
+   int i, rval, verify = 0;
+   double tolerance_in_km = 1., jd_start, jd_end;
+   FILE *ifile = NULL, *ofile;
+
+   if( argc < 5)
+      error_exit( );
+   for( context.source = 0; source_names[context.source]
+            && strcmp( source_names[context.source], argv[1]);
+               context.source++)
+      ;
+   if( !source_names[context.source])
+      {
+      printf( "Unknown source '%s'\n", argv[1]);
+      error_exit( );
+      }
+   jd_start = atof( argv[2]);
+   jd_end = atof( argv[3]);
+   for( i = 5; i < argc; i++)
+      if( argv[i][0] == '-')
+         {
+         const char *arg = (argv[i][2] || i == argc - 1) ?
+                        argv[i] + 2 : argv[i + 1];
+
+         switch( argv[i][1])
+            {
+            case 'b':
+               while( *arg && n_bodies < MAX_BODIES)
+                  {
+                  body_ids[n_bodies++] = atoi( arg);
+                  while( *arg && *arg != ',')
+                     arg++;
+                  if( *arg == ',')
+                     arg++;
+                  }
+               break;
+            case 'f':
+               filename = arg;
+               break;
+            case 'n':
+               n_coeffs = atoi( arg);
+               break;
+            case 't':
+               tolerance_in_km = atof( arg);
+               break;
+            case 'v':
+               verify = 1;
+               break;
+            default:
+               printf( "Unrecognized option '%s'\n", argv[i]);
+               error_exit( );
+               break;
+            }
+         }
+   if( !n_bodies)
+      for( i = 1; i < 710; i++)
+         if( is_valid_body( context.source, i))
+            body_ids[n_bodies++] = i;
+   for( i = 0; i < n_bodies; i++)
+      {
+      if( !is_valid_body( context.source, body_ids[i]))
+         {
+         printf( "Body %d isn't available from %s\n", body_ids[i], argv[1]);
+         return( -1);
+         }
+      names[i] = body_name( body_ids[i]);
+      }
+
+   context.vsop_data = NULL;
+   context.data = NULL;
+   if( !filename)
+      filename = default_files[context.source];
+   if( context.source == SOURCE_VSOP)
+      context.vsop_data = load_vsop_data( filename);
+   else if( filename)
+      {
+      ifile = fopen( filename, "rb");
+      if( ifile && context.source == SOURCE_BIG_VSOP)
+         context.data = load_big_vsop_data( ifile, 0., 0);
+      if( ifile && context.source == SOURCE_PS1996)
+         context.data = load_ps1996_file( ifile, 0);
+      if( ifile && context.source == SOURCE_ELP)
+         context.data = load_elp82_data( ifile, 0.);
+      }
+   if( filename && !context.vsop_data && !context.data)
+      {
+      printf( "Couldn't load '%s'\n", filename);
+      return( -1);
+      }
+
+   ofile = fopen( argv[4], "wb");
+   if( !ofile)
+      {
+      printf( "Couldn't open '%s'\n", argv[4]);
+      return( -1);
+      }
+   rval = make_cheby_ephem( ofile, get_source_posn, &context, n_bodies,
+               body_ids, names, descriptions[context.source], jd_start,
+               jd_end, n_coeffs, tolerance_in_km / AU_IN_KM);
+   fclose( ofile);
+   if( rval)
+      {
+      const char *messages[5] = { "Out of memory",
+               "Source couldn't compute a position (outside its date range?)",
+               "Couldn't fit to the tolerance;  try larger -t or -n",
+               "Error writing file", "Bad parameters" };
+
+      printf( "Error %d in fitting:  %s\n", rval, messages[-1 - rval]);
+      }
+   else
+      {
+      void *ephem;
+
+      ofile = fopen( argv[4], "rb");
+      ephem = (ofile ? load_cheby_ephem( ofile) : NULL);
+      if( !ephem)
+         {
+         printf( "Couldn't reload '%s'\n", argv[4]);
+         rval = -1;
+         }
+      else
+         {
+         for( i = 0; i < n_bodies; i++)
+            {
+            double info[5];
+            int body_id;
+
+            get_cheby_ephem_info( ephem, i, &body_id, NULL, info);
+            printf( "%3d %-9s %8.4f-day segments, max err %.3g km\n",
+                     body_id, body_name( body_id), info[2],
+                     info[3] * AU_IN_KM);
+            }
+         if( verify)
+            check_ephem( ephem, &context, n_bodies, body_ids, jd_start,
+                              jd_end, 10000);
+         unload_cheby_ephem( ephem);
+         }
+      if( ofile)
+         fclose( ofile);
+      }
+   if( context.vsop_data)
+      free( context.vsop_data);
+   if( context.data)
+      {
+      if( context.source == SOURCE_BIG_VSOP)
+         unload_big_vsop_data( context.data);
+      if( context.source == SOURCE_PS1996)
+         unload_ps1996_file( context.data);
+      if( context.source == SOURCE_ELP)
+         unload_elp82_data( context.data);
+      }
+   if( ifile)
+      fclose( ifile);
+   return( rval);
+}
@@ -39,6 +39,7 @@ ELEMENTS
 extern "C" {
 #endif
 
+#include <stdio.h>
 #include <stdint.h>
 
 // void calc_vectors( ELEMENTS *elem, const double sqrt_gm);
@@ -59,6 +60,23 @@ int extract_sof_data_ex( ELEMENTS *elem, const char *buff, const char *header,
                         double *extra_info);                /* sof.cpp */
 double extract_yyyymmdd_to_jd( const char *buff);           /* sof.cpp */
 
+typedef struct
+{
+   ELEMENTS elem;
+   char name[16];          /* first 12 bytes of the SOF record */
+} sof_record_t;
+
+int32_t compute_sof_checksum( FILE *sof_file);              /* sof.cpp */
+int write_compiled_sof( FILE *ofile, FILE *sof_file);       /* sof.cpp */
+sof_record_t *load_compiled_sof( const char *filename,
+                  const int32_t checksum, int *n_records);  /* sof.cpp */
+void free_compiled_sof( sof_record_t *recs, const int n_records);
+void *init_kepler_batch( const ELEMENTS *elems, const size_t elem_stride,
+                                      const int n_elems);  /* kepbatch.cpp */
+void batch_comet_posn( const void *batch, const int start, const int n,
+                           const double *t, double *loc, double *vel);
+void free_kepler_batch( void *batch);                  /* kepbatch.cpp */
+
 typedef struct
 {
    double obj1_true_anom, jd1;       /* these are set in find_moid_full */
@@ -105,6 +105,19 @@ static inline int unpack_six_doubles( double *ovals, const char *ibuff)
    return( (int)( iptr - ibuff));
 }
 
+/* A block consists of the twelve secular coefficients,  then six packed
+coefficients for each frequency.  */
+
+static void unpack_ps1996_block( POISSON *p, const char *tptr)
+{
+   int i;
+
+   memcpy( p->secular, tptr, 12 * sizeof( double));
+   tptr += 12 * sizeof( double);
+   for( i = 0; i < p->total_fqs; i++)
+      tptr += unpack_six_doubles( p->terms + i * 6, tptr);
+}
+
 /* This function loads up the series for a given planet,  at a given time,
 from a given file.  If you've already got PS_1996.DAT opened,  as Guide
 usually does,  then you can just pass in the file pointer.  If not,  no
@@ -126,6 +139,10 @@ Second,  freeing up the buffer when you're done with it is much easier
 
    Next,  we read in the data.  The coefficients are read using the
 above unpack_six_doubles() function.
+
+   If you're going to want positions for more than one planet or block,
+consider load_ps1996_file( ) and get_ps1996_state( ) (below) instead;
+they read the file once and keep recently used blocks unpacked.
 */
 
 void * DLL_FUNC load_ps1996_series( FILE *ifile, double jd, int planet_no)
@@ -136,7 +153,7 @@ void * DLL_FUNC load_ps1996_series( FILE *ifile, double jd, int planet_no)
    int16_t block_sizes[30];
    int block, i, close_file = 0;
    POISSON_HEADER header;
-   char *tbuff, *tptr;
+   char *tbuff;
    POISSON p;
    POISSON *rval;
 
@@ -198,10 +215,7 @@ void * DLL_FUNC load_ps1996_series( FILE *ifile, double jd, int planet_no)
          free( tbuff);
       return( NULL);
       }
-   memcpy( p.secular, tbuff, 12 * sizeof( double));
-   tptr = tbuff + 12 * sizeof( double);
-   for( i = 0; i < p.total_fqs; i++)
-      tptr += unpack_six_doubles( p.terms + i * 6, tptr);
+   unpack_ps1996_block( &p, tbuff);
    free( tbuff);
    if( close_file)
       fclose( ifile);
@@ -312,6 +326,427 @@ int DLL_FUNC get_ps1996_position( const double jd, const void *iptr,
    return( 0);
 }
 
+/* get_ps1996_positions( ) computes the same state vectors as the above
+get_ps1996_position( ),  but for n_times evenly spaced times jd0, jd0 +
+step, ... jd0 + (n_times - 1) * step,  all of which must be within the
+block.  The results go to state_vects,  three (or,  if compute_velocity
+is non-zero,  six) doubles per time.
+
+   Instead of calling cos( ) and sin( ) for each frequency at each time,
+it gets them for the first of each PS1996_CHUNK times and for the step,
+then rotates forward by the step for the rest of the chunk.  Restarting
+each chunk keeps the results within 1e-12 AU of get_ps1996_position( );
+most of what difference there is comes from rounding of the arguments,
+which get_ps1996_position( ) has too.  The sums for each frequency are
+then done for all times in the chunk at once,  in loops that can be
+vectorized.  */
+
+#define PS1996_CHUNK 32
+
+static void get_ps1996_chunk( const POISSON *p, const double jd0,
+            const double step, const int n_times, double *state_vects,
+            const int compute_velocity)
+{
+   const int stride = (compute_velocity ? 6 : 3);
+   const double *fq_ptr = p->fqs;
+   const double *term_ptr = p->terms;
+   double x[PS1996_CHUNK], fx[PS1996_CHUNK], wx[PS1996_CHUNK];
+   double cos_term[PS1996_CHUNK], sin_term[PS1996_CHUNK];
+   double sums[6][PS1996_CHUNK];
+   int i, j, k, m;
+
+   for( k = 0; k < n_times; k++)
+      {
+      double *state_vect = state_vects + k * stride;
+      const double *sec_ptr = p->secular;
+
+      x[k] = 2. * (jd0 + (double)k * step - p->tzero) / p->dt - 1.;
+      fx[k] = x[k] * p->dt / 2.;
+      wx[k] = 1.;
+      for( i = 0; i < 3; i++)       /* secular terms first: */
+         {
+         double power = 1., prev_power = 1.;
+
+         state_vect[i] = 0.;
+         if( compute_velocity)
+            state_vect[i + 3] = 0.;
+         for( j = 0; j < 4; j++)
+            {
+            if( compute_velocity && j)
+               state_vect[i + 3] += (double)j * (*sec_ptr) * prev_power;
+            state_vect[i] += power * (*sec_ptr++);
+            if( j)
+               prev_power *= x[k];
+            power *= x[k];
+            }
+         if( compute_velocity)
+            state_vect[i + 3] *= 2. / p->dt;
+         }
+      }
+
+   for( m = 0; m < 3; m++)
+      {
+      for( i = 0; i < stride; i++)
+         for( k = 0; k < n_times; k++)
+            sums[i][k] = 0.;
+      for( j = 0; j < p->nf[m]; j++)
+         {
+         const double amplitude = *fq_ptr++;
+         const double cos_step = cos( amplitude * step);
+         const double sin_step = sin( amplitude * step);
+
+         cos_term[0] = cos( amplitude * fx[0]);
+         sin_term[0] = sin( amplitude * fx[0]);
+         for( k = 1; k < n_times; k++)
+            {
+            cos_term[k] = cos_term[k - 1] * cos_step - sin_term[k - 1] * sin_step;
+            sin_term[k] = sin_term[k - 1] * cos_step + cos_term[k - 1] * sin_step;
+            }
+         for( i = 0; i < 3; i++, term_ptr += 2)
+            {
+            const double c = term_ptr[0], s = term_ptr[1];
+
+            for( k = 0; k < n_times; k++)
+               sums[i][k] += c * cos_term[k] + s * sin_term[k];
+            if( compute_velocity)
+               for( k = 0; k < n_times; k++)
+                  sums[i + 3][k] += amplitude *
+                                 (s * cos_term[k] - c * sin_term[k]);
+            }
+         }
+
+      for( k = 0; k < n_times; k++)
+         {
+         double *state_vect = state_vects + k * stride;
+
+         for( i = 0; i < 3; i++)
+            {
+            state_vect[i] += sums[i][k] * wx[k];
+            if( compute_velocity)
+               {
+               state_vect[i + 3] += sums[i + 3][k] * wx[k];
+               if( m)         /* d(x^m)/dt = m * x^(m-1) * 2 / dt */
+                  state_vect[i + 3] += (double)( m * 2)
+                           * (m == 2 ? x[k] : 1.) / p->dt * sums[i][k];
+               }
+            }
+         wx[k] *= x[k];
+         }
+      }
+
+   for( k = 0; k < n_times * stride; k++)
+      state_vects[k] *= 1.e-10;         /* cvt to AU,  and to AU/day */
+}
+
+int DLL_FUNC get_ps1996_positions( const void *iptr, const double jd0,
+            const double step, const int n_times, double *state_vects,
+            const int compute_velocity)
+{
+   const POISSON *p = (const POISSON *)iptr;
+   const double jd_end = jd0 + (double)( n_times - 1) * step;
+   const int stride = (compute_velocity ? 6 : 3);
+   int i;
+
+   if( n_times <= 0)
+      return( 0);
+   if( jd0 < p->tzero || jd0 > p->tzero + p->dt
+                  || jd_end < p->tzero || jd_end > p->tzero + p->dt)
+      return( -1);
+   for( i = 0; i < n_times; i += PS1996_CHUNK)
+      {
+      const int n = (n_times - i < PS1996_CHUNK ? n_times - i : PS1996_CHUNK);
+
+      get_ps1996_chunk( p, jd0 + (double)i * step, step, n,
+                  state_vects + i * stride, compute_velocity);
+      }
+   return( 0);
+}
+
+/* Rather than reading in one block for one planet with the above
+load_ps1996_series( ),  you can 'load' the whole of ps_1996.dat once,
+with load_ps1996_file( ),  and then call get_ps1996_state( ) for any
+planet and JD.  The file is memory-mapped (on Windows,  just read in),
+and the offsets to each block for each planet are worked out at the
+start.  Blocks are unpacked as they're needed;  the 'n_cached_blocks'
+most recently used ones are kept around,  so that stepping back and forth
+across block boundaries (or between planets) doesn't mean unpacking the
+same data over and over.
+
+   get_ps1996_state( ) updates the cache,  so a given 'ps1996 file' should
+be used by only one thread at a time.  (Give each thread its own;  the
+mapped file data will be shared between them anyway.)  */
+
+#define N_PS1996_PLANETS 9
+#define DEFAULT_PS1996_CACHE_SIZE 18
+
+typedef struct
+{
+   POISSON_HEADER header;
+   double *fqs;
+   long *block_offsets;             /* n_blocks + 1 of them */
+} ps1996_planet_t;
+
+typedef struct
+{
+   int planet_no, block;
+   unsigned long last_used;         /* 0 = slot not yet used */
+   POISSON *series;
+} ps1996_cached_block_t;
+
+typedef struct
+{
+   char *data;
+   size_t size;
+   unsigned long n_uses;
+   int n_cached;
+   ps1996_planet_t planets[N_PS1996_PLANETS];
+   ps1996_cached_block_t *cache;
+} ps1996_file_t;
+
+/* Checks the header for one planet and returns the number of blocks
+(zero if the planet isn't there or the data don't make sense.)  */
+
+static int get_ps1996_planet_header( const char *data, const size_t size,
+                  const int planet_no, POISSON_HEADER *header)
+{
+   int32_t offset;
+   size_t end;
+
+   memcpy( &offset, data + (planet_no - 1) * sizeof( int32_t),
+                                 sizeof( int32_t));
+   if( offset < N_PS1996_PLANETS * (int32_t)sizeof( int32_t)
+                || (size_t)offset + sizeof( POISSON_HEADER) > size)
+      return( 0);
+   memcpy( header, data + offset, sizeof( POISSON_HEADER));
+   end = (size_t)offset + sizeof( POISSON_HEADER)
+               + (size_t)header->total_fqs * sizeof( double)
+               + (size_t)header->n_blocks * sizeof( int16_t);
+   if( header->n_blocks <= 0 || header->total_fqs < 0 || end > size
+            || header->nf[0] < 0 || header->nf[1] < 0 || header->nf[2] < 0
+            || header->nf[0] + header->nf[1] + header->nf[2] > header->total_fqs)
+      return( 0);
+   return( header->n_blocks);
+}
+
+void * DLL_FUNC load_ps1996_file( FILE *ifile, int n_cached_blocks)
+{
+   ps1996_file_t *rval;
+   POISSON_HEADER headers[N_PS1996_PLANETS];
+   long total_fqs = 0, total_blocks = 0, *block_offsets;
+   size_t size;
+   char *data;
+   double *fqs;
+   int i, j, close_file = 0;
+
+   if( !ifile)
+      {
+      ifile = fopen( "ps_1996.dat", "rb");
+      if( !ifile)
+         return( NULL);
+      close_file = 1;
+      }
+   data = map_file_for_reading( ifile,
+                  N_PS1996_PLANETS * sizeof( int32_t), &size);
+   if( close_file)
+      fclose( ifile);
+   if( !data)
+      return( NULL);
+   if( n_cached_blocks <= 0)
+      n_cached_blocks = DEFAULT_PS1996_CACHE_SIZE;
+   for( i = 0; i < N_PS1996_PLANETS; i++)
+      {
+      const int n_blocks = get_ps1996_planet_header( data, size, i + 1,
+                                       headers + i);
+
+      if( !n_blocks)
+         headers[i].n_blocks = headers[i].total_fqs = 0;
+      total_fqs += headers[i].total_fqs;
+      total_blocks += n_blocks + 1;
+      }
+   rval = (ps1996_file_t *)malloc( sizeof( ps1996_file_t)
+               + (size_t)total_fqs * sizeof( double)
+               + (size_t)total_blocks * sizeof( long)
+               + (size_t)n_cached_blocks * sizeof( ps1996_cached_block_t));
+   if( !rval)
+      {
+      unmap_file_data( data, size);
+      return( NULL);
+      }
+   rval->data = data;
+   rval->size = size;
+   rval->n_uses = 0;
+   rval->n_cached = n_cached_blocks;
+   rval->cache = (ps1996_cached_block_t *)( rval + 1);
+   for( i = 0; i < n_cached_blocks; i++)
+      {
+      rval->cache[i].last_used = 0;
+      rval->cache[i].series = NULL;
+      }
+   fqs = (double *)( rval->cache + n_cached_blocks);
+   block_offsets = (long *)( fqs + total_fqs);
+   for( i = 0; i < N_PS1996_PLANETS; i++)
+      {
+      ps1996_planet_t *planet = rval->planets + i;
+      const int n_blocks = headers[i].n_blocks;
+
+      planet->header = headers[i];
+      planet->fqs = fqs;
+      planet->block_offsets = block_offsets;
+      if( n_blocks)
+         {
+         int32_t offset;
+         const char *tptr;
+
+         memcpy( &offset, data + i * sizeof( int32_t), sizeof( int32_t));
+         tptr = data + offset + sizeof( POISSON_HEADER);
+         memcpy( fqs, tptr, (size_t)headers[i].total_fqs * sizeof( double));
+         tptr += headers[i].total_fqs * sizeof( double);
+         block_offsets[0] = (long)( tptr - data) + n_blocks * (long)sizeof( int16_t);
+         for( j = 0; j < n_blocks; j++)
+            block_offsets[j + 1] = block_offsets[j]
+                        + (long)get16sbits( tptr + j * sizeof( int16_t));
+         if( (size_t)block_offsets[n_blocks] > size)
+            planet->header.n_blocks = 0;
+         }
+      fqs += headers[i].total_fqs;
+      block_offsets += n_blocks + 1;
+      }
+   return( rval);
+}
+
+int DLL_FUNC unload_ps1996_file( void *ps1996_file)
+{
+   ps1996_file_t *ps = (ps1996_file_t *)ps1996_file;
+   int i;
+
+   for( i = 0; i < ps->n_cached; i++)
+      free( ps->cache[i].series);
+   unmap_file_data( ps->data, ps->size);
+   free( ps);
+   return( 0);
+}
+
+/* Returns the unpacked block 'block' for the given planet,  from the
+cache if it's there;  otherwise,  it's unpacked into the least recently
+used slot.  NULL means we ran out of memory.  */
+
+static const POISSON *get_ps1996_block( ps1996_file_t *ps,
+                  const int planet_no, const int block)
+{
+   const ps1996_planet_t *planet = ps->planets + planet_no - 1;
+   ps1996_cached_block_t *slot;
+   POISSON *p;
+   int i;
+
+   ps->n_uses++;
+   slot = ps->cache;
+   for( i = 0; i < ps->n_cached; i++)
+      {
+      ps1996_cached_block_t *tslot = ps->cache + i;
+
+      if( tslot->series && tslot->planet_no == planet_no
+                        && tslot->block == block)
+         {
+         tslot->last_used = ps->n_uses;
+         return( tslot->series);
+         }
+      if( slot->last_used > tslot->last_used)
+         slot = tslot;
+      }
+   free( slot->series);
+   slot->last_used = 0;
+   p = slot->series = (POISSON *)malloc( sizeof( POISSON)
+               + (size_t)planet->header.total_fqs * 6 * sizeof( double));
+   if( !p)
+      return( NULL);
+   p->tzero = planet->header.tzero + (double)block * planet->header.dt;
+   p->dt = planet->header.dt;
+   p->n_blocks = planet->header.n_blocks;
+   p->total_fqs = planet->header.total_fqs;
+   for( i = 0; i < 3; i++)
+      p->nf[i] = planet->header.nf[i];
+   p->fqs = planet->fqs;
+   p->terms = (double *)( p + 1);
+   unpack_ps1996_block( p, ps->data + planet->block_offsets[block]);
+   slot->planet_no = planet_no;
+   slot->block = block;
+   slot->last_used = ps->n_uses;
+   return( p);
+}
+
+/* Returns the index of the block covering 'jd' for the given planet,
+or -1 if the planet or JD aren't covered.  */
+
+static int find_ps1996_block( const ps1996_file_t *ps, const int planet_no,
+                  const double jd)
+{
+   const POISSON_HEADER *header;
+   int block;
+
+   if( planet_no < 1 || planet_no > N_PS1996_PLANETS)
+      return( -1);
+   header = &ps->planets[planet_no - 1].header;
+   if( !header->n_blocks)
+      return( -1);
+   block = (int)floor( (jd - header->tzero) / header->dt);
+   if( block < 0 || block >= header->n_blocks)
+      return( -1);            /* outta bounds */
+   return( block);
+}
+
+/* Same as get_ps1996_position( ),  but for any planet (1=Mercury...
+9=Pluto) and JD covered by the file;  see above.  Returns -1 if the
+planet or JD aren't covered,  -2 if memory ran out.  */
+
+int DLL_FUNC get_ps1996_state( void *ps1996_file, const int planet_no,
+            const double jd, double *state_vect, const int compute_velocity)
+{
+   ps1996_file_t *ps = (ps1996_file_t *)ps1996_file;
+   const int block = find_ps1996_block( ps, planet_no, jd);
+   const POISSON *p;
+
+   if( block < 0)
+      return( -1);
+   p = get_ps1996_block( ps, planet_no, block);
+   if( !p)
+      return( -2);
+   return( get_ps1996_position( jd, p, state_vect, compute_velocity));
+}
+
+/* Same as get_ps1996_positions( ),  but the times can run across any
+number of blocks.  Each run of times within a block is done with one
+call to get_ps1996_positions( ).  */
+
+int DLL_FUNC get_ps1996_states( void *ps1996_file, const int planet_no,
+            const double jd0, const double step, const int n_times,
+            double *state_vects, const int compute_velocity)
+{
+   ps1996_file_t *ps = (ps1996_file_t *)ps1996_file;
+   const int stride = (compute_velocity ? 6 : 3);
+   int n_done = 0;
+
+   while( n_done < n_times)
+      {
+      const double jd = jd0 + (double)n_done * step;
+      const int block = find_ps1996_block( ps, planet_no, jd);
+      const POISSON *p;
+      int n = 1;
+
+      if( block < 0)
+         return( -1);
+      p = get_ps1996_block( ps, planet_no, block);
+      if( !p)
+         return( -2);
+      while( n_done + n < n_times && block ==
+               find_ps1996_block( ps, planet_no, jd0 + (double)( n_done + n) * step))
+         n++;
+      get_ps1996_positions( p, jd, step, n,
+                  state_vects + n_done * stride, compute_velocity);
+      n_done += n;
+      }
+   return( 0);
+}
+
 #ifdef TEST_CODE
 
 /* Example run,  giving heliocentric J2000 equatorial state
@@ -321,8 +756,91 @@ vector for Mars as of JD 2458239.5 = 2018 May 1 TDB :
 Series loaded
 -0.435280249 -1.303106084 -0.585949939  1.493616984
 0.013913669 -0.002480622 -0.001513357
-*/
 
+   If a number of steps and a step size (in days) are added,  positions
+for all planets are computed at that many steps,  starting at the given
+JD,  both by loading each series as needed with load_ps1996_series( )
+and with get_ps1996_state( ),  and the results and timing compared.
+Then the same positions are computed with get_ps1996_states( ),  and the
+largest differences (in AU and AU/day) shown.  */
+
+#include <time.h>
+
+static double seconds( void)
+{
+   return( (double)clock( ) / (double)CLOCKS_PER_SEC);
+}
+
+static int compare_methods( FILE *ifile, const double jd0, const int n_steps,
+                  const double step)
+{
+   void *ps = load_ps1996_file( ifile, 0);
+   double time_old = 0., time_new = 0., time_multi = 0., t;
+   double max_diff = 0., max_vel_diff = 0.;
+   int i, planet_no, j, n_differences = 0;
+
+   if( !ps)
+      {
+      printf( "Couldn't load ps_1996.dat\n");
+      return( -1);
+      }
+   for( i = 0; i < n_steps; i++)
+      for( planet_no = 1; planet_no <= 9; planet_no++)
+         {
+         const double jd = jd0 + (double)i * step;
+         double state1[6], state2[6];
+         int rval1 = -1, rval2;
+         void *p;
+
+         t = seconds( );
+         p = load_ps1996_series( ifile, jd, planet_no);
+         if( p)
+            {
+            rval1 = get_ps1996_position( jd, p, state1, 1);
+            unload_ps1996_series( p);
+            }
+         time_old += seconds( ) - t;
+         t = seconds( );
+         rval2 = get_ps1996_state( ps, planet_no, jd, state2, 1);
+         time_new += seconds( ) - t;
+         if( rval1 != rval2)
+            n_differences++;
+         else if( !rval1)
+            for( j = 0; j < 6; j++)
+               if( state1[j] != state2[j])
+                  n_differences++;
+         }
+   for( planet_no = 1; planet_no <= 9; planet_no++)
+      {
+      double *states = (double *)malloc( n_steps * 12 * sizeof( double));
+      double *states2 = states + n_steps * 6;
+      int rval;
+
+      for( i = 0; i < n_steps; i++)
+         get_ps1996_state( ps, planet_no, jd0 + (double)i * step,
+                              states + i * 6, 1);
+      t = seconds( );
+      rval = get_ps1996_states( ps, planet_no, jd0, step, n_steps, states2, 1);
+      time_multi += seconds( ) - t;
+      for( i = 0; !rval && i < n_steps * 6; i++)
+         {
+         const double diff = fabs( states[i] - states2[i]);
+
+         if( i % 6 < 3 && max_diff < diff)
+            max_diff = diff;
+         if( i % 6 >= 3 && max_vel_diff < diff)
+            max_vel_diff = diff;
+         }
+      free( states);
+      }
+   unload_ps1996_file( ps);
+   printf( "load_ps1996_series( ) : %f seconds\n", time_old);
+   printf( "get_ps1996_state( )   : %f seconds\n", time_new);
+   printf( "%d differences\n", n_differences);
+   printf( "get_ps1996_states( )  : %f seconds\n", time_multi);
+   printf( "Max differences %g AU,  %g AU/day\n", max_diff, max_vel_diff);
+   return( n_differences);
+}
 int main( const int argc, const char **argv)
 {
    double state_vect[6], r;
@@ -343,6 +861,12 @@ int main( const int argc, const char **argv)
       printf( "ps_1996.dat not loaded\n");
       return( -2);
       }
+   if( argc > 4)
+      {
+      rval = compare_methods( ifile, t0, atoi( argv[3]), atof( argv[4]));
+      fclose( ifile);
+      return( rval);
+      }
    p = load_ps1996_series( ifile, t0, atoi( argv[1]));
    fclose( ifile);
    if( !p)
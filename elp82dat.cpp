@@ -128,183 +128,236 @@ static void compute_lunar_polynomials( const double t_cen, double *fund,
       }
 }
 
-#define CHUNK_SIZE 10000
+#define ELP_DATA_HEADER struct elp_data_header
+
+ELP_DATA_HEADER
+   {
+   int32_t offsets[37 * 2];
+   double poly_coeffs[5 * 5 + 7 * 2];
+   };
+
+#define N_ELP_SERIES 36
+#define MAX_ELP_ARGS 11
 
-static double add_in_series( FILE *ifile, const int series_no,
-                 const double *fund, const double prec, long n_terms)
+/* Each series type has its own record size,  and multiplies a different
+set of the fundamental arguments (indices into fund[]).  Below,  each
+argument comes with the byte in the record where its multiplier is
+stored.  They're in ascending order of argument,  as in the original
+code,  so the angles add up the same (to the last bit).   */
+
+typedef struct
 {
-   double rval = 0.;
-   char *tptr, *ibuff;
-   int i, coeffs[N_FUND_COEFFS];
-   const int series_type = series_no / 3;
-   size_t term_size, chunk_size;
-   long lprec = (long)( prec * 100000.);   /* work in .00001-arcsec units */
+   int term_size, n_args;
+   signed char args[MAX_ELP_ARGS], bytes[MAX_ELP_ARGS];
+} elp_series_type_t;
+
+static const elp_series_type_t elp_types[5] = {
+      { 8, 4, { 5, 6, 7, 8 },  { 4, 5, 6, 7 } },        /* main problem */
+      { 13, 5, { 17, 18, 19, 20, 21 }, { 12, 8, 9, 10, 11 } },
+                                         /* Earth figure perturbations */
+      { 19, 11, { 9, 10, 11, 12, 13, 14, 15, 18, 20, 21, 22 },
+                { 8, 9, 11, 12, 13, 14, 15, 16, 17, 18, 10 } },
+      { 19, 11, { 9, 10, 11, 12, 13, 14, 18, 19, 20, 21, 22 },
+                { 8, 9, 11, 12, 13, 14, 15, 16, 17, 18, 10 } },
+                                         /* planetary perturbations */
+      { 12, 4, { 18, 19, 20, 21 }, { 8, 9, 10, 11 } } };
+                                         /* a hodgepodge of things */
+
+static const elp_series_type_t *get_elp_series_type( const int series_no)
+{
+   static const signed char type_idx[12] = { 0, 1, 1, 2, 2, 3, 3,
+                                             4, 4, 4, 4, 4 };
 
-   for( i = 0; i < N_FUND_COEFFS; i++)
-      coeffs[i] = 0;
-   switch( series_type)
+   return( elp_types + type_idx[series_no / 3]);
+}
+
+typedef struct
+{
+   int n_terms;
+   double *amplitude, *phase;
+   signed char *mult;         /* n_terms * (type's n_args) */
+} elp_series_t;
+
+typedef struct
+{
+   double poly_coeffs[5 * 5 + 7 * 2];
+   elp_series_t series[N_ELP_SERIES];
+} elp82_data_t;
+
+static int32_t get_int32( const char *tptr)
+{
+   int32_t rval;
+
+   memcpy( &rval, tptr, sizeof( int32_t));
+   return( rval);
+}
+
+/* Terms in each series are sorted in descending order of amplitude,  so
+we can just stop at the first one below the desired precision.  Returns
+the number of terms to keep,  or -1 if the series runs off the end of
+the file. */
+
+static long n_elp_terms_needed( const char *data, const size_t size,
+               const ELP_DATA_HEADER *hdr, const int series_no, double prec)
+{
+   const int term_size = get_elp_series_type( series_no)->term_size;
+   const long n_terms = (long)hdr->offsets[series_no * 2 + 1];
+   const int32_t offset = hdr->offsets[series_no * 2];
+   long lprec, i;
+
+   if( !n_terms)
+      return( 0);
+   if( offset < 0 || (size_t)offset + (size_t)n_terms * term_size > size)
+      return( -1);
+   if( series_no % 3 == 2)         /* distance term: cvt to kilometers */
+      prec *= A0 / 1000.;
+   else                            /* angular term: cvt to arcseconds */
+      prec *= (180. * 3600. / PI);
+   lprec = (long)( prec * 100000.);   /* work in .00001-arcsec units */
+   data += offset;
+   for( i = 0; i < n_terms; i++, data += term_size)
       {
-      case 0:        /* main problem */
-         term_size = 8;
-         break;
-      case 1:  case 2:        /* Earth figure perturbations */
-         term_size = 13;
-         break;
-      case 7: case 8: case 9: case 10: case 11:
-         term_size = 12;
-         break;
-      case 3:  case 4:        /* Planetary perturbations */
-      case 5:  case 6:        /* Planetary perturbations */
-         term_size = 19;
+      const long amplitude = (long)get_int32( data);
+
+      if( amplitude < lprec && amplitude > -lprec)
          break;
-      default:
-#ifdef TEST_CODE
-         printf( "??? series type %d\n", series_type);
-#endif
-         return( 0.);
       }
-   chunk_size = CHUNK_SIZE / term_size;
-   if( chunk_size > (size_t)n_terms)
-      chunk_size = (size_t)n_terms;
-   ibuff = tptr = (char *)calloc( (size_t)chunk_size, term_size);
-   if( !ibuff)
-#ifdef TEST_CODE
+   return( i);
+}
+
+static void decode_elp_series( elp_series_t *series, const char *data,
+                                          const int series_no)
+{
+   const elp_series_type_t *type = get_elp_series_type( series_no);
+   signed char *mult = series->mult;
+   int i, j;
+
+   for( i = 0; i < series->n_terms; i++, data += type->term_size)
       {
-      printf( "Failed to alloc %u * %u bytes\n", chunk_size, term_size);
-      printf( "n_terms: %ld\n", n_terms);
+      series->amplitude[i] = (double)get_int32( data);
+      if( series_no >= 3)
+         series->phase[i] = (double)get_int32( data + 4)
+                                    * (PI / 180.) / 100000.;
+      else
+         series->phase[i] = 0.;
+      for( j = 0; j < type->n_args; j++)
+         *mult++ = (signed char)data[type->bytes[j]];
       }
-#else
-      return( 0.);
-#endif
-   while( n_terms--)
+}
+
+/* Loads the ELP-82 series from 'ifile' (or from 'elp82.dat',  if ifile is
+NULL),  dropping terms smaller than 'prec' radians (or,  for distance,
+'prec' times the mean lunar distance),  and decodes the rest into flat
+arrays.  The result is only read from after that,  so any number of
+threads can use it at once.  Following the scheme used for the PS-1996
+series (see de_plan.cpp),  it's all one block of memory;  free it with
+unload_elp82_data( ).  */
+
+void * DLL_FUNC load_elp82_data( FILE *ifile, const double prec)
+{
+   ELP_DATA_HEADER hdr;
+   elp82_data_t *rval = NULL;
+   long n_terms[N_ELP_SERIES], total_terms = 0, total_mult = 0;
+   size_t size;
+   char *data;
+   int i, close_file = 0;
+
+   if( !ifile)
       {
-      long amplitude;
-      double angle;
-
-      if( ibuff == tptr)
-         if( !fread( ibuff, chunk_size, term_size, ifile))
-            {
-            free( ibuff);
-            return( 0.);
-            }
-      amplitude = *(int32_t *)tptr;
-      if( amplitude < lprec && amplitude > -lprec)
-         return( rval * 1.e-5);
-      switch( series_type)
+      ifile = fopen( "elp82.dat", "rb");
+      if( !ifile)
+         return( NULL);
+      close_file = 1;
+      }
+   data = map_file_for_reading( ifile,
+                        sizeof( ELP_DATA_HEADER), &size);
+   if( close_file)
+      fclose( ifile);
+   if( !data)
+      return( NULL);
+   memcpy( &hdr, data, sizeof( ELP_DATA_HEADER));
+   for( i = 0; i < N_ELP_SERIES; i++)
+      {
+      n_terms[i] = n_elp_terms_needed( data, size, &hdr, i, prec);
+      if( n_terms[i] < 0)
          {
-         case 0:        /* main problem */
-            for( i = 4; i < 8; i++)
-               coeffs[i + 1] = (int)tptr[i];
-            break;
-         case 1:  case 2:        /* Earth figure perturbations */
-         case 7: case 8: case 9: case 10: case 11: /* a hodgepodge of things */
-            for( i = 8; i < 12; i++)
-               coeffs[i + 10] = (int)tptr[i];
-            if( series_type < 3)          /* yes,  there is a zeta term */
-               coeffs[17] = tptr[12];
-            break;
-         case 3:  case 4:        /* Planetary perturbations */
-            coeffs[9] = tptr[8];
-            coeffs[10] = tptr[9];
-            coeffs[22] = tptr[10];
-            coeffs[11] = tptr[11];
-            coeffs[12] = tptr[12];
-            coeffs[13] = tptr[13];
-            coeffs[14] = tptr[14];
-            coeffs[15] = tptr[15];
-            coeffs[18] = tptr[16];
-            coeffs[20] = tptr[17];
-            coeffs[21] = tptr[18];
-            break;
-         case 5:  case 6:        /* Planetary perturbations */
-            coeffs[9] = tptr[8];
-            coeffs[10] = tptr[9];
-            coeffs[22] = tptr[10];
-            coeffs[11] = tptr[11];
-            coeffs[12] = tptr[12];
-            coeffs[13] = tptr[13];
-            coeffs[14] = tptr[14];
-            coeffs[18] = tptr[15];
-            coeffs[19] = tptr[16];
-            coeffs[20] = tptr[17];
-            coeffs[21] = tptr[18];
-            break;
+         unmap_file_data( data, size);
+         return( NULL);
          }
+      total_terms += n_terms[i];
+      total_mult += n_terms[i] * get_elp_series_type( i)->n_args;
+      }
+   rval = (elp82_data_t *)malloc( sizeof( elp82_data_t)
+               + (size_t)total_terms * 2 * sizeof( double) + (size_t)total_mult);
+   if( rval)
+      {
+      double *dptr = (double *)( rval + 1);
+      signed char *mult = (signed char *)( dptr + total_terms * 2);
 
-      if( series_type)
-         angle = (double)*(int32_t *)( tptr + 4) * (PI / 180.) / 100000.;
-      else
-         angle = 0.;
-      for( i = 0; i < N_FUND_COEFFS; i++)
-         if( coeffs[i])
-            {
-            if( coeffs[i] == 1)
-               angle += fund[i];
-            else if( coeffs[i] == -1)
-               angle -= fund[i];
-            else
-               angle += (double)coeffs[i] * fund[i];
-            coeffs[i] = 0;
-            }
+      memcpy( rval->poly_coeffs, hdr.poly_coeffs, sizeof( hdr.poly_coeffs));
+      for( i = 0; i < N_ELP_SERIES; i++)
+         {
+         elp_series_t *series = rval->series + i;
+
+         series->n_terms = (int)n_terms[i];
+         series->amplitude = dptr;
+         series->phase = dptr + n_terms[i];
+         series->mult = mult;
+         dptr += n_terms[i] * 2;
+         mult += n_terms[i] * get_elp_series_type( i)->n_args;
+         decode_elp_series( series, data + hdr.offsets[i + i], i);
+         }
+      }
+   unmap_file_data( data, size);
+   return( rval);
+}
+
+int DLL_FUNC unload_elp82_data( void *p)
+{
+   free( p);
+   return( 0);
+}
+
+static double add_in_series( const elp_series_t *series, const int series_no,
+                 const double *fund)
+{
+   const elp_series_type_t *type = get_elp_series_type( series_no);
+   const signed char *mult = series->mult;
+   double rval = 0.;
+   int i, j;
+
+   for( i = 0; i < series->n_terms; i++, mult += type->n_args)
+      {
+      double angle = series->phase[i];
+
+      for( j = 0; j < type->n_args; j++)
+         angle += (double)mult[j] * fund[type->args[j]];
       if( series_no == 2)     /* main distance theory is oddball */
-         rval += (double)amplitude * cos( angle);
+         rval += series->amplitude[i] * cos( angle);
       else
-         rval += (double)amplitude * sin( angle);
-      tptr += term_size;
-      if( (size_t)( tptr - ibuff) == chunk_size * term_size)     /* end of line */
-         tptr = ibuff;
+         rval += series->amplitude[i] * sin( angle);
       }
-   free( ibuff);
    return( rval * 1.e-5);
 }
 
-#define ELP_DATA_HEADER struct elp_data_header
-
-ELP_DATA_HEADER
-   {
-   int32_t offsets[37 * 2];
-   double poly_coeffs[5 * 5 + 7 * 2];
-   };
-
-static int get_elp_values( FILE *ifile, const double t_cen,
-                     const double prec0, double *ovals)
+static void get_elp_values( const elp82_data_t *elp, const double t_cen,
+                                 double *ovals)
 {
    int i;
    double addition;
    double fund[N_FUND_COEFFS];
-   ELP_DATA_HEADER *hdr = (ELP_DATA_HEADER *)malloc( sizeof( ELP_DATA_HEADER));
 
-   if( !hdr)
-      return( -1);
-   if( !fread( hdr, sizeof( ELP_DATA_HEADER), 1, ifile))
-      {
-      free( hdr);
-      return( -2);
-      }
-   compute_lunar_polynomials( t_cen, fund, hdr->poly_coeffs);
+   compute_lunar_polynomials( t_cen, fund, elp->poly_coeffs);
 
                /* First longitude term has to be 'adjusted': */
    ovals[0] = fund[0] + (22639.58578 * PI / 180.) * sin( fund[7]) / 3600.;
    ovals[1] = 0.;
    ovals[2] = 385000.52719;
-   for( i = 0; i < 36; i++)
+   for( i = 0; i < N_ELP_SERIES; i++)
       {
-      double prec = prec0;
       int series_type = i / 3;
 
-      if( prec != 0.)
-         {
-         if( i % 3 == 2)         /* distance term: cvt to kilometers */
-            prec *= A0 / 1000.;
-         else                       /* angular term: cvt to arcseconds */
-            prec *= (180. * 3600. / PI);
-         }
-      fseek( ifile, hdr->offsets[i + i], SEEK_SET);
-      if( hdr->offsets[i + i + 1])
-         addition = add_in_series( ifile, i, fund, prec,
-                                               hdr->offsets[i + i + 1]);
-      else
-         addition = 0.;
+      addition = add_in_series( elp->series + i, i, fund);
       if( series_type == 2 || series_type == 4 ||
           series_type == 6 || series_type == 8)
          addition *= t_cen;
@@ -315,8 +368,6 @@ static int get_elp_values( FILE *ifile, const double t_cen,
       else
          ovals[i % 3] += addition * (PI / 180.) / 3600.;
       }
-   free( hdr);
-   return( 0);
 }
 
                /* Laskar's coeffs for precession,  p. 12: */
@@ -331,59 +382,70 @@ static int get_elp_values( FILE *ifile, const double t_cen,
 #define Q_3         -0.1371808e-11
 #define Q_4         -0.320334e-14
 
-int DLL_FUNC compute_elp_xyz( FILE *ifile, const double t_cen,
-                   const double prec, double *ecliptic_xyz_2000)
+/* Computes the lunar position from ELP-82 data loaded with
+load_elp82_data( ).  ecliptic_xyz_2000[0...2] get the geocentric position
+in ecliptic J2000 coordinates,  in kilometres;  ecliptic_xyz_2000[3] gets
+the distance,  also in km.  The data are only read from,  so any number
+of threads can do this at once with the same data.  */
+
+int DLL_FUNC get_elp82_position( const void *elp_data, const double t_cen,
+                   double *ecliptic_xyz_2000)
 {
-   double uvr[3];
-   int i, close_file = 0, rval;
+   double uvr[3], x, y, z;
    const double adjusted_t_cen = t_cen + elp_time_offset( t_cen);
+   double p = 0., q = 0., twice_root_pq_term;
+   static const double p_coeff[5] = { P_4, P_3, P_2, P_1, P_0 };
+   static const double q_coeff[5] = { Q_4, Q_3, Q_2, Q_1, Q_0 };
+   double matrix[9];
+   int i;
 
-   if( !ifile)
+   get_elp_values( (const elp82_data_t *)elp_data, adjusted_t_cen, uvr);
+   x = uvr[2] * cos( uvr[0]) * cos( uvr[1]);
+   y = uvr[2] * sin( uvr[0]) * cos( uvr[1]);
+   z = uvr[2] *           sin( uvr[1]);
+   for( i = 0; i < 5; i++)
       {
-      ifile = fopen( "elp82.dat", "rb");
-      if( !ifile)
-         return( -1);
-      close_file = 1;
+      p = p * adjusted_t_cen + p_coeff[i];
+      q = q * adjusted_t_cen + q_coeff[i];
       }
-   fseek( ifile, 0L, SEEK_SET);
-   rval = get_elp_values( ifile, adjusted_t_cen, prec, uvr);
-   if( rval)
+   p *= adjusted_t_cen;
+   q *= adjusted_t_cen;
+   twice_root_pq_term = 2. * sqrt( 1. - p * p - q * q);
+   matrix[0] = 1. - 2. * p * p;
+   matrix[1] = matrix[3] = 2. * p * q;
+   matrix[2] = p * twice_root_pq_term;
+   matrix[6] = -matrix[2];
+   matrix[7] = q * twice_root_pq_term;
+   matrix[5] = -matrix[7];
+   matrix[4] = 1. - 2. * q * q;
+   matrix[8] = matrix[0] - 2. * q * q;
+   for( i = 0; i < 9; i += 3)
+      *ecliptic_xyz_2000++ =
+                     matrix[i] * x + matrix[i + 1] * y + matrix[i + 2] * z;
+   *ecliptic_xyz_2000++ = uvr[2];         /* give the radius,  too */
+   return( 0);
+}
+
+/* Older,  slower way,  still supported:  loads the data from 'ifile' (or,
+if that's NULL,  from 'elp82.dat'),  computes the position,  and frees
+the data again.  If you're computing more than one position,  load the
+data once and call get_elp82_position( ) instead.  */
+
+int DLL_FUNC compute_elp_xyz( FILE *ifile, const double t_cen,
+                   const double prec, double *ecliptic_xyz_2000)
+{
+   void *elp_data = load_elp82_data( ifile, prec);
+   int i;
+
+   if( !elp_data)
+      {
       for( i = 0; i < 4; i++)
-         *ecliptic_xyz_2000++ = 0.;
-      else
-         {
-         const double x = uvr[2] * cos( uvr[0]) * cos( uvr[1]);
-         const double y = uvr[2] * sin( uvr[0]) * cos( uvr[1]);
-         const double z = uvr[2] *           sin( uvr[1]);
-         double p = 0., q = 0., twice_root_pq_term;
-         static const double p_coeff[5] = { P_4, P_3, P_2, P_1, P_0 };
-         static const double q_coeff[5] = { Q_4, Q_3, Q_2, Q_1, Q_0 };
-         double matrix[9];
-
-         for( i = 0; i < 5; i++)
-            {
-            p = p * adjusted_t_cen + p_coeff[i];
-            q = q * adjusted_t_cen + q_coeff[i];
-            }
-         p *= adjusted_t_cen;
-         q *= adjusted_t_cen;
-         twice_root_pq_term = 2. * sqrt( 1. - p * p - q * q);
-         matrix[0] = 1. - 2. * p * p;
-         matrix[1] = matrix[3] = 2. * p * q;
-         matrix[2] = p * twice_root_pq_term;
-         matrix[6] = -matrix[2];
-         matrix[7] = q * twice_root_pq_term;
-         matrix[5] = -matrix[7];
-         matrix[4] = 1. - 2. * q * q;
-         matrix[8] = matrix[0] - 2. * q * q;
-         for( i = 0; i < 9; i += 3)
-            *ecliptic_xyz_2000++ =
-                           matrix[i] * x + matrix[i + 1] * y + matrix[i + 2] * z;
-         *ecliptic_xyz_2000++ = uvr[2];         /* give the radius,  too */
-         }
-   if( close_file)
-      fclose( ifile);
-   return( rval);
+         ecliptic_xyz_2000[i] = 0.;
+      return( -1);
+      }
+   get_elp82_position( elp_data, t_cen, ecliptic_xyz_2000);
+   unload_elp82_data( elp_data);
+   return( 0);
 }
 
 #ifdef TEST_CODE
@@ -395,6 +457,7 @@ int DLL_FUNC compute_elp_xyz( FILE *ifile, const double t_cen,
 void main( int argc, char **argv)
 {
    FILE *ifile = fopen( "elp82.dat", "rb");
+   void *elp_data;
    double xyz[4], t;
    int i;
    const double prec = (argc == 1 ? 0 : atof( argv[1]));
@@ -410,10 +473,11 @@ void main( int argc, char **argv)
       exit( -1);
       }
 
+   elp_data = load_elp82_data( ifile, prec);
    for( i = 0; i < 5; i++)
       {
       t = 2469000.5 - 20000. * (double)i;
-      compute_elp_xyz( ifile, (t - J2000) / 36525., prec, xyz);
+      get_elp82_position( elp_data, (t - J2000) / 36525., xyz);
       printf( "%.3lf: %15.5lf %15.5lf %15.5lf  %15.5lf\n", t,
                            xyz[0], xyz[1], xyz[2], xyz[3]);
       printf( "             %15.5lf %15.5lf %15.5lf\n",
@@ -421,6 +485,7 @@ void main( int argc, char **argv)
                            results_from_book[i][1] - xyz[1],
                            results_from_book[i][2] - xyz[2] );
       }
+   unload_elp82_data( elp_data);
    for( i = 2; i < argc; i++)
       {
       t = atof( argv[i]);
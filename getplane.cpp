@@ -38,17 +38,73 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
       ovals[9, 10, 11] = x, y, z,  heliocentric equatorial, J2000.0
       ovals[12, 13, 14] = x, y, z,  heliocentric ecliptical, J2000.0
 
+   If you only need some of those,  compute_planet_frames( ) takes a
+bitmask of the frames wanted (PLANET_POLAR_OF_DATE, etc.,  in 'lunar.h')
+and skips the work for the rest;  slots for frames not asked for are
+left untouched.  You can also pass it the precession matrix from
+setup_precession( matrix, 2000. + t_c * 100., 2000.),  if you have it
+already,  or NULL to have it computed (only if a J2000 frame is wanted).
+compute_planets( ) gets any set of objects at one epoch,  sharing the
+obliquity and precession work between them.  Either way,  the values
+you get are identical to those from compute_planet( ).
+
    I intended to rig this up so you could keep on going to 11=Io, 12=Europa,
 etc.  This would make all sorts of sense.  But I've not done it yet. */
 
-int DLL_FUNC compute_planet( const char FAR *vsop_data, const int planet_no,
-                         const double t_c, double DLLPTR *ovals)
+/* Each frame after the first is a rotation of the one before it,  so we
+have to go through all frames up to the last one requested,  even if
+they're not stored.  The rotations are those of rotate_vector( ),  but
+with the sines and cosines worked out once.  */
+
+typedef struct
+{
+   double cos_obliq, sin_obliq;
+   double cos_obliq_2000, sin_obliq_2000;
+   const double *precession;
+} frame_context_t;
+
+static void rotate_about_x( double *v, const double cos_ang,
+                                       const double sin_ang)
+{
+   const double temp = v[1] * cos_ang - v[2] * sin_ang;
+
+   v[2] = v[2] * cos_ang + v[1] * sin_ang;
+   v[1] = temp;
+}
+
+static void set_up_frame_context( frame_context_t *context, const double t_c,
+                        const int frames, const double *precession_matrix,
+                        double *matrix_buff)
 {
-   double lat, lon, r;
-   const double obliquit = mean_obliquity( t_c);
-   double matrix[9];
    const double obliq_2000 = 23.4392911 * PI / 180.;
 
+   memset( context, 0, sizeof( frame_context_t));
+   if( frames >= PLANET_EQUATORIAL_OF_DATE)
+      {
+      const double obliquit = mean_obliquity( t_c);
+
+      context->cos_obliq = cos( obliquit);
+      context->sin_obliq = sin( obliquit);
+      }
+   if( frames >= PLANET_EQUATORIAL_J2000)
+      {
+      if( !precession_matrix)
+         {
+         setup_precession( matrix_buff, 2000. + t_c * 100., 2000.);
+         precession_matrix = matrix_buff;
+         }
+      context->cos_obliq_2000 = cos( -obliq_2000);
+      context->sin_obliq_2000 = sin( -obliq_2000);
+      }
+   context->precession = precession_matrix;
+}
+
+static void compute_one_planet( const char FAR *vsop_data, const int planet_no,
+                         const double t_c, const int frames,
+                         const frame_context_t *context, double DLLPTR *ovals)
+{
+   double lat, lon, r, cos_lat, ecliptic[3], equatorial[3];
+
             /* first,  compute polar heliocentric in eclip of date */
    if( planet_no != 10)
       {
@@ -67,22 +123,84 @@ int DLL_FUNC compute_planet( const char FAR *vsop_data, const int planet_no,
       lat *= PI / 180.;
       r /= AU_IN_KM;      /* from km to AU */
       }
-   ovals[0] = lon;
-   ovals[1] = lat;
-   ovals[2] = r;
+   if( frames & PLANET_POLAR_OF_DATE)
+      {
+      ovals[0] = lon;
+      ovals[1] = lat;
+      ovals[2] = r;
+      }
+   if( frames < PLANET_ECLIPTIC_OF_DATE)
+      return;
             /* next, compute polar cartesian in eclip of date */
-   ovals[3] = cos( lon) * cos( lat) * r;
-   ovals[4] = sin( lon) * cos( lat) * r;
-   ovals[5] =             sin( lat) * r;
+   cos_lat = cos( lat);
+   ecliptic[0] = cos( lon) * cos_lat * r;
+   ecliptic[1] = sin( lon) * cos_lat * r;
+   ecliptic[2] =             sin( lat) * r;
+   if( frames & PLANET_ECLIPTIC_OF_DATE)
+      FMEMCPY( ovals + 3, ecliptic, 3 * sizeof( double));
+   if( frames < PLANET_EQUATORIAL_OF_DATE)
+      return;
             /* next, compute polar cartesian in eclip of date, */
             /* but in equatorial coords */
-   FMEMCPY( ovals + 6, ovals + 3, 3 * sizeof( double));
-   rotate_vector( ovals + 6, obliquit, 0);
+   FMEMCPY( equatorial, ecliptic, 3 * sizeof( double));
+   rotate_about_x( equatorial, context->cos_obliq, context->sin_obliq);
+   if( frames & PLANET_EQUATORIAL_OF_DATE)
+      FMEMCPY( ovals + 6, equatorial, 3 * sizeof( double));
+   if( frames < PLANET_EQUATORIAL_J2000)
+      return;
             /* next, precess to get J2000.0 equatorial values */
-   setup_precession( matrix, 2000. + t_c * 100., 2000.);
-   precess_vector( matrix, ovals + 6, ovals + 9);
+            /* ('ecliptic' is reused as scratch space)        */
+   precess_vector( context->precession, equatorial, ecliptic);
+   if( frames & PLANET_EQUATORIAL_J2000)
+      FMEMCPY( ovals + 9, ecliptic, 3 * sizeof( double));
             /* Finally,  rotate equatorial J2000.0 into ecliptical J2000 */
-   FMEMCPY( ovals + 12, ovals + 9, 3 * sizeof( double));
-   rotate_vector( ovals + 12, -obliq_2000, 0);
+   if( frames & PLANET_ECLIPTIC_J2000)
+      {
+      rotate_about_x( ecliptic, context->cos_obliq_2000,
+                                context->sin_obliq_2000);
+      FMEMCPY( ovals + 12, ecliptic, 3 * sizeof( double));
+      }
+}
+
+int DLL_FUNC compute_planet_frames( const char FAR *vsop_data,
+                  const int planet_no, const double t_c, const int frames,
+                  const double *precession_matrix, double DLLPTR *ovals)
+{
+   frame_context_t context;
+   double matrix[9];
+
+   set_up_frame_context( &context, t_c, frames, precession_matrix, matrix);
+   compute_one_planet( vsop_data, planet_no, t_c, frames, &context, ovals);
    return( 0);
 }
+
+int DLL_FUNC compute_planet( const char FAR *vsop_data, const int planet_no,
+                         const double t_c, double DLLPTR *ovals)
+{
+   return( compute_planet_frames( vsop_data, planet_no, t_c,
+                                    PLANET_ALL_FRAMES, NULL, ovals));
+}
+
+/* compute_planets( ) computes each object whose bit is set in
+'planet_mask' (bit 0 = sun,  ... bit 10 = moon),  putting the fifteen
+values for object n at ovals[15 * n].  VSOP doesn't cover Pluto,  so bit
+9 is ignored.  It returns the number of objects computed.  */
+
+int DLL_FUNC compute_planets( const char FAR *vsop_data,
+                  const unsigned planet_mask, const double t_c,
+                  const int frames, double DLLPTR *ovals)
+{
+   frame_context_t context;
+   double matrix[9];
+   int i, rval = 0;
+
+   set_up_frame_context( &context, t_c, frames, NULL, matrix);
+   for( i = 0; i <= 10; i++)
+      if( i != 9 && ((planet_mask >> i) & 1u))
+         {
+         compute_one_planet( vsop_data, i, t_c, frames, &context,
+                                            ovals + i * 15);
+         rval++;
+         }
+   return( rval);
+}
@@ -624,10 +624,12 @@ static void ellipx( const double ell[6], const double rmu, double xyz[6] )
 //   Compute position and velocity components for a single satellite
 //   at a specified time.
 
-#define VERY_VERBOSE_OUTPUT
+/* #define VERY_VERBOSE_OUTPUT */
       /* Define the above to get a "play-by-play" of what values are */
       /* computed.  Should make it easier to build an implementation */
-      /* of this theory,  since you can get test values...           */
+      /* of this theory,  since you can get test values...  It's off */
+      /* by default,  since 'cheb_gen' calls this many thousands of  */
+      /* times.  Compile with -DVERY_VERBOSE_OUTPUT to turn it on.   */
 
 #ifdef VERY_VERBOSE_OUTPUT
 #include <stdio.h>
@@ -47,32 +47,28 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 #endif
 
 #include "jpleph.h"
-
-/* On some (non-Windows) system,  spreading the integration out to
-multiple processes is possible.  It's handled a little oddly.  The number
-of processes can be specified on the command line with the -z switch.
-Things proceed unchanged at first,  until data for the three perturbing
-asteroids (Ceres,  Pallas,  Vesta) have been read and their ephemerides
-computed. _Then_ we fork,  with each process reading every n_processes
-line,  and "chunk" files being created.  Thus,  if n_processes is 7,  the
-first process will create a chunk file with asteroids 5, 12, 19, 26, ...
-The second will process asteroids 6, 13, 20, ...
-
-   Once all the processes complete,  the original process zippers the
-results from the chunk files together and unlinks them.     */
+#include "perturb.h"
+
+/* On some (non-Windows) systems,  the integration can be spread out over
+multiple threads.  The number of threads is specified on the command line
+with the -z switch.  Things proceed unchanged at first,  until data for the
+three perturbing asteroids (Ceres,  Pallas,  Vesta) have been read and
+their ephemerides computed (and fitted,  or stored in the position cache).
+_Then_ the worker threads start.  The main thread reads orbits into a ring
+of 'work slots';  each worker takes the next unclaimed slot when it's free,
+so a thread that draws a few slow objects doesn't hold up the others.  The
+main thread writes out finished slots in input order,  so the output is the
+same as from a single-threaded run.  The perturber ephemeris (or position
+cache) is only read from once the workers start,  so they all share one
+copy.  Workers still call the perturber source directly for times the
+ephemeris doesn't cover (and always,  with -g),  so everything it calls
+has to be reentrant.  For VSOP,  that means compute_planets( ),  which
+gets the mean obliquity and (per-thread cached) precession matrices.   */
 
 #if defined( __linux) || defined( __unix__) || defined( __APPLE__)
-   #define FORKING
-
-   #include <unistd.h>     /* Symbolic Constants */
-   #include <sys/types.h>  /* Primitive System Data Types */
-   #include <errno.h>      /* Errors */
-   #include <stdio.h>      /* Input/Output */
-   #include <sys/wait.h>   /* Wait for Process Termination  */
-            /* above basically allows for forking so we can */
-            /* run different objects on different cores     */
-   #include <sys/time.h>         /* these allow resource limiting */
-   #include <sys/resource.h>     /* see '-r' command switch below */
+   #define THREADED
+
+   #include <pthread.h>
 #endif
 
 
@@ -80,51 +76,19 @@ results from the chunk files together and unlinks them.     */
 #define GAUSS_K .01720209895
 #define SOLAR_GM (GAUSS_K * GAUSS_K)
 
-#define PERTURBERS_MERCURY_TO_NEPTUNE 0xff
-#define PERTURBERS_PLUTO 0x100
-#define PERTURBERS_MOON  0x200
-#define PERTURBERS_PLUTO_AND_MOON (PERTURBERS_PLUTO | PERTURBERS_MOON)
-/* Following macro isn't actually used...
-   #define PERTURBERS_CERES_PALLAS_VESTA 0x1c00   */
-#define N_PERTURBERS 13
          /* hash table sizes should be prime numbers: */
 #define HASH_TABLE_SIZE 3000017
 
-static int verbose = 0, n_steps_taken = 0, resync_freq = 50;
-static int asteroid_perturber_number = -1;
-static double *position_cache;
-static int position_cache_size = 0;
-static unsigned long perturber_mask = PERTURBERS_MERCURY_TO_NEPTUNE;
-      /*  PERTURBERS_MERCURY_TO_NEPTUNE | PERTURBERS_CERES_PALLAS_VESTA; */
-
-int integrate_orbit( ELEMENTS *elem, const double jd_from, const double jd_to,
-                              const double max_err, const int n_steps);
+static int verbose = 0;
 
-/* 28 Feb 2003:  modified heavily after getting an e-mail from Werner
-Huget. See his e-mail and page 281 of the _Explanatory Supplement to the
-Astronomical Almanac_ for details.  Basically,  computing the relativistic
-acceleration in the simple manner I previously used led to significant
-errors for Mercury,  and presumably for other objects orbiting close
-to the Sun. */
+/* With '-b',  each object is integrated with both schemes,  and we keep
+track of how each did.  Index 0 is the adaptive scheme,  1 the grid.  */
 
-static void add_relativistic_accel( double *accel, const double *posnvel)
+typedef struct
 {
-   int i;
-   const double c = AU_PER_DAY;           /* speed of light in AU per day */
-   const double r_squared = posnvel[0] * posnvel[0] + posnvel[1] * posnvel[1]
-                                                    + posnvel[2] * posnvel[2];
-   const double v_squared = posnvel[3] * posnvel[3] + posnvel[4] * posnvel[4]
-                                                    + posnvel[5] * posnvel[5];
-   const double v_dot_r   = posnvel[0] * posnvel[3] + posnvel[1] * posnvel[4]
-                                                    + posnvel[2] * posnvel[5];
-   const double r = sqrt( r_squared), r_cubed_c_squared = r_squared * r * c * c;
-   const double r_component =
-                  (4. * SOLAR_GM / r - v_squared) / r_cubed_c_squared;
-   const double v_component = 4. * v_dot_r / r_cubed_c_squared;
-
-   for( i = 0; i < 3; i++)
-      accel[i] += r_component * posnvel[i] + v_component * posnvel[i + 3];
-}
+   long n_objects, n_steps[2], n_evals[2];
+   double setup_time[2], run_time[2], max_diff;
+} benchmark_t;
 
 static FILE *err_fopen( const char *filename, const char *permits)
 {
@@ -142,447 +106,55 @@ static FILE *err_fopen( const char *filename, const char *permits)
    return( rval);
 }
 
-#ifdef FORKING
-static char *chunk_filename( char *filename, const int chunk_number)
-{
-   assert( chunk_number >= 0 && chunk_number <= 99);
-   snprintf_err( filename, 12, "chunk%d.ugh", chunk_number);
-   return( filename);
-}
-#endif
+/* JPL ephemerides as a perturber source (see 'perturb.h').  'jpl_eph' is
+the handle from jpl_init_ephemeris( ).  The JPL code keeps some state in
+it,  so each thread has to have its own handle.  */
 
-static void set_differential_acceleration( const double *posnvel,
-                      const double *delta, double *accel)
+static int jpl_perturber_source( void *jpl_eph, const double jd,
+                  const unsigned long mask, double *locs)
 {
-   double p_squared = 0., r_squared = 0.;
-   double pfactor, rfactor, posnvel_2[6];
-   int i;
-
-   for( i = 0; i < 6; i++)
-      posnvel_2[i] = posnvel[i] + delta[i];
-   for( i = 0; i < 3; i++)
+   double posns[13][6];
+   int list[14], i, j, rval;
+   const double ratio = 1. + jpl_get_double( jpl_eph,
+                                    JPL_EPHEM_EARTH_MOON_RATIO);
+
+   for( i = 0; i < 14; i++)
+      list[i] = (i < 10);
+   rval = jpl_state( jpl_eph, jd, list, posns, NULL, 0);
+   for( i = 0; i < 3; ++i)
       {
-      p_squared += posnvel[i] * posnvel[i];
-      r_squared += posnvel_2[i] * posnvel_2[i];
+      posns[2][i] -= posns[9][i] / ratio;
+      posns[9][i] += posns[2][i];
       }
-               /* someday,  I'll do it right;  for the nonce,  do it quick: */
-               /* SEE: \useless\smalldif.cpp */
-   pfactor = 1. / (p_squared * sqrt( p_squared));
-   rfactor = 1. / (r_squared * sqrt( r_squared));
-   for( i = 0; i < 3; i++)
-      accel[i] = pfactor * posnvel[i] - rfactor * posnvel_2[i];
-   add_relativistic_accel( accel, posnvel_2);
-}
-
-int load_vsop_data( void);
-
-static char *vsop_data;
-static void *jpl_ephemeris;
-
-/* perturber_loc[0, 1, 2] = heliocentric ecliptic coords */
-
-static void compute_perturber( int perturber_no, double jd,
-                             double *perturber_loc)
-{
-   if( vsop_data)
-      {
-      const double j2000 = 2451545.;
-      double loc[15];
-
-      compute_planet( vsop_data, perturber_no, (jd - j2000) / 36525., loc);
-      memcpy( perturber_loc, loc + 12, 3 * sizeof( double));
-      }
-   else
-      {
-      static double jd0 = -1, posns[11][6];
-      int i;
-
-      if( jd0 != jd)
-         {
-         int list[14];
-         const double ratio = 1. + jpl_get_double( jpl_ephemeris,
-                                          JPL_EPHEM_EARTH_MOON_RATIO);
-
-         for( i = 0; i < 14; i++)
-            list[i] = (i < 10);
-         jpl_state( jpl_ephemeris, jd, list, posns, NULL, 0);
-         for( i = 0; i < 3; ++i)
-            {
-            posns[2][i] -= posns[9][i] / ratio;
-            posns[9][i] += posns[2][i];
-            }
-         jd0 = jd;
-         for( i = 0; i < 10; i++)
-            {
-            const double sin_obliq_2000 = 0.397777155931913701597179975942380896684;
-            const double cos_obliq_2000 = 0.917482062069181825744000384639406458043;
-            double temp = posns[i][1] * cos_obliq_2000 + posns[i][2] * sin_obliq_2000;
-
-            posns[i][2] = posns[i][2] * cos_obliq_2000 - posns[i][1] * sin_obliq_2000;
-            posns[i][1] = temp;
-            }
-         }
-
-      for( i = 0; i < 3; ++i)
-         perturber_loc[i] = posns[perturber_no - 1][i];  /* - posns[10][i]; */
-               /* rotate equatorial J2000.0 into ecliptical J2000: */
-      }
-}
-
-static double *make_position_cache( double jd0, const double stepsize,
-                     const int n_steps)
-{
-   double *rval = (double *)calloc( 2 + (size_t)n_steps * N_PERTURBERS * 6 * 3,
-                                           sizeof( double));
-   double *tptr = rval + 2;
-   int i, j, step;
+   for( i = 0; i < 10; i++)
+      if( (mask >> i) & 1ul)
+         {        /* rotate equatorial J2000.0 into ecliptical J2000: */
+         const double sin_obliq_2000 = 0.397777155931913701597179975942380896684;
+         const double cos_obliq_2000 = 0.917482062069181825744000384639406458043;
+         double *loc = locs + i * 3;
 
-   if( !rval)
-      {
-      printf( "Ran out of memory!\n");
-      exit( -1);
-      }
-   rval[0] = jd0;
-   rval[1] = stepsize;
-   for( step = 0; step < n_steps; step++)
-      {
-      for( j = 0; j < 6; j++)
-         {
-         const double avals[6] = { 0., 2. / 9., 1./3., .75, 1., 5./6. };
-
-         for( i = 0; i < N_PERTURBERS; i++)
-            {
-            if( (i < 10) && ((perturber_mask >> i) & 1ul))
-               compute_perturber( i + 1, jd0 + avals[j] * stepsize, tptr);
-            else        /* put it far,  far away where it won't do anything: */
-               tptr[0] = tptr[1] = tptr[2] = 1.e+8;
-            tptr += 3;
-            }
-         }
-      jd0 += stepsize;
-#ifdef OBSOLETE_DEBUGGING_CODE
-      while( step * 70 / n_steps > counter)
-         {
-         printf( "%d", counter % 10);
-         counter++;
-         }
-#endif
-      }
-   printf( "\n");
-   return( rval);
-}
-
-#define EARTH_MOON_RATIO 81.30056
-
-static double relative_mass[14] = { 1.,
-         1.660136795271931e-007,                /* mercury */
-         2.447838339664545e-006,                /* venus */
-         3.003489596331057e-006,                /* Earth */
-         3.227151445053866e-007,                /* Mars */
-         0.0009547919384243268,                 /* Jupiter */
-         0.0002858859806661309,                 /* saturn */
-         4.366244043351564e-005,                /* Uranus */
-         5.151389020466116e-005,                /* Neptune */
-         7.396449704142013e-009,                /* Pluto */
-         3.003489596331057e-006 / EARTH_MOON_RATIO, /* Moon */
-         4.7622e-10, 1.0775e-10, 1.3412e-10 };    /* Ceres,  Pallas, Vesta */
-
-#define MERCURY_R   (2439.4 / AU_IN_KM)
-#define VENUS_R     (6051. / AU_IN_KM)
-#define EARTH_R     (6378.140 / AU_IN_KM)
-#define MARS_R      (3397.0 / AU_IN_KM)
-#define JUPITER_R   (71492. / AU_IN_KM)
-#define SATURN_R    (60330. / AU_IN_KM)
-#define URANUS_R    (25559. / AU_IN_KM)
-#define NEPTUNE_R   (25225. / AU_IN_KM)
-#define PLUTO_R     (1500. / AU_IN_KM)
-#define MOON_R      (1748.2 / AU_IN_KM)
-
-/* See 'runge.cpp' in Find_Orb for an explanation of this.  Basically,
-it keeps accelerations from reaching infinity as an object passes through
-a planet.  Integrate backward,  and 2018 LA,  2008 TC3,  and 2014 AA
-will do exactly that,  and the integration step size can drop to zero.
-The following code ramps acceleration _down_ as you approach the center
-of a planet.  */
-
-#define FUDGE_FACTOR   0.9
-
-static double compute_accel_multiplier( double fraction)
-{
-   const double r0 = .8;  /* acceleration drops to zero at 80% of planet radius */
-   double rval;
-
-   assert( fraction >= 0. && fraction <= 1.);
-   if( fraction < r0)
-      rval = 0.;
-   else
-      {
-      fraction = (fraction - r0) / (1. - r0);
-      assert( fraction >= 0. && fraction <= 1.);
-      rval =  fraction * fraction * (3. - 2. * fraction);
-      }
-   return( rval);
-}
-
-static int compute_derivatives( const double jd, ELEMENTS *elems,
-               double *delta, double *derivs, double *posn_data)
-{
-   double accel[3], posnvel[6];
-   int i;
-
-   comet_posn_and_vel( elems, jd, posnvel, posnvel + 3);
-   set_differential_acceleration( posnvel, delta, accel);
-   for( i = 0; i < N_PERTURBERS; i++)       /* include perturbers */
-      if( (perturber_mask >> i) & 1ul)
-         {
-         double perturber_loc[3], diff[3], diff_squared = 0., dfactor;
-         double radius_squared = 0., rfactor, d, r;
-         int j;
-         static const double planet_radius[10] = {
-                         MERCURY_R * FUDGE_FACTOR,
-                        VENUS_R * FUDGE_FACTOR, EARTH_R * FUDGE_FACTOR,
-                        MARS_R * FUDGE_FACTOR, JUPITER_R * FUDGE_FACTOR,
-                        SATURN_R * FUDGE_FACTOR, URANUS_R * FUDGE_FACTOR,
-                        NEPTUNE_R * FUDGE_FACTOR, PLUTO_R * FUDGE_FACTOR,
-                        MOON_R * FUDGE_FACTOR };
-
-         if( posn_data)
-            memcpy( perturber_loc, posn_data + i * 3, 3 * sizeof( double));
-         else
-            if( i < 10)
-               compute_perturber( i + 1, jd, perturber_loc);
-            else
-               perturber_loc[0] = perturber_loc[1] = perturber_loc[2] = 1.e+8;
-         for( j = 0; j < 3; j++)
-            {
-            diff[j] = perturber_loc[j] - (posnvel[j] + delta[j]);
-            diff_squared += diff[j] * diff[j];
-            radius_squared += perturber_loc[j] * perturber_loc[j];
-            }
-         d = sqrt( diff_squared);
-         r = sqrt( radius_squared);
-         dfactor = relative_mass[i + 1] / (diff_squared * d);
-         rfactor = relative_mass[i + 1] / (radius_squared * r);
-         if( i < 10)
-            {
-            if( d < planet_radius[i])
-               dfactor *= compute_accel_multiplier( d / planet_radius[i]);
-            if( r < planet_radius[i])
-               rfactor *= compute_accel_multiplier( r / planet_radius[i]);
-            }
          for( j = 0; j < 3; j++)
-            accel[j] += diff[j] * dfactor - perturber_loc[j] * rfactor;
+            loc[j] = posns[i][j];
+         loc[1] = posns[i][1] * cos_obliq_2000 + posns[i][2] * sin_obliq_2000;
+         loc[2] = posns[i][2] * cos_obliq_2000 - posns[i][1] * sin_obliq_2000;
          }
-
-                      /* copy in Ceres,  Pallas, Vesta loc if needed: */
-   if( posn_data && asteroid_perturber_number >= 0)
-      memcpy( posn_data + asteroid_perturber_number * 3, posnvel,
-                        3 * sizeof( double));
-   for( i = 0; i < 3; i++)
-      {
-      derivs[i] = delta[i + 3];
-      derivs[i + 3] = SOLAR_GM * accel[i];
-      }
-   return( 0);
-}
-
-#define N_VALUES 6
-      /* i.e.,  a state vector consumes six values: x, y, z, vx, vy, vz */
-
-static int take_step( const double jd, ELEMENTS *elems,
-                double *ival, double *ovals, double *errs,
-                double step_size)
-{
-   double *ivals[7], *ivals_p[6];
-   double ivals_1_buff[12 * N_VALUES];
-   double *posn_data = NULL;
-   int i, j, k;
-   const double bvals[27] = {2. / 9.,
-            1. / 12., 1. / 4.,
-            69. / 128., -243. / 128., 135. / 64.,
-            -17. / 12., 27. / 4., -27. / 5., 16. / 15.,
-            65. / 432., -5. / 16., 13 / 16., 4 / 27., 5. / 144.,
-            47. / 450., 0., 12 / 25., 32. / 225., 1. / 30., 6. / 25.,
-            -1. / 150., 0., .03, -16. / 75., -.05, .24};
-   const double *bptr = bvals;
-   const double avals[6] = { 0., 2. / 9., 1./3., .75, 1., 5./6. };
-
-   ivals[1] = ivals_1_buff;
-   for( i = 0; i < 6; i++)
-      {
-      ivals[i + 1] = ivals[1] + i * N_VALUES;
-      ivals_p[i] = ivals[1] + (i + 6) * N_VALUES;
-      }
-
-   if( fabs( step_size - position_cache[1]) < .000001)
-      {
-      int cache_loc = (int)floor( (jd - position_cache[0]) / step_size + .5);
-
-      if( cache_loc >= 0 && cache_loc < position_cache_size)
-         posn_data = position_cache + 2 + cache_loc * 6 * N_PERTURBERS * 3;
-      }
-
-   compute_derivatives( jd, elems, ival, ivals_p[0], posn_data);
-
-   for( j = 1; j < 7; j++)
-      {
-      for( i = 0; i < N_VALUES; i++)
-         {
-         double tval = 0.;
-
-         for( k = 0; k < j; k++)
-            tval += bptr[k] * ivals_p[k][i];
-         ivals[j][i] = tval * step_size + ival[i];
-         }
-      bptr += j;
-      if( j != 6)
-         compute_derivatives( jd + step_size * avals[j], elems,
-                     ivals[j], ivals_p[j], posn_data ?
-                     posn_data + j * N_PERTURBERS * 3 : NULL);
-      }
-
-   if( errs)
-      for( i = 0; i < N_VALUES; i++)
-         {
-         double tval = 0.;
-
-         for( k = 0; k < 6; k++)
-            tval += bptr[k] * ivals_p[k][i];
-         errs[i] = step_size * tval;
-         }
-
-   memcpy( ovals, ivals[6], N_VALUES * sizeof( double));
-   n_steps_taken++;
-   return( 0);
-}
-
-/* The following 'full_rk_step' integrates using the Runge-Kutta-Fehlberg
-fifth-order integrator with automatic stepsize,  as described in J M A
-Danby's _Fundamentals of Celestial Mechanics_,  second edition,  pages
-297-299.  Basically,  the integration is done both to fourth and fifth
-order.  The difference gives us an idea of the error for that step.  If
-it is greater than some desired amount,  we can try again with a smaller
-step size.
-
-   After each step,  we recompute the step size:  if the previous step
-resulted in a really low error,  we need to raise the step size,  and
-if it caused a lot of error,  we decrease the step size.  */
-
-static int full_rk_step( ELEMENTS *elems, double *ivals, double *ovals,
-                double t0, double t1, double max_err)
-{
-   double step = t1 - t0;
-   double errs[N_VALUES], new_vals[N_VALUES];
-   int n_chickens = 0;
-
-   memcpy( ovals, ivals, N_VALUES * sizeof( double));
-   max_err *= max_err;
-   while( t0 != t1)
-      {
-      double err_val = 0.;
-      const double chicken_factor = .9;
-      int i;
-
-      take_step( t0, elems, ovals, new_vals, errs, step);
-      for( i = 0; i < N_VALUES; i++)
-         err_val += errs[i] * errs[i];
-      if( err_val < max_err)   /* yeah,  it was a good step */
-         {
-         memcpy( ovals, new_vals, N_VALUES * sizeof( double));
-         t0 += step;
-         }
-      else
-         n_chickens++;
-      step *= chicken_factor * exp( log( max_err / err_val) / 5.);
-      if( t0 < t1)
-         if( t0 + step > t1)
-            step = t1 - t0;
-      if( t1 < t0)
-         if( t0 + step < t1)
-            step = t1 - t0;
-/*    if( err_val >= max_err)                             */
-/*       printf( "Chickened out: new step %lf\n", step);  */
-      }
-   return( n_chickens);
-}
-
-/* 'integrate_orbit' integrates the elements over the desired time span to
-   the desired maximum error,  using the number of steps requested.  The
-   orbit is broken up into that many steps,  and 'full_rk_step' is then
-   called for each step.  The individual steps will probably be taken in
-   one RKF step,  but if their errors prove to be too great,  they'll
-   be broken into sub-steps.  See comments for the above code.
-
-   The reason for this is speed.  Much of Integrat's time is spent in
-   computing planetary positions.  If the steps fall on an evenly spaced
-   grid,  the positions can be drawn from a precomputed array.  For the
-   cases that break up into sub-steps,  planetary positions have to be
-   computed "from scratch".  But with a suitably short step size,  you
-   can keep that from happening too often.
-
-   The down side to all of this is complexity and (often) taking some
-   unnecessary steps for main-belt objects,  where a larger step size
-   would work just fine.  I _do_ have a better scheme in mind,  and it's
-   implemented in my Find_Orb software... but not here (yet).   */
-
-int integrate_orbit( ELEMENTS *elem, const double jd_from, const double jd_to,
-                              const double max_err, const int n_steps)
-{
-   double delta[6],  posnvel[6], stepsize = (jd_to - jd_from) / (double)n_steps;
-   double curr_jd = jd_from;
-   int i, j;
-
-   for( i = 0; i < 6; i++)
-      delta[i] = 0.;
-   for( i = 0; i < n_steps; i++)
-      {
-      double new_delta[6];
-      int chickened_out;
-
-      chickened_out = full_rk_step( elem, delta, new_delta, curr_jd,
-                                         curr_jd + stepsize, max_err);
-      memcpy( delta, new_delta, 6 * sizeof( double));
-      curr_jd += stepsize;
-      if( i && (i % resync_freq == 0 || chickened_out))
-         {
-         comet_posn_and_vel( elem, curr_jd, posnvel, posnvel + 3);
-         for( j = 0; j < 6; j++)
-            {
-            posnvel[j] += delta[j];
-            delta[j] = 0.;
-            }
-         elem->epoch = curr_jd;
-         elem->gm = SOLAR_GM;
-         calc_classical_elements( elem, posnvel, curr_jd, 1);
-         }
-      }
-   comet_posn_and_vel( elem, jd_to, posnvel, posnvel + 3);
-   for( i = 0; i < 6; i++)
-      posnvel[i] += delta[i];
-   elem->epoch = jd_to;
-   elem->gm = SOLAR_GM;
-   calc_classical_elements( elem, posnvel, jd_to, 1);
-   return( 0);
+   return( rval);
 }
 
-int load_vsop_data( void)
+static char *load_vsop_data( void)
 {
    FILE *ifile = err_fopen( "vsop.bin", "rb");
    const unsigned vsop_size = 60874u;
+   char *vsop_data = (char *)calloc( vsop_size, 1);
 
-   vsop_data = NULL;
-   if( ifile)
+   if( vsop_data)
       {
-      vsop_data = (char *)calloc( vsop_size, 1);
-      if( vsop_data)
-         {
-         const size_t bytes_read = fread( vsop_data, 1, vsop_size, ifile);
+      const size_t bytes_read = fread( vsop_data, 1, vsop_size, ifile);
 
-         assert( bytes_read == vsop_size);
-         }
-      fclose( ifile);
+      assert( bytes_read == vsop_size);
       }
-   return( ifile && vsop_data ? 0 : -1);
+   fclose( ifile);
+   return( vsop_data);
 }
 
 static double centralize( double ang)
@@ -643,48 +215,162 @@ static int put_elem_into_sof( const char *header, char *buff, const ELEMENTS *el
 
 static int integrate_unperturbed = 0;
 
-static double try_to_integrate( const char *header, char *buff, const double dest_jd,
-                         const double max_err, const double stepsize)
+/* Integrates with the grid scheme,  then the adaptive one (whose result
+we keep),  timing each and noting how far apart the results are.  */
+
+static void run_benchmark( integration_t *integ, benchmark_t *bench,
+            ELEMENTS *elem, const double dest_jd, const double max_err,
+            const double stepsize, const int n_steps)
 {
-   ELEMENTS elem;
-   int got_it = 0, pluto_removed = 0;
+   ELEMENTS elem2 = *elem;
+   double loc[4], loc2[4], diff;
+   int pass;
+
+   for( pass = 1; pass >= 0; pass--)
+      {
+      const int64_t t0 = nanoseconds_since_1970( );
+
+      integ->n_steps_taken = integ->n_evals = 0;
+      integ->use_grid = (pass == 1);
+      if( pass)
+         integrate_orbit( integ, &elem2, elem2.epoch, dest_jd, max_err, n_steps);
+      else
+         integrate_adaptively( integ, elem, elem->epoch, dest_jd, max_err,
+                                       stepsize, NULL);
+      bench->run_time[pass] += (double)( nanoseconds_since_1970( ) - t0) * 1e-9;
+      bench->n_steps[pass] += integ->n_steps_taken;
+      bench->n_evals[pass] += integ->n_evals;
+      }
+   integ->use_grid = 0;
+   comet_posn_and_vel( elem, dest_jd, loc, NULL);
+   comet_posn_and_vel( &elem2, dest_jd, loc2, NULL);
+   diff = sqrt( (loc[0] - loc2[0]) * (loc[0] - loc2[0])
+              + (loc[1] - loc2[1]) * (loc[1] - loc2[1])
+              + (loc[2] - loc2[2]) * (loc[2] - loc2[2]));
+   if( bench->max_diff < diff)
+      bench->max_diff = diff;
+   bench->n_objects++;
+}
+
+static void show_benchmark( const benchmark_t *bench)
+{
+   const char *names[2] = { "adaptive (GBS, Chebyshev perturbers)",
+                            "grid (RKF45, position cache)" };
+   int i;
+
+   if( !bench->n_objects)
+      return;
+   printf( "\n%ld objects integrated both ways:\n", bench->n_objects);
+   printf( "                                      steps/obj evals/obj  setup(s)    run(s)\n");
+   for( i = 0; i < 2; i++)
+      printf( "%-37s %9.1f %9.1f %9.3f %9.3f\n", names[i],
+               (double)bench->n_steps[i] / (double)bench->n_objects,
+               (double)bench->n_evals[i] / (double)bench->n_objects,
+               bench->setup_time[i], bench->run_time[i]);
+   printf( "Largest difference in position at the end: %.3g AU\n",
+               bench->max_diff);
+}
+
+static void *out_of_memory_check( void *ptr)
+{
+   if( !ptr)
+      {
+      printf( "Ran out of memory!\n");
+      exit( -1);
+      }
+   return( ptr);
+}
+
+/* Returns false if the elements can't be read,  or if the object isn't
+perturbed (and we're not integrating those anyway).  */
 
+static bool get_elements_to_integrate( ELEMENTS *elem, const char *header,
+                                       const char *buff)
+{
    if( !integrate_unperturbed)
       {
       const char *tptr = strstr( header, "|Perts");
 
       if( tptr && !memcmp( buff + (tptr - header), "      ", 6))
-         return( 0.);
+         return( false);
+      }
+   if( extract_sof_data_ex( elem, buff, header, NULL))
+      return( false);
+   elem->angular_momentum = sqrt( SOLAR_GM * elem->q);
+   elem->angular_momentum *= sqrt( 1. + elem->ecc);
+   return( true);
+}
+
+static void make_cache_if_needed( integration_t *integ, benchmark_t *bench,
+            const double jd0, const double dest_jd, const int n_steps)
+{
+   if( !integ->position_cache && (integ->use_grid || bench))
+      {                       /* gotta initialize it: */
+      const int64_t t0 = nanoseconds_since_1970( );
+
+      integ->position_cache = (double *)out_of_memory_check(
+                  make_position_cache( integ, jd0,
+                  (dest_jd - jd0) / (double)n_steps, n_steps));
+      printf( "\n");
+      if( bench)
+         bench->setup_time[1] +=
+                     (double)( nanoseconds_since_1970( ) - t0) * 1e-9;
       }
-   got_it = !extract_sof_data_ex( &elem, buff, header, NULL);
+}
+
+/* If 'bench' is non-NULL,  the object is integrated both ways;  see
+run_benchmark( ).  */
+
+static double try_to_integrate( integration_t *integ, benchmark_t *bench,
+                     const char *header, char *buff, const double dest_jd,
+                     const double max_err, const double stepsize)
+{
+   ELEMENTS elem;
+   int pluto_removed = 0;
+
+   if( !get_elements_to_integrate( &elem, header, buff))
+      return( 0.);
    if( !memcmp( buff, "      134340 ", 13))   /* don't let (134340) Pluto */
-      if( perturber_mask & PERTURBERS_PLUTO)    /* perturb itself! */
+      if( integ->perturber_mask & PERTURBERS_PLUTO)  /* perturb itself! */
          {
          pluto_removed = 1;
-         perturber_mask ^= PERTURBERS_PLUTO;
+         integ->perturber_mask ^= PERTURBERS_PLUTO;
          }
 
-   if( got_it && dest_jd != 0. && elem.epoch != 0.)
+   if( dest_jd != 0. && elem.epoch != 0.)
       {
-      int n_steps;
+      const int n_steps = (int)fabs( (dest_jd - elem.epoch) / stepsize) + 2;
 
-      n_steps = (int)fabs( (dest_jd - elem.epoch) / stepsize) + 2;
-      elem.angular_momentum = sqrt( SOLAR_GM * elem.q);
-      elem.angular_momentum *= sqrt( 1. + elem.ecc);
-
-      if( !position_cache)       /* gotta initialize it: */
+      make_cache_if_needed( integ, bench, elem.epoch, dest_jd, n_steps);
+      if( !integ->use_grid)
          {
-         position_cache_size = n_steps;
-         position_cache = make_position_cache( elem.epoch,
-                     (dest_jd - elem.epoch) / (double)n_steps, n_steps);
+         const int64_t t0 = nanoseconds_since_1970( );
+
+         if( !integ->ephem)
+            integ->ephem = (perturber_ephem_t *)out_of_memory_check(
+                     make_perturber_ephem( integ, elem.epoch, dest_jd));
+         if( integ->asteroid_perturber_number >= 0)
+            if( fit_asteroid_perturber( integ, integ->ephem, &elem,
+                                       max_err, stepsize))
+               out_of_memory_check( NULL);
+         if( bench)
+            bench->setup_time[0] +=
+                        (double)( nanoseconds_since_1970( ) - t0) * 1e-9;
          }
 
-      integrate_orbit( &elem, elem.epoch, dest_jd, max_err, n_steps);
+      if( bench)
+         run_benchmark( integ, bench, &elem, dest_jd, max_err, stepsize,
+                                       n_steps);
+      else if( integ->use_grid)
+         integrate_orbit( integ, &elem, elem.epoch, dest_jd, max_err, n_steps);
+      else
+         integrate_adaptively( integ, &elem, elem.epoch, dest_jd, max_err,
+                                       stepsize, NULL);
       put_elem_into_sof( header, buff, &elem);
       }
 
    if( pluto_removed)
-      perturber_mask ^= PERTURBERS_PLUTO;
+      integ->perturber_mask ^= PERTURBERS_PLUTO;
    return( elem.epoch);
 }
 
@@ -751,24 +437,349 @@ static void error_exit( void)
 #define JAN_1970 2440587.5
 #define LINE_SIZE 300
 
+/* If the object's in the file from a previous run,  with unchanged data
+(see compute_hash( ) above),  'buff' is replaced with that result.  */
+
+static bool get_from_update( char *buff, const char *header,
+            FILE *update_file, const long *hashes, const long *file_offsets)
+{
+   const long hash_val = compute_hash( header, buff);
+   bool rval = false;
+
+   if( hash_val)
+      {
+      char buff2[220];
+      const unsigned hash_loc = find_in_table( hashes, hash_val);
+
+      if( hashes[hash_loc])
+         {
+         assert( hashes[hash_loc] == hash_val);
+         fseek( update_file, file_offsets[hash_loc], SEEK_SET);
+         if( fgets( buff2, sizeof( buff2), update_file)
+                      && !memcmp( buff2, buff, 20)
+                      && !memcmp( buff2 + 105, buff + 105, 97))
+            {
+            strcpy( buff, buff2);
+            rval = true;
+            }
+         }
+      }
+   return( rval);
+}
+
+typedef struct
+{
+   int64_t t0;
+   double t_last_printout;
+   int n_integrated, n_found_from_update, total_asteroids_in_file;
+} progress_t;
+
+static void show_progress( progress_t *prog, const char *buff,
+                                    const long n_steps)
+{
+   const int64_t t = nanoseconds_since_1970( );
+   const double elapsed_time = (double)( t - prog->t0) * 1e-9;
+
+   if( verbose > 1)
+      {
+      char tbuff[30];
+
+      memcpy( tbuff, buff, 29);
+      tbuff[29] = '\0';
+      printf( "%s: %.2f seconds;  %5ld steps: %5d integrated\n",
+                      tbuff, elapsed_time, n_steps, prog->n_integrated);
+      prog->t0 = t;        /* restart the clock */
+      }
+   else if( elapsed_time > prog->t_last_printout + 1.)
+      {
+      prog->t_last_printout = elapsed_time;
+      printf( "%.0f seconds elapsed;  %.0f seconds remain; %d done %d    \r",
+                  elapsed_time,
+                 (double)( prog->total_asteroids_in_file - prog->n_integrated)
+                 * elapsed_time / (double)prog->n_integrated,
+                 prog->n_integrated,
+                 prog->n_found_from_update);
+      }
+}
+
+typedef struct
+{
+   char buff[LINE_SIZE];
+   long n_steps;
+   bool done, integrated;
+} work_slot_t;
+
+/* With '-l',  objects are integrated INTEGRATION_BLOCK_SIZE at a time in
+lockstep (see integrate_orbits( ) in perturb.cpp).  Slots already marked
+'done' are skipped.  Objects with epochs differing from that of the first
+in the block,  and (134340) Pluto,  are integrated one at a time.  */
+
+static void integrate_block( integration_t *integ, work_slot_t **slots,
+               const int n_slots, const char *header, const double dest_jd,
+               const double max_err, const double stepsize)
+{
+   ELEMENTS elems[INTEGRATION_BLOCK_SIZE];
+   work_slot_t *in_block[INTEGRATION_BLOCK_SIZE];
+   int i, n = 0;
+
+   assert( n_slots <= INTEGRATION_BLOCK_SIZE);
+   for( i = 0; i < n_slots; i++)
+      if( !slots[i]->done)
+         {
+         if( get_elements_to_integrate( elems + n, header, slots[i]->buff)
+                     && elems[n].epoch != 0.
+                     && (!n || elems[n].epoch == elems[0].epoch)
+                     && memcmp( slots[i]->buff, "      134340 ", 13))
+            in_block[n++] = slots[i];
+         else
+            {
+            integ->n_steps_taken = 0;
+            slots[i]->integrated = (try_to_integrate( integ, NULL, header,
+                        slots[i]->buff, dest_jd, max_err, stepsize) != 0.);
+            slots[i]->n_steps = integ->n_steps_taken;
+            }
+         }
+   if( n)
+      {
+      const int n_steps = (int)fabs( (dest_jd - elems[0].epoch) / stepsize) + 2;
+
+      make_cache_if_needed( integ, NULL, elems[0].epoch, dest_jd, n_steps);
+      integ->n_steps_taken = 0;
+      integrate_orbits( integ, elems, n, elems[0].epoch, dest_jd,
+                                       max_err, n_steps);
+      for( i = 0; i < n; i++)
+         {
+         put_elem_into_sof( header, in_block[i]->buff, elems + i);
+         in_block[i]->integrated = true;
+         in_block[i]->n_steps = integ->n_steps_taken / n;
+         }
+      }
+}
+
+/* Used when single-threaded:  integrates a block,  then writes it out. */
+
+static void write_block( integration_t *integ, work_slot_t *block,
+               const int n_slots, const char *header, const double dest_jd,
+               const double max_err, const double stepsize,
+               progress_t *prog, FILE *ofile)
+{
+   work_slot_t *slots[INTEGRATION_BLOCK_SIZE];
+   int i;
+
+   for( i = 0; i < n_slots; i++)
+      slots[i] = block + i;
+   integrate_block( integ, slots, n_slots, header, dest_jd, max_err, stepsize);
+   for( i = 0; i < n_slots; i++)
+      {
+      if( block[i].integrated)
+         {
+         prog->n_integrated++;
+         show_progress( prog, block[i].buff, block[i].n_steps);
+         }
+      fputs( block[i].buff, ofile);
+      }
+}
+
+#ifdef THREADED
+#define N_WORK_SLOTS 4096
+
+/* Slot i is at slots[i % N_WORK_SLOTS].  Slots below n_claimed have been
+taken by workers (or need no work);  those below n_filled hold input.  */
+
+typedef struct
+{
+   work_slot_t *slots;
+   long n_filled, n_claimed;
+   bool input_done;
+   const char *header;
+   double dest_jd, max_err, stepsize;
+   int block_size;            /* 1,  or INTEGRATION_BLOCK_SIZE with -l */
+   const integration_t *integ;
+   const char *ephem_filename;         /* JPL ephemeris,  if any */
+   pthread_mutex_t mutex;
+   pthread_cond_t work_ready, slot_done;
+} work_queue_t;
+
+static void *integration_thread( void *arg)
+{
+   work_queue_t *q = (work_queue_t *)arg;
+   integration_t integ = *q->integ;
+
+   if( q->ephem_filename)           /* each thread gets its own JPL handle */
+      {
+      integ.source_data = jpl_init_ephemeris( q->ephem_filename, NULL, NULL);
+      if( !integ.source_data)
+         {
+         printf( "JPL ephemeris file '%s' couldn't be opened by a thread\n",
+                                    q->ephem_filename);
+         error_exit( );
+         exit( -3);
+         }
+      }
+   pthread_mutex_lock( &q->mutex);
+   for( ;;)
+      {
+      work_slot_t *slots[INTEGRATION_BLOCK_SIZE];
+      int i, n_slots = 0;
+
+      while( q->n_filled - q->n_claimed < q->block_size && !q->input_done)
+         pthread_cond_wait( &q->work_ready, &q->mutex);
+      if( q->n_claimed == q->n_filled)       /* nothing left to do */
+         break;
+      while( n_slots < q->block_size && q->n_claimed < q->n_filled)
+         {
+         work_slot_t *slot = q->slots + q->n_claimed++ % N_WORK_SLOTS;
+
+         if( !slot->done)     /* if done,  got it from an update */
+            slots[n_slots++] = slot;
+         }
+      if( !n_slots)
+         continue;
+      pthread_mutex_unlock( &q->mutex);
+      if( q->block_size > 1)
+         integrate_block( &integ, slots, n_slots, q->header,
+                           q->dest_jd, q->max_err, q->stepsize);
+      else
+         {
+         integ.n_steps_taken = 0;
+         slots[0]->integrated = (try_to_integrate( &integ, NULL, q->header,
+                     slots[0]->buff, q->dest_jd, q->max_err, q->stepsize) != 0.);
+         slots[0]->n_steps = integ.n_steps_taken;
+         }
+      pthread_mutex_lock( &q->mutex);
+      for( i = 0; i < n_slots; i++)
+         slots[i]->done = true;
+      pthread_cond_signal( &q->slot_done);
+      }
+   pthread_mutex_unlock( &q->mutex);
+   if( q->ephem_filename)
+      jpl_close_ephemeris( integ.source_data);
+   return( NULL);
+}
+
+/* The main thread reads in orbits,  checking each against the update file
+(if any),  and writes out results in order as they're finished.   */
+
+static void integrate_with_threads( const int n_threads, work_queue_t *q,
+               FILE *ifile, FILE *ofile, progress_t *prog,
+               const int max_asteroids, FILE *update_file,
+               const long *hashes, const long *file_offsets)
+{
+   pthread_t *threads = (pthread_t *)calloc( n_threads, sizeof( pthread_t));
+   long n_written = 0;
+   int i, n_to_integrate = prog->n_integrated;
+   integration_t check_integ = *q->integ;
+
+   q->slots = (work_slot_t *)calloc( N_WORK_SLOTS, sizeof( work_slot_t));
+   if( !threads || !q->slots)
+      {
+      printf( "Ran out of memory!\n");
+      exit( -1);
+      }
+   q->n_filled = q->n_claimed = 0;
+   q->input_done = false;
+   pthread_mutex_init( &q->mutex, NULL);
+   pthread_cond_init( &q->work_ready, NULL);
+   pthread_cond_init( &q->slot_done, NULL);
+   for( i = 0; i < n_threads; i++)
+      if( pthread_create( threads + i, NULL, integration_thread, q))
+         {
+         printf( "Couldn't create thread %d\n", i);
+         exit( -1);
+         }
+   pthread_mutex_lock( &q->mutex);
+   while( !q->input_done || n_written < q->n_filled)
+      {
+      bool wrote_something = false;
+
+      while( !q->input_done && q->n_filled - n_written < N_WORK_SLOTS)
+         {                    /* the slot we're about to fill is ours alone */
+         work_slot_t *slot = q->slots + q->n_filled % N_WORK_SLOTS;
+         bool got_line;
+
+         pthread_mutex_unlock( &q->mutex);
+         got_line = (n_to_integrate < max_asteroids
+                  && fgets( slot->buff, LINE_SIZE, ifile));
+         if( got_line)
+            {
+            slot->done = (update_file && get_from_update( slot->buff,
+                     q->header, update_file, hashes, file_offsets));
+            slot->integrated = false;
+            if( slot->done)
+               prog->n_found_from_update++;
+            else if( try_to_integrate( &check_integ, NULL, q->header,
+                           slot->buff, 0., q->max_err, q->stepsize) != 0.)
+               n_to_integrate++;
+            }
+         pthread_mutex_lock( &q->mutex);
+         if( got_line)
+            {
+            q->n_filled++;
+            pthread_cond_signal( &q->work_ready);
+            }
+         else
+            {
+            q->input_done = true;
+            pthread_cond_broadcast( &q->work_ready);
+            }
+         }
+      while( n_written < q->n_filled && q->slots[n_written % N_WORK_SLOTS].done)
+         {
+         work_slot_t *slot = q->slots + n_written % N_WORK_SLOTS;
+
+         pthread_mutex_unlock( &q->mutex);
+         if( slot->integrated)
+            {
+            prog->n_integrated++;
+            show_progress( prog, slot->buff, slot->n_steps);
+            }
+         fputs( slot->buff, ofile);
+         pthread_mutex_lock( &q->mutex);
+         n_written++;
+         wrote_something = true;
+         }
+      if( !wrote_something && (q->input_done
+                        || q->n_filled - n_written == N_WORK_SLOTS))
+         pthread_cond_wait( &q->slot_done, &q->mutex);
+      }
+   pthread_mutex_unlock( &q->mutex);
+   for( i = 0; i < n_threads; i++)
+      pthread_join( threads[i], NULL);
+   pthread_mutex_destroy( &q->mutex);
+   pthread_cond_destroy( &q->work_ready);
+   pthread_cond_destroy( &q->slot_done);
+   free( q->slots);
+   free( threads);
+}
+#endif
+
 int main( int argc, const char **argv)
 {
    FILE *ifile, *ofile, *update_file = NULL;
    const char *temp_file_name = "ickywax.ugh";
    long *hashes, *file_offsets, hash_val;
    const char *ephem_filename = NULL;
-   double dest_jd, max_err = 1.e-12, stepsize = 2., t_last_printout = 0.;
+   double dest_jd, max_err = 1.e-12, stepsize = 2.;
    double starting_jd = 0.;
    char buff[LINE_SIZE], time_buff[60], header[LINE_SIZE];
-   int i, n_integrated = 0, total_asteroids_in_file;
+   int i, total_asteroids_in_file;
    int max_asteroids = (1 << 30);
-#ifdef FORKING
-   int n_processes = 0, process_number = 0, child_status;
-   bool forking_has_happened = false;
+#ifdef THREADED
+   int n_threads = 0;
 #endif
-   int quit = 0, n_found_from_update = 0;
-   clock_t t0;
-   bool update_existing_file = true;
+   int quit = 0, use_grid = 0, resync_freq = 50, n_in_block = 0;
+   bool update_existing_file = true, lockstep = false;
+   integration_t integ;
+   progress_t prog;
+   benchmark_t bench, *bench_ptr = NULL;
+   unsigned long perturber_mask = PERTURBERS_MERCURY_TO_NEPTUNE;
+      /*  PERTURBERS_MERCURY_TO_NEPTUNE | PERTURBERS_CERES_PALLAS_VESTA; */
+   void *jpl_ephemeris = NULL;
+   char *vsop_data = NULL;
+   work_slot_t block[INTEGRATION_BLOCK_SIZE];
+
+   memset( &prog, 0, sizeof( prog));
+   memset( &bench, 0, sizeof( bench));
 
    if( argc < 4)
       {
@@ -842,11 +853,25 @@ int main( int argc, const char **argv)
       if( argv[i][0] == '-')
          switch( argv[i][1])
             {
+            case 'b':
+               bench_ptr = &bench;
+               printf( "Benchmarking adaptive and grid integration\n");
+               break;
             case 'f':
                ephem_filename = argv[i] + 2;
                if( !*ephem_filename && i < argc - 1)
                   ephem_filename = argv[i + 1];
                break;
+            case 'g':
+               use_grid = 1;
+               printf( "Integrating on a grid\n");
+               break;
+            case 'l':
+               lockstep = true;
+               use_grid = 1;
+               printf( "Integrating blocks of %d objects in lockstep on a grid\n",
+                              INTEGRATION_BLOCK_SIZE);
+               break;
             case 'n':
                max_asteroids = atoi( argv[i] + 2);
                printf( "Only integrating up to %d objects\n", max_asteroids);
@@ -871,9 +896,9 @@ int main( int argc, const char **argv)
                verbose = 1 + atoi( argv[i] + 2);
                printf( "Setting verbose output\n");
                break;
-#ifdef FORKING
+#ifdef THREADED
             case 'z':
-               n_processes = atoi( argv[i] + 2);
+               n_threads = atoi( argv[i] + 2);
                break;
 #endif
             default:
@@ -892,17 +917,23 @@ int main( int argc, const char **argv)
       perturber_mask |= PERTURBERS_PLUTO_AND_MOON;
       if( verbose)
          printf( "Using JPL ephemeris file '%s'\n", ephem_filename);
+      init_integration( &integ, jpl_perturber_source, jpl_ephemeris,
+                                    perturber_mask);
       }
-
-   if( !jpl_ephemeris && load_vsop_data( ))
+   else
       {
-      printf( "VSOP.BIN not loaded!\n");
-      error_exit( );
-      return( -4);
+      vsop_data = load_vsop_data( );
+      if( !vsop_data)
+         {
+         printf( "VSOP.BIN not loaded!\n");
+         error_exit( );
+         return( -4);
+         }
+      init_integration( &integ, vsop_perturber_source, vsop_data,
+                                    perturber_mask);
       }
-
-   if( !ephem_filename)          /* gotta lump the Moon in with the earth: */
-      relative_mass[3] += relative_mass[10];
+   integ.use_grid = use_grid;
+   integ.resync_freq = resync_freq;
 
    /* first,  go through the file to figure out how many asteroids  */
    /* we'll have integrate: */
@@ -911,7 +942,8 @@ int main( int argc, const char **argv)
    while( fgets( buff, sizeof( buff), ifile)
                      && total_asteroids_in_file < max_asteroids)
       {
-      const double tval = try_to_integrate( header, buff, 0., max_err, stepsize);
+      const double tval = try_to_integrate( &integ, NULL, header, buff, 0.,
+                                                max_err, stepsize);
 
       if( tval != 0. && starting_jd == 0.)
          {
@@ -933,134 +965,75 @@ int main( int argc, const char **argv)
 
    fseek( ifile, strlen( header), SEEK_SET);
 
-   t0 = clock( );
+   prog.total_asteroids_in_file = total_asteroids_in_file;
+   prog.t0 = nanoseconds_since_1970( );
+   if( bench_ptr)
+      lockstep = false;
    while( !quit && fgets( buff, sizeof( buff), ifile)
-                                 && n_integrated < max_asteroids)
+                     && prog.n_integrated + n_in_block < max_asteroids)
       {
       bool got_it_from_update = false;
 
-      asteroid_perturber_number = -1;
-      if( n_integrated < 4 && !memcmp( buff, "           ", 11))
+      integ.asteroid_perturber_number = -1;
+      if( prog.n_integrated < 4 && !memcmp( buff, "           ", 11))
          switch( atoi( buff))
             {
             case 1:              /* Ceres */
-               asteroid_perturber_number = 10;
+               integ.asteroid_perturber_number = 10;
                break;
             case 2:              /* Pallas */
-               asteroid_perturber_number = 11;
+               integ.asteroid_perturber_number = 11;
                break;
             case 4:              /* Vesta */
-               asteroid_perturber_number = 12;
+               integ.asteroid_perturber_number = 12;
                break;
             default:
                break;
             }
-#ifdef FORKING
-      if( (perturber_mask & 0x1c00) == 0x1c00 && n_processes
-               && !forking_has_happened)
+      if( lockstep && integ.asteroid_perturber_number == -1)
          {
-         char outfile_name[50];
-         int j;
-         const long offset = ftell( ifile);
-
-         forking_has_happened = true;
-         fclose( ofile);
-         fclose( ifile);
-         if( jpl_ephemeris)
-            jpl_close_ephemeris( jpl_ephemeris);
-         if( update_file)
-            fclose( update_file);
-         while( process_number < n_processes - 1)
+         work_slot_t *slot = block + n_in_block++;
+
+         strcpy( slot->buff, buff);
+         slot->done = (update_file && get_from_update( slot->buff, header,
+                                 update_file, hashes, file_offsets));
+         slot->integrated = false;
+         if( slot->done)
+            prog.n_found_from_update++;
+         if( n_in_block == INTEGRATION_BLOCK_SIZE)
             {
-            const pid_t childpid = fork( );
-
-            if( childpid == -1)      /* fork( ) returns -1 on failure */
-               {
-               perror( "fork"); /* display error message */
-               exit(0);
-               }
-            else if( childpid == 0)     /* we're a child process */
-               {
-//             printf( "Hi!  I'm child %d.  My PID is %d; parent's is %d\n",
-//                      process_number, getpid( ), getppid( ));
-               }
-            else
-               break;       /* break out of loop,  signalling we're a parent */
-            process_number++;
+            write_block( &integ, block, n_in_block, header, dest_jd,
+                              max_err, stepsize, &prog, ofile);
+            n_in_block = 0;
             }
-         printf( "Hi!  I've got process number %d,  PID %d,  parent's is %d\n",
-                        process_number, getpid( ), getppid( ));
-         snprintf_err( outfile_name, sizeof( outfile_name), "chunk%d.ugh", process_number);
-         ofile = err_fopen( chunk_filename( outfile_name, process_number), "wb");
-         ifile = err_fopen( argv[1], "rb");
-         fseek( ifile, offset, SEEK_SET);
-         if( jpl_ephemeris)
-            jpl_ephemeris = jpl_init_ephemeris( ephem_filename, NULL, NULL);
-         if( update_file)
-            update_file = err_fopen( temp_file_name, "rb");
-         j = 0;
-         while( j < process_number && fgets( buff, sizeof( buff), ifile))
-            j++;
+         continue;
          }
-#endif
-      if( update_file && asteroid_perturber_number == -1
-                          && (hash_val = compute_hash( header, buff)) != 0L)
+      if( n_in_block)         /* keep output in input order */
          {
-         char buff2[220];
-         const unsigned hash_loc = find_in_table( hashes, hash_val);
-
-         if( hashes[hash_loc])
-            {
-            assert( hashes[hash_loc] == hash_val);
-            fseek( update_file, file_offsets[hash_loc], SEEK_SET);
-            if( fgets( buff2, sizeof( buff2), update_file)
-                         && !memcmp( buff2, buff, 20)
-                         && !memcmp( buff2 + 105, buff + 105, 97))
-               {
-               strcpy( buff, buff2);
-               got_it_from_update = true;
-               n_found_from_update++;
-               }
-            }
+         write_block( &integ, block, n_in_block, header, dest_jd,
+                              max_err, stepsize, &prog, ofile);
+         n_in_block = 0;
          }
-
-      if( !got_it_from_update &&
-                  try_to_integrate( header, buff, dest_jd, max_err, stepsize) != 0.)
+      if( update_file && integ.asteroid_perturber_number == -1)
+         got_it_from_update = get_from_update( buff, header, update_file,
+                                       hashes, file_offsets);
+      if( got_it_from_update)
+         prog.n_found_from_update++;
+      else if( try_to_integrate( &integ, bench_ptr, header, buff, dest_jd,
+                                          max_err, stepsize) != 0.)
          {
-         clock_t t = clock( );
-         const double elapsed_time = (double)(t - t0) / (double)CLOCKS_PER_SEC;
-
-         if( asteroid_perturber_number > 0)
+         if( integ.asteroid_perturber_number > 0)
             {
             const char *pert_text[3] = { "(1) Ceres", "(2) Pallas", "(4) Vesta" };
 
-            assert( asteroid_perturber_number >= 10);
-            assert( asteroid_perturber_number < 13);
-            printf( "Perturber %s calculated\n", pert_text[asteroid_perturber_number - 10]);
-            perturber_mask |= (1L << asteroid_perturber_number);
-            }
-         n_integrated++;
-         if( verbose > 1)
-            {
-            char tbuff[30];
-
-            memcpy( tbuff, buff, 29);
-            tbuff[29] = '\0';
-            printf( "%s: %.2f seconds;  %5d steps: %5d integrated\n",
-                            tbuff, elapsed_time, n_steps_taken, n_integrated);
-            t0 = t;        /* restart the clock */
-            n_steps_taken = 0;
-            }
-         else if( elapsed_time > t_last_printout + 1.)
-            {
-            t_last_printout = elapsed_time;
-            printf( "%.0f seconds elapsed;  %.0f seconds remain; %d done %d    \r",
-                        elapsed_time,
-                       (double)(total_asteroids_in_file - n_integrated)
-                       * elapsed_time / (double)n_integrated,
-                       n_integrated,
-                       n_found_from_update);
+            assert( integ.asteroid_perturber_number >= 10);
+            assert( integ.asteroid_perturber_number < 13);
+            printf( "Perturber %s calculated\n", pert_text[integ.asteroid_perturber_number - 10]);
+            integ.perturber_mask |= (1L << integ.asteroid_perturber_number);
             }
+         prog.n_integrated++;
+         show_progress( &prog, buff, integ.n_steps_taken);
+         integ.n_steps_taken = 0;
 #ifdef _MSC_VER
          if( kbhit( ))
             if( getch( ) == 27)
@@ -1068,47 +1041,38 @@ int main( int argc, const char **argv)
 #endif
          }
       fputs( buff, ofile);
-#ifdef FORKING
-      if( forking_has_happened)
+#ifdef THREADED
+               /* Once Ceres,  Pallas,  Vesta are in the position cache */
+               /* or ephemeris,  the rest can be done in parallel :     */
+      if( (integ.perturber_mask & PERTURBERS_CERES_PALLAS_VESTA)
+                     == PERTURBERS_CERES_PALLAS_VESTA && n_threads && !bench_ptr)
          {
-         int j = 1;
-
-         while( j < n_processes && fgets( buff, sizeof( buff), ifile))
-            j++;
+         work_queue_t queue;
+
+         integ.asteroid_perturber_number = -1;
+         queue.header = header;
+         queue.dest_jd = dest_jd;
+         queue.max_err = max_err;
+         queue.stepsize = stepsize;
+         queue.block_size = (lockstep ? INTEGRATION_BLOCK_SIZE : 1);
+         queue.integ = &integ;
+         queue.ephem_filename = ephem_filename;
+         integrate_with_threads( n_threads, &queue, ifile, ofile, &prog,
+                        max_asteroids, update_file, hashes, file_offsets);
+         break;
          }
 #endif
       }
+   if( n_in_block)
+      write_block( &integ, block, n_in_block, header, dest_jd,
+                              max_err, stepsize, &prog, ofile);
+   show_benchmark( &bench);
+   free_perturber_ephem( integ.ephem);
+   free( integ.position_cache);
+   free( vsop_data);
    if( jpl_ephemeris)
       jpl_close_ephemeris( jpl_ephemeris);
    fclose( ifile);
    fclose( ofile);
-#ifdef FORKING
-   if( forking_has_happened)
-      {
-      printf( "Process %d is done\n", process_number);
-      wait( &child_status); /* wait for child to exit, and store its status */
-      printf( "Waiting is over for process %d\n", process_number);
-      if( !process_number)
-         {
-         FILE **ifiles = (FILE **)calloc( n_processes, sizeof( FILE *));
-
-         for( i = 0; i < n_processes; i++)
-            ifiles[i] = err_fopen( chunk_filename( buff, i), "rb");
-         ofile = err_fopen( argv[2], "ab");
-         i = 0;
-         while( fgets( buff, sizeof( buff), ifiles[i]))
-            {
-            fputs( buff, ofile);
-            i = (i + 1) % n_processes;
-            }
-         for( i = 0; i < n_processes; i++)
-            {
-            fclose( ifiles[i]);
-            unlink( chunk_filename( buff, i));
-            }
-         fclose( ofile);
-         }
-      }
-#endif
    return( 0);
 }
@@ -0,0 +1,245 @@
+/* kepbatch.cpp: two-body positions for many objects at once
+
+Copyright (C) 2026, Project Pluto
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+02110-1301, USA.    */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "watdefs.h"
+#include "comets.h"
+#include "lunar.h"
+
+/* comet_posn( ) handles one object at a time,  and most of its time goes
+to branches:  which sort of orbit is this,  how should Kepler's equation
+be started,  has it converged yet.  When you've a catalogue of a million
+asteroids to move to a given time (as astcheck does when making its
+'day data'),  nearly all of them are ordinary ellipses with e < .9,  for
+which the Meeus starting value plus a couple of Newton steps suffices.
+
+   So init_kepler_batch( ) copies the elements into a structure of
+arrays,  and batch_comet_posn( ) runs through them in blocks of
+KEP_BLOCK objects,  doing the same arithmetic for every object in a
+block,  with no branches or math library calls in the inner loops.  The
+cosines and sines come from fast_cos_sin( ) (see big_vsop.cpp),  which
+is itself a branch-free loop.  Kepler's equation is started from
+
+E0 = M + e sin(M) / (1 - e cos(M))
+
+   and given exactly KEP_ITERATIONS Newton steps,  the most any e < .9
+needs to converge to roundoff (checked over a fine grid in e and M).
+There's no test for convergence:  for lanes that have converged,  the
+extra steps change E by (at most) an ulp,  so every lane can do the same
+thing,  and the loops compile to SIMD code on SSE2,  AVX and NEON alike.
+Nothing here depends on a particular instruction set;  the compiler
+chooses the vector width.
+
+   Near-parabolic (e >= .9),  parabolic,  and hyperbolic orbits are
+flagged at setup and just get handed to the scalar comet_posn( ).
+
+   Also,  instead of going from eccentric to true anomaly (an atan2,
+then a cos and sin),  position and velocity are computed directly from
+the eccentric anomaly E :
+
+x = a(cos(E) - e)          y = b sin(E)
+dE/dt = n / (1 - e cos(E))     (n = mean motion = 1 / t0)
+
+   which agrees with comet_posn( ) to roundoff.   */
+
+#define KEP_BLOCK 8
+#define KEP_MAX_ECC .9
+#define KEP_ITERATIONS 7
+#define PI 3.1415926535897932384626433832795028841971693993751058209749445923
+#define ROUNDER      6755399441055744.
+
+typedef struct
+{
+   int n_objects;
+   double *perih_time, *t0, *ecc, *a, *b;
+   double *perih_vec[3], *sideways[3];
+   char *use_scalar;
+   const char *elems;       /* original elements,  for the scalar cases */
+   size_t elem_stride;
+} kepler_batch_t;
+
+/* 'elems' points to the first of 'n_elems' ELEMENTS,  each 'elem_stride'
+bytes apart (so you can pass,  say,  an array of structs that contain
+ELEMENTS).  They must stay put as long as the batch is in use;  they're
+consulted for objects that need the scalar code.  derive_quantities( )
+must already have been called for each.   */
+
+void *init_kepler_batch( const ELEMENTS *elems, const size_t elem_stride,
+                                      const int n_elems)
+{
+   kepler_batch_t *rval = (kepler_batch_t *)calloc( 1, sizeof( kepler_batch_t));
+   const size_t n_padded = (size_t)( n_elems + KEP_BLOCK);
+   double *dptr;
+   int i, j;
+
+   if( !rval)
+      return( NULL);
+   dptr = (double *)calloc( 11 * n_padded, sizeof( double));
+   rval->use_scalar = (char *)calloc( n_padded, 1);
+   if( !dptr || !rval->use_scalar)
+      {
+      free( dptr);
+      free( rval->use_scalar);
+      free( rval);
+      return( NULL);
+      }
+   rval->n_objects = n_elems;
+   rval->elems = (const char *)elems;
+   rval->elem_stride = elem_stride;
+   rval->perih_time = dptr;
+   rval->t0 = dptr + n_padded;
+   rval->ecc = dptr + 2 * n_padded;
+   rval->a = dptr + 3 * n_padded;
+   rval->b = dptr + 4 * n_padded;
+   for( j = 0; j < 3; j++)
+      {
+      rval->perih_vec[j] = dptr + (5 + j) * n_padded;
+      rval->sideways[j] = dptr + (8 + j) * n_padded;
+      }
+   for( i = 0; i < n_elems; i++)
+      {
+      const ELEMENTS *elem =
+                  (const ELEMENTS *)( rval->elems + (size_t)i * elem_stride);
+
+      if( elem->ecc >= KEP_MAX_ECC || !elem->t0)
+         {
+         rval->use_scalar[i] = 1;
+         rval->t0[i] = 1.;       /* keeps the block code away from 0/0 */
+         }
+      else
+         {
+         rval->perih_time[i] = elem->perih_time;
+         rval->t0[i] = elem->t0;
+         rval->ecc[i] = elem->ecc;
+         rval->a[i] = elem->major_axis;
+         rval->b[i] = elem->major_axis * elem->minor_to_major;
+         for( j = 0; j < 3; j++)
+            {
+            rval->perih_vec[j][i] = elem->perih_vec[j];
+            rval->sideways[j][i] = elem->sideways[j];
+            }
+         }
+      }
+   for( i = n_elems; i < (int)n_padded; i++)   /* padding lanes get a */
+      rval->t0[i] = 1.;                         /* harmless circular orbit */
+   return( rval);
+}
+
+void free_kepler_batch( void *batch)
+{
+   kepler_batch_t *kb = (kepler_batch_t *)batch;
+
+   if( kb)
+      {
+      free( kb->perih_time);
+      free( kb->use_scalar);
+      free( kb);
+      }
+}
+
+/* Computes positions for objects start...start+n-1,  object i at time
+t[i - start].  loc gets four values per object,  the same as comet_posn( ):
+x, y, z, and distance from the sun.  If vel is non-NULL,  it gets three
+values (the velocity) per object.  The batch is only read,  so several
+threads can use it at once.  */
+
+void batch_comet_posn( const void *batch, const int start, const int n,
+                           const double *t, double *loc, double *vel)
+{
+   const kepler_batch_t *kb = (const kepler_batch_t *)batch;
+   int block_start;
+
+   for( block_start = 0; block_start < n; block_start += KEP_BLOCK)
+      {
+      const int i0 = start + block_start;
+      const int n_in_block = (n - block_start < KEP_BLOCK ?
+                                 n - block_start : KEP_BLOCK);
+      double mean_anom[KEP_BLOCK], ecc_anom[KEP_BLOCK], time[KEP_BLOCK];
+      double sin_e[KEP_BLOCK], cos_e[KEP_BLOCK], x[KEP_BLOCK], y[KEP_BLOCK];
+      double ecc[KEP_BLOCK];     /* local copy,  so the compiler knows */
+      int i, j, iter;            /* it can't alias the arrays above    */
+
+      for( j = 0; j < KEP_BLOCK; j++)
+         ecc[j] = kb->ecc[i0 + j];
+      for( j = 0; j < KEP_BLOCK; j++)
+         time[j] = (j < n_in_block ? t[block_start + j]
+                                   : kb->perih_time[i0 + j]);
+      for( j = 0; j < KEP_BLOCK; j++)
+         {
+         const double m = (time[j] - kb->perih_time[i0 + j]) / kb->t0[i0 + j];
+         const double n_revs = (m * (.5 / PI) + ROUNDER) - ROUNDER;
+
+         mean_anom[j] = m - n_revs * (2. * PI);       /* to -pi...pi */
+         }
+      fast_cos_sin( mean_anom, cos_e, sin_e, KEP_BLOCK);
+      for( j = 0; j < KEP_BLOCK; j++)
+         ecc_anom[j] = mean_anom[j]
+                     + ecc[j] * sin_e[j] / (1. - ecc[j] * cos_e[j]);
+      for( iter = 0; iter < KEP_ITERATIONS; iter++)
+         {
+         fast_cos_sin( ecc_anom, cos_e, sin_e, KEP_BLOCK);
+         for( j = 0; j < KEP_BLOCK; j++)
+            ecc_anom[j] -= (ecc_anom[j] - ecc[j] * sin_e[j] - mean_anom[j])
+                                       / (1. - ecc[j] * cos_e[j]);
+         }
+      fast_cos_sin( ecc_anom, cos_e, sin_e, KEP_BLOCK);
+      for( j = 0; j < KEP_BLOCK; j++)
+         {
+         x[j] = kb->a[i0 + j] * (cos_e[j] - ecc[j]);
+         y[j] = kb->b[i0 + j] * sin_e[j];
+         }
+      for( j = 0; j < n_in_block; j++)
+         {
+         double *lptr = loc + (block_start + j) * 4;
+
+         for( i = 0; i < 3; i++)
+            lptr[i] = kb->perih_vec[i][i0 + j] * x[j]
+                    + kb->sideways[i][i0 + j] * y[j];
+         lptr[3] = kb->a[i0 + j] * (1. - ecc[j] * cos_e[j]);
+         }
+      if( vel)
+         for( j = 0; j < n_in_block; j++)
+            {
+            const double e_dot = 1. / (kb->t0[i0 + j]
+                                     * (1. - ecc[j] * cos_e[j]));
+            const double vx = -kb->a[i0 + j] * sin_e[j] * e_dot;
+            const double vy =  kb->b[i0 + j] * cos_e[j] * e_dot;
+            double *vptr = vel + (block_start + j) * 3;
+
+            for( i = 0; i < 3; i++)
+               vptr[i] = kb->perih_vec[i][i0 + j] * vx
+                       + kb->sideways[i][i0 + j] * vy;
+            }
+               /* Objects the block code can't handle are overwritten : */
+      for( j = 0; j < n_in_block; j++)
+         if( kb->use_scalar[i0 + j])
+            {
+            ELEMENTS elem;
+
+            memcpy( &elem, kb->elems + (size_t)( i0 + j) * kb->elem_stride,
+                                    sizeof( ELEMENTS));
+            comet_posn_and_vel( &elem, t[block_start + j],
+                     loc + (block_start + j) * 4,
+                     (vel ? vel + (block_start + j) * 3 : NULL));
+            }
+      }
+}
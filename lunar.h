@@ -45,16 +45,64 @@ double DLL_FUNC lunar_lat( const void FAR *data, const double DLLPTR *fund,
                                            const long precision);
 int DLL_FUNC lunar_lon_and_dist( const void FAR *data, const double DLLPTR *fund,
                  double DLLPTR *lon, double DLLPTR *r, const long precision);
+void * DLL_FUNC load_lunar_table( const void FAR *data);
+int DLL_FUNC unload_lunar_table( void *lunar_table);
+int DLL_FUNC get_lunar_table_loc( const void *lunar_table,
+                  const double DLLPTR *fund, double *lon, double *lat,
+                  double *r, const long precision);
 
 int DLL_FUNC unload_ps1996_series( void *p);
 int DLL_FUNC get_ps1996_position( const double jd, const void *iptr,
                         double *state_vect, const int compute_velocity);
+int DLL_FUNC get_ps1996_positions( const void *iptr, const double jd0,
+            const double step, const int n_times, double *state_vects,
+            const int compute_velocity);
+int DLL_FUNC unload_ps1996_file( void *ps1996_file);
+int DLL_FUNC get_ps1996_state( void *ps1996_file, const int planet_no,
+            const double jd, double *state_vect, const int compute_velocity);
+int DLL_FUNC get_ps1996_states( void *ps1996_file, const int planet_no,
+            const double jd0, const double step, const int n_times,
+            double *state_vects, const int compute_velocity);
+int DLL_FUNC unload_elp82_data( void *p);
+int DLL_FUNC get_elp82_position( const void *elp_data, const double t_cen,
+                        double *ecliptic_xyz_2000);
+
+         /* 'flags' for load_big_vsop_data( ) : */
+#define BIG_VSOP_FAST_TRIG        1
+
+int DLL_FUNC unload_big_vsop_data( void *big_vsop_data);
+int DLL_FUNC get_big_vsop_loc( const void *big_vsop_data, const int planet,
+                  const double t_cen, double *ovals, double *ovals_rates);
+void DLL_FUNC fast_cos_sin( const double *angle, double *cos_angle,
+                                    double *sin_angle, const int n);
+         /* Position source for make_cheby_ephem( ) (see 'cheb_eph.cpp') */
+typedef int (*cheby_source_t)( void *context, const int body_id,
+                        const double jd, double *xyz);
+
+int DLL_FUNC unload_cheby_ephem( void *ephem);
+int DLL_FUNC get_cheby_ephem_info( const void *ephem, const int idx,
+                  int *body_id, char *name, double *info);
+int DLL_FUNC get_cheby_ephem_state( const void *ephem, const int body_id,
+            const double jd, double *state_vect, const int compute_velocity);
 #ifdef SEEK_CUR
 void * DLL_FUNC load_ps1996_series( FILE *ifile, double jd, int planet_no);
+void * DLL_FUNC load_ps1996_file( FILE *ifile, int n_cached_blocks);
 int DLL_FUNC compute_elp_xyz( FILE *ifile, const double t_cen, const double prec,
                      double *ecliptic_xyz_2000);
+void * DLL_FUNC load_elp82_data( FILE *ifile, const double prec);
 int DLL_FUNC calc_big_vsop_loc( FILE *ifile, const int planet,
                       double *ovals, double t, const double prec0);
+void * DLL_FUNC load_big_vsop_data( FILE *ifile, const double prec,
+                                        const int flags);
+char * DLL_FUNC map_file_for_reading( FILE *ifile, const size_t min_size,
+                                    size_t *size);
+void DLL_FUNC unmap_file_data( char *data, const size_t size);
+void * DLL_FUNC load_cheby_ephem( FILE *ifile);
+int DLL_FUNC make_cheby_ephem( FILE *ofile, cheby_source_t source,
+            void *context, const int n_bodies, const int *body_ids,
+            const char **names, const char *description,
+            const double jd_start, const double jd_end,
+            const int n_coeffs, const double tolerance);
 #endif
 
 int DLL_FUNC lunar_fundamentals( const void FAR *data, const double t,
@@ -71,10 +119,38 @@ int DLL_FUNC calc_ssat_loc( const double t, double DLLPTR *ssat,
 void DLL_FUNC calc_triton_loc( const double jd, double *vect);
 double DLL_FUNC calc_vsop_loc( const void FAR *data, const int planet,
                           const int value, double t, double prec);
+void * DLL_FUNC load_vsop_table( const void FAR *data);
+int DLL_FUNC unload_vsop_table( void *table);
+int DLL_FUNC calc_vsop_locs( const void *vsop_table, const int planet,
+                  const double t0, const double dt, const int n_times,
+                  double *lbr, double *lbr_rates);
 int DLL_FUNC nutation( const double t, double DLLPTR *d_lon,
                                        double DLLPTR *d_obliq);
+void * DLL_FUNC make_nutation_cache( const double t_start, const double t_end,
+                     double step_in_days, double *max_error);
+int DLL_FUNC free_nutation_cache( void *cache);
+int DLL_FUNC cached_nutation( const void *cache, const double t,
+                         double DLLPTR *d_lon, double DLLPTR *d_obliq);
+int DLL_FUNC nutations( const void *cache, const int n_times,
+            const double *t, double DLLPTR *d_lon, double DLLPTR *d_obliq);
 int DLL_FUNC compute_planet( const char FAR *vsop_data, const int planet_no,
             const double t_c, double DLLPTR *ovals);
+
+         /* 'frames' bits for compute_planet_frames( ) and compute_planets( ),
+            giving the slots of 'ovals' each fills in : */
+#define PLANET_POLAR_OF_DATE         0x01      /* ovals[0-2]   */
+#define PLANET_ECLIPTIC_OF_DATE      0x02      /* ovals[3-5]   */
+#define PLANET_EQUATORIAL_OF_DATE    0x04      /* ovals[6-8]   */
+#define PLANET_EQUATORIAL_J2000      0x08      /* ovals[9-11]  */
+#define PLANET_ECLIPTIC_J2000        0x10      /* ovals[12-14] */
+#define PLANET_ALL_FRAMES            0x1f
+
+int DLL_FUNC compute_planet_frames( const char FAR *vsop_data,
+            const int planet_no, const double t_c, const int frames,
+            const double *precession_matrix, double DLLPTR *ovals);
+int DLL_FUNC compute_planets( const char FAR *vsop_data,
+            const unsigned planet_mask, const double t_c,
+            const int frames, double DLLPTR *ovals);
 int DLL_FUNC calc_planet_orientation( const int planet_no, const int system_no,
                const double jd, double *matrix);
 int DLL_FUNC planet_radii( const int planet_no, double *radii_in_km);
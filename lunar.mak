@@ -4,7 +4,7 @@
 # and which either builds the library as a DLL or statically
 
 EXES= add_off.exe adestest.exe astcheck.exe astephem.exe \
-      calendar.exe chinese.exe colors.exe colors2.exe cosptest.exe csv2ades.exe dist.exe \
+      calendar.exe cheb_gen.exe chinese.exe colors.exe colors2.exe cosptest.exe csv2ades.exe dist.exe \
       easter.exe get_test.exe gtest.exe htc20b.exe jd.exe jevent.exe \
       jpl2b32.exe jsattest.exe lun_test.exe marstime.exe \
       moidtest.exe mpc_time.exe mpc2sof.exe oblitest.exe parallax.exe \
@@ -15,13 +15,13 @@ EXES= add_off.exe adestest.exe astcheck.exe astephem.exe \
 all: $(EXES)
 
 LIB_OBJS= ades2mpc.obj alt_az.obj astfuncs.obj \
-      big_vsop.obj brentmin.obj classel.obj  \
+      big_vsop.obj brentmin.obj cheb_eph.obj classel.obj  \
       com_file.obj conbound.obj cospar.obj date.obj \
       de_plan.obj delta_t.obj dist_pa.obj  \
       elp82dat.obj eop_prec.obj getplane.obj \
-      get_time.obj jsats.obj lunar2.obj  \
+      get_time.obj jsats.obj kepbatch.obj lunar2.obj  \
       miscell.obj mpc_code.obj mpc_fmt.obj moid.obj nanosecs.obj \
-      nutation.obj obliquit.obj pluto.obj precess.obj  \
+      nutation.obj obliquit.obj perturb.obj pluto.obj precess.obj  \
       refract.obj refract4.obj rocks.obj showelem.obj sof.obj \
       snprintf.obj spline.obj ssats.obj \
       unpack.obj triton.obj vislimit.obj vsopson.obj
@@ -65,7 +65,7 @@ clean:
    $(RM) $(LIB_OBJS)
    $(RM) $(EXES)
    $(RM) add_off.obj ades2mpc.obj adestest.obj astcheck.obj
-   $(RM) astephem.obj calendar.obj chinese.obj colors.obj
+   $(RM) astephem.obj calendar.obj cheb_gen.obj chinese.obj colors.obj
    $(RM) colors2.obj csv2ades.obj cosptest.obj dist.obj
    $(RM) eart2000.obj easter.obj get_test.obj gtest.obj
    $(RM) gust86.obj htc20b.obj jd.obj jevent.obj
@@ -95,6 +95,9 @@ astephem.exe: astephem.obj eart2000.obj mpcorb.obj $(LIBNAME).lib
 calendar.exe: calendar.obj $(LIBNAME).lib
    $(LINK)    calendar.obj $(LIBNAME).lib
 
+cheb_gen.exe: cheb_gen.obj gust86.obj $(LIBNAME).lib
+   $(LINK)    cheb_gen.obj gust86.obj $(LIBNAME).lib
+
 chinese.exe: chinese.cpp snprintf.obj
    cl -DTEST_CODE $(BASE_FLAGS) chinese.cpp snprintf.obj
 
@@ -93,82 +93,246 @@ int DLL_FUNC lunar_fundamentals( const void FAR *data, const double t,
    return( 0);
 }
 
-int DLL_FUNC lunar_lon_and_dist( const void FAR *data, const double DLLPTR *fund,
-                 double DLLPTR *lon, double DLLPTR *r, const long precision)
+/* The series are evaluated without calling sin( ) or cos( ) for each
+term.  The sines and cosines of multiples of D, M, M', and F are
+found from those of D, M, M', F themselves with the usual recurrence,
+and each term's argument dD + mM + m'M' + fF is then got by adding
+angles (rotating through the four multiples).  The eccentricity factor
+e^|m| comes from a small table of powers of e,  too.  (In the data,  no
+multiple exceeds four,  and |m| is never more than two.)  */
+
+#define MAX_LUNAR_MULT  6
+
+typedef struct
 {
-   int i, j;
-   const signed char *tptr = (const signed char *)data + LUNAR_LON_DIST_OFFSET;
-   double sl_sum = 0., sr_sum = 0., e;
+   double amplitude[2];       /* lon/dist terms:  sl, sr.  Lat:  sb, 0 */
+   long max_amplitude;
+   signed char mult[4];       /* multiples of D, M, M', F */
+} lunar_term_t;
+
+typedef struct
+{
+   lunar_term_t lon_terms[N_TERMS], lat_terms[N_TERMS];
+} lunar_table_t;
+
+static void decode_lunar_term( lunar_term_t *term, const signed char *tptr,
+                                   const int is_lat)
+{
+   int i;
+
+   for( i = 0; i < 4; i++)
+      {
+      term->mult[i] = tptr[i];
+      assert( abs( tptr[i]) <= MAX_LUNAR_MULT);
+      }
+   term->amplitude[0] = (double)(int32_t)get32bits( tptr + 4);
+   term->amplitude[1] = (is_lat ? 0. : (double)(int32_t)get32bits( tptr + 8));
+   term->max_amplitude = (long)fabs( term->amplitude[0]);
+   if( term->max_amplitude < (long)fabs( term->amplitude[1]))
+      term->max_amplitude = (long)fabs( term->amplitude[1]);
+}
+
+/* Decodes terms whose amplitude exceeds 'precision' into 'terms',  and
+returns the number of such terms. */
 
-   assert( get32bits( tptr) == 0x00010000);
-   e = 1. - .002516 * T - .0000074 * T * T;
-   for( i = N_TERMS; i; i--, tptr += LON_R_TERM_SIZE)
+static int decode_lunar_terms( lunar_term_t *terms, const void FAR *data,
+                  const int is_lat, const long precision)
+{
+   const signed char *tptr = (const signed char FAR *)data +
+                           (is_lat ? LUNAR_LAT_OFFSET : LUNAR_LON_DIST_OFFSET);
+   int i, n_found = 0;
+
+   assert( get32bits( tptr) == (is_lat ? 0x01000000u : 0x00010000u));
+   for( i = 0; i < N_TERMS; i++)
       {
-      const int32_t sl = get32bits( tptr + 4);
-      const int32_t sr = get32bits( tptr + 8);
+      decode_lunar_term( terms + n_found, tptr, is_lat);
+      if( terms[n_found].max_amplitude > precision)
+         n_found++;
+      tptr += (is_lat ? LAT_TERM_SIZE : LON_R_TERM_SIZE);
+      }
+   return( n_found);
+}
+
+typedef struct
+{
+   double cos_mult[4][MAX_LUNAR_MULT + 1], sin_mult[4][MAX_LUNAR_MULT + 1];
+   double e_power[MAX_LUNAR_MULT + 1];
+} lunar_angles_t;
 
-      if( labs( sl) > precision || labs( sr) > precision)
+static void set_lunar_angles( lunar_angles_t *angles, const double DLLPTR *fund)
+{
+   const double e = 1. - .002516 * T - .0000074 * T * T;
+   int i, j;
+
+   for( i = 0; i < 4; i++)
+      {
+      double *c = angles->cos_mult[i], *s = angles->sin_mult[i];
+      c[0] = 1.;
+      s[0] = 0.;
+      c[1] = cos( fund[i + 1]);        /* D, M, M', F */
+      s[1] = sin( fund[i + 1]);
+      for( j = 2; j <= MAX_LUNAR_MULT; j++)
          {
-         double term;
-         const signed char d = tptr[0], m = tptr[1], mp = tptr[2], f = tptr[3];
-         const double arg = (double)d * D + (double)m * M
-                          + (double)mp * Mp + (double)f * F;
+         c[j] = 2. * c[1] * c[j - 1] - c[j - 2];
+         s[j] = 2. * c[1] * s[j - 1] - s[j - 2];
+         }
+      }
+   angles->e_power[0] = 1.;
+   for( j = 1; j <= MAX_LUNAR_MULT; j++)
+      angles->e_power[j] = angles->e_power[j - 1] * e;
+}
 
-         if( sl)
-            {
-            term = (double)sl * sin( arg);
-            for( j = abs( m); j; j--)
-               term *= e;
-            sl_sum += term;
-            }
-         if( sr)
+/* sums[0] += amplitude[0] * sin( arg) * e^|m|,  and likewise,  sums[1]
++= amplitude[1] * cos( arg) * e^|m|.  */
+
+static void sum_lunar_terms( const lunar_term_t *terms, const int n_terms,
+                  const lunar_angles_t *angles, double *sums)
+{
+   int i, j;
+
+   for( i = 0; i < n_terms; i++, terms++)
+      {
+      double cos_arg = 1., sin_arg = 0., scale;
+
+      for( j = 0; j < 4; j++)
+         if( terms->mult[j])
             {
-            term = (double)sr * cos( arg);
-            for( j = abs( m); j; j--)
-               term *= e;
-            sr_sum += term;
+            const int k = abs( terms->mult[j]);
+            const double c = angles->cos_mult[j][k];
+            const double s = (terms->mult[j] > 0 ? angles->sin_mult[j][k]
+                                               : -angles->sin_mult[j][k]);
+            const double new_cos = cos_arg * c - sin_arg * s;
+
+            sin_arg = sin_arg * c + cos_arg * s;
+            cos_arg = new_cos;
             }
-         }
+      scale = angles->e_power[abs( terms->mult[1])];
+      sums[0] += terms->amplitude[0] * sin_arg * scale;
+      sums[1] += terms->amplitude[1] * cos_arg * scale;
       }
+}
+
+static void finish_lon_and_dist( const double DLLPTR *fund, double *sums,
+                 double DLLPTR *lon, double DLLPTR *r, const long precision)
+{
    if( precision < 3959L)
-      sl_sum += 3958. * sin( A1) + 1962. * sin( Lp - F) + 318. * sin( A2);
-   *lon = (Lp * 180. / PI) + sl_sum * 1.e-6;
+      sums[0] += 3958. * sin( A1) + 1962. * sin( Lp - F) + 318. * sin( A2);
+   *lon = (Lp * 180. / PI) + sums[0] * 1.e-6;
    while( *lon < 0.)
       *lon += 360.;
    while( *lon > 360.)
       *lon -= 360.;
-   *r = 385000.56 + sr_sum / 1000.;
+   *r = 385000.56 + sums[1] / 1000.;
+}
+
+static double finish_lat( const double DLLPTR *fund, const double sum,
+                                    const long precision)
+{
+   double rval = sum;
+
+   if( precision < 2236L)
+      rval += -2235. * sin( Lp) + 382. * sin( A3) + 175. * sin( A1 - F) +
+               175. * sin( A1 + F) + 127. * sin(Lp - Mp) - 115. * sin(Lp+Mp);
+   return( rval * 1.e-6);
+}
+
+int DLL_FUNC lunar_lon_and_dist( const void FAR *data, const double DLLPTR *fund,
+                 double DLLPTR *lon, double DLLPTR *r, const long precision)
+{
+   lunar_term_t terms[N_TERMS];
+   lunar_angles_t angles;
+   double sums[2];
+   const int n_terms = decode_lunar_terms( terms, data, 0, precision);
+
+   set_lunar_angles( &angles, fund);
+   sums[0] = sums[1] = 0.;
+   sum_lunar_terms( terms, n_terms, &angles, sums);
+   finish_lon_and_dist( fund, sums, lon, r, precision);
    return( 0);
 }
 
 double DLL_FUNC lunar_lat( const void FAR *data, const double DLLPTR *fund,
                                            const long precision)
 {
-   int i, j;
-   const signed char *tptr = (const signed char FAR *)data + LUNAR_LAT_OFFSET;
-   double rval = 0., e;
+   lunar_term_t terms[N_TERMS];
+   lunar_angles_t angles;
+   double sums[2];
+   const int n_terms = decode_lunar_terms( terms, data, 1, precision);
 
-   assert( get32bits( tptr) == 0x01000000);
-   e = 1. - .002516 * T - .0000074 * T * T;
-   for( i = N_TERMS; i; i--, tptr += LAT_TERM_SIZE)
-      {
-      const int32_t sb = get32bits( tptr + 4);
+   set_lunar_angles( &angles, fund);
+   sums[0] = sums[1] = 0.;
+   sum_lunar_terms( terms, n_terms, &angles, sums);
+   return( finish_lat( fund, sums[0], precision));
+}
 
-      if( labs( sb) > precision)
-         {
-         double term;
-         const signed char d = tptr[0], m = tptr[1], mp = tptr[2], f = tptr[3];
-         const double arg = (double)d * D + (double)m * M
-                          + (double)mp * Mp + (double)f * F;
-
-         term = (double)sb * sin( arg);
-         for( j = abs( m); j; j--)
-            term *= e;
-         rval += term;
-         }
+/* If you're computing many lunar positions,  it's a little faster still
+to decode the terms once with load_lunar_table( ),  then call
+get_lunar_table_loc( ) for each position,  getting longitude,  latitude,
+and distance at once (and computing the multiple angles only once.)  In
+the table,  the terms are sorted by decreasing amplitude,  so that the
+terms to be used for a given 'precision' are just the first few.  The
+table is only read from after loading,  so it can be shared between
+threads.  Free it with unload_lunar_table( ).  */
+
+static int compare_lunar_terms( const void *a, const void *b)
+{
+   const long amp_a = ((const lunar_term_t *)a)->max_amplitude;
+   const long amp_b = ((const lunar_term_t *)b)->max_amplitude;
+
+   return( amp_a > amp_b ? -1 : (amp_a < amp_b ? 1 : 0));
+}
+
+void * DLL_FUNC load_lunar_table( const void FAR *data)
+{
+   lunar_table_t *rval = (lunar_table_t *)malloc( sizeof( lunar_table_t));
+
+   if( rval)
+      {
+      decode_lunar_terms( rval->lon_terms, data, 0, -1L);
+      decode_lunar_terms( rval->lat_terms, data, 1, -1L);
+      qsort( rval->lon_terms, N_TERMS, sizeof( lunar_term_t),
+                                 compare_lunar_terms);
+      qsort( rval->lat_terms, N_TERMS, sizeof( lunar_term_t),
+                                 compare_lunar_terms);
       }
-   if( precision < 2236L)
-      rval += -2235. * sin( Lp) + 382. * sin( A3) + 175. * sin( A1 - F) +
-               175. * sin( A1 + F) + 127. * sin(Lp - Mp) - 115. * sin(Lp+Mp);
-   return( rval * 1.e-6);
+   return( rval);
+}
+
+int DLL_FUNC unload_lunar_table( void *lunar_table)
+{
+   free( lunar_table);
+   return( 0);
+}
+
+static int n_lunar_terms_needed( const lunar_term_t *terms, const long precision)
+{
+   int n = 0;
+
+   while( n < N_TERMS && terms[n].max_amplitude > precision)
+      n++;
+   return( n);
+}
+
+/* Given fundamental arguments from lunar_fundamentals( ),  gets the same
+longitude and latitude (in degrees) and distance (in km) as do
+lunar_lon_and_dist( ) and lunar_lat( ).  */
+
+int DLL_FUNC get_lunar_table_loc( const void *lunar_table,
+                  const double DLLPTR *fund, double *lon, double *lat,
+                  double *r, const long precision)
+{
+   const lunar_table_t *table = (const lunar_table_t *)lunar_table;
+   lunar_angles_t angles;
+   double sums[2];
+
+   set_lunar_angles( &angles, fund);
+   sums[0] = sums[1] = 0.;
+   sum_lunar_terms( table->lon_terms,
+               n_lunar_terms_needed( table->lon_terms, precision), &angles, sums);
+   finish_lon_and_dist( fund, sums, lon, r, precision);
+   sums[0] = sums[1] = 0.;
+   sum_lunar_terms( table->lat_terms,
+               n_lunar_terms_needed( table->lat_terms, precision), &angles, sums);
+   *lat = finish_lat( fund, sums[0], precision);
+   return( 0);
 }
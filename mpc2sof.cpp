@@ -13,7 +13,10 @@ unified format.
 The asteroid elements can be in either 'mpcorb.dat' or 'MPCORB.DAT'.  For
 Find_Orb,  the file should be placed in ~./find_orb.   I'll make sure that
 other programs using this file (astcheck,  for example) look in that
-directory as well.  */
+directory as well.
+
+   A 'compiled' binary version of the SOF file,  'mpcorb.sof.bin',  is also
+written.  See sof.cpp for details.  */
 
 #include <stdio.h>
 #include <string.h>
@@ -219,6 +222,17 @@ int main( const int argc, const char **argv)
    n_written = fwrite( obuff, reclen, n_out, ofile);
    assert( n_written == n_out);
    free( obuff);
+   fclose( ofile);
+            /* Also write out the 'compiled' version (see sof.cpp) that */
+            /* astcheck and friends can map into memory :               */
+   ifile = err_fopen( "mpcorb.sof", "rb");
+   ofile = err_fopen( "mpcorb.sof.bin", "wb");
+   if( write_compiled_sof( ofile, ifile) != (int)n_out)
+      {
+      fprintf( stderr, "Failed to write 'mpcorb.sof.bin'\n");
+      return( -3);
+      }
+   fclose( ifile);
    fclose( ofile);
    return( 0);
 }
@@ -22,9 +22,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 #include <stdio.h>
 #include <ctype.h>
 #include <time.h>
+#include <stdint.h>
+#include <limits.h>
 #include "watdefs.h"
 #include "mpc_func.h"
 #include "lunar.h"
+#include "afuncs.h"
 #include "stringex.h"
 
 #define SUN_RADIUS          695700e+3
@@ -658,6 +661,352 @@ int get_xxx_location_info( mpc_code_t *cinfo, const char *buff)
    return( rval);
 }
 
+/* Programs reducing large batches of astrometry may need the positions
+of hundreds of stations,  thousands of times over.  Scanning ObsCodes.html
+and parsing the line for each of those lookups gets slow.  Instead,  one
+can load ObsCodes.html,  'rovers.txt',  or similar files into a registry,
+parsing each line once (so that lat/lon/alt and parallax constants are
+computed once),  and then look codes up in a hash table.
+
+   Files are read in their entirety,  and the text kept so that the
+'name' pointers in the mpc_code_t structs stay valid.  Lines are null-
+terminated in place,  so names don't end with CR/LF.  If a code appears
+more than once,  the first instance wins,  so add files in order of
+preference.  Pointers returned by find_mpc_code( ) are valid until the
+registry is freed or another file is added to it.  Once loaded,  the
+registry is read-only,  and lookups can be done from several threads. */
+
+typedef struct
+{
+   mpc_code_t *codes;
+   uint32_t *keys;
+   int n_codes, n_alloced;
+   int *table;             /* index into codes[] plus one;  zero = empty */
+   unsigned table_bits;
+   char **texts;
+   int n_texts;
+} mpc_code_registry_t;
+
+/* Three-character codes get a space as the fourth byte.  */
+
+static uint32_t mpc_code_key( const char *code)
+{
+   uint32_t rval = 0;
+   int i;
+
+   for( i = 0; i < 4; i++)
+      rval = (rval << 8) | (uint32_t)(unsigned char)
+                  ((i < 3 || (unsigned char)code[3] > ' ') ? code[i] : ' ');
+   return( rval);
+}
+
+static unsigned mpc_code_hash( const uint32_t key, const unsigned table_bits)
+{
+   return( (unsigned)( (key * 2654435761u) >> (32 - table_bits)));
+}
+
+static int find_mpc_code_index( const mpc_code_registry_t *reg,
+                                const uint32_t key)
+{
+   const unsigned mask = (1u << reg->table_bits) - 1;
+   unsigned loc;
+
+   if( !reg->table)
+      return( -1);
+   loc = mpc_code_hash( key, reg->table_bits);
+   while( reg->table[loc])
+      {
+      if( reg->keys[reg->table[loc] - 1] == key)
+         return( reg->table[loc] - 1);
+      loc = (loc + 1) & mask;
+      }
+   return( -1);
+}
+
+static int rebuild_mpc_code_table( mpc_code_registry_t *reg)
+{
+   int i;
+
+   reg->table_bits = 8;
+   while( (1 << reg->table_bits) < 2 * reg->n_codes)
+      reg->table_bits++;
+   free( reg->table);
+   reg->table = (int *)calloc( (size_t)1 << reg->table_bits, sizeof( int));
+   if( !reg->table)
+      return( -1);
+   for( i = 0; i < reg->n_codes; i++)
+      {
+      const unsigned mask = (1u << reg->table_bits) - 1;
+      unsigned loc = mpc_code_hash( reg->keys[i], reg->table_bits);
+
+      while( reg->table[loc])
+         loc = (loc + 1) & mask;
+      reg->table[loc] = i + 1;
+      }
+   return( 0);
+}
+
+void *init_mpc_code_registry( void)
+{
+   return( calloc( 1, sizeof( mpc_code_registry_t)));
+}
+
+/* Returns the number of codes added from 'ifile',  or -1 if memory
+ran out.   */
+
+int add_mpc_codes_to_registry( void *registry, FILE *ifile)
+{
+   mpc_code_registry_t *reg = (mpc_code_registry_t *)registry;
+   size_t len = 0, alloced = 0, bytes_read;
+   char *text = NULL, *line, **new_texts;
+   int n_added = 0;
+
+   do
+      {
+      if( len + 65536 > alloced)
+         {
+         char *new_text;
+
+         alloced = 2 * alloced + 65536;
+         new_text = (char *)realloc( text, alloced + 1);
+         if( !new_text)
+            {
+            free( text);
+            return( -1);
+            }
+         text = new_text;
+         }
+      bytes_read = fread( text + len, 1, alloced - len, ifile);
+      len += bytes_read;
+      }
+      while( bytes_read);
+   text[len] = '\0';
+   new_texts = (char **)realloc( reg->texts, (reg->n_texts + 1) * sizeof( char *));
+   if( !new_texts)
+      {
+      free( text);
+      return( -1);
+      }
+   reg->texts = new_texts;
+   reg->texts[reg->n_texts++] = text;
+   line = text;
+   while( *line)
+      {
+      char *eol = strchr( line, '\n'), *next_line;
+      mpc_code_t cinfo;
+
+      if( eol)
+         next_line = eol + 1;
+      else
+         next_line = eol = line + strlen( line);
+      while( eol > line && (eol[-1] == 13 || eol[-1] == 10))
+         eol--;
+      *eol = '\0';
+      if( get_mpc_code_info( &cinfo, line) != -1
+               && find_mpc_code_index( reg, mpc_code_key( cinfo.code)) < 0)
+         {
+         int i;
+
+         for( i = reg->n_codes - n_added; i < reg->n_codes; i++)
+            if( reg->keys[i] == mpc_code_key( cinfo.code))
+               break;
+         if( i == reg->n_codes)        /* not a duplicate within this file */
+            {
+            if( reg->n_codes == reg->n_alloced)
+               {
+               const int new_size = 2 * reg->n_alloced + 1000;
+               mpc_code_t *new_codes = (mpc_code_t *)realloc( reg->codes,
+                                    new_size * sizeof( mpc_code_t));
+               uint32_t *new_keys;
+
+               if( !new_codes)
+                  return( -1);
+               reg->codes = new_codes;
+               new_keys = (uint32_t *)realloc( reg->keys,
+                                    new_size * sizeof( uint32_t));
+               if( !new_keys)
+                  return( -1);
+               reg->keys = new_keys;
+               reg->n_alloced = new_size;
+               }
+            reg->codes[reg->n_codes] = cinfo;
+            reg->keys[reg->n_codes] = mpc_code_key( cinfo.code);
+            reg->n_codes++;
+            n_added++;
+            }
+         }
+      line = next_line;
+      }
+   return( rebuild_mpc_code_table( reg) ? -1 : n_added);
+}
+
+/* 'code' can be three or four characters,  and needn't be null-terminated
+if it's followed by a space (as in the 80-column format.)  */
+
+const mpc_code_t *find_mpc_code( const void *registry, const char *code)
+{
+   const mpc_code_registry_t *reg = (const mpc_code_registry_t *)registry;
+   const int idx = find_mpc_code_index( reg, mpc_code_key( code));
+
+   return( idx >= 0 ? reg->codes + idx : NULL);
+}
+
+void free_mpc_code_registry( void *registry)
+{
+   mpc_code_registry_t *reg = (mpc_code_registry_t *)registry;
+   int i;
+
+   for( i = 0; i < reg->n_texts; i++)
+      free( reg->texts[i]);
+   free( reg->texts);
+   free( reg->codes);
+   free( reg->keys);
+   free( reg->table);
+   free( reg);
+}
+
+/* Computes the geocentric position of an Earth-based station at each of
+'n_times' UT times,  in the equatorial frame of date,  in units of the
+earth's equatorial radius (i.e.,  the same units as rho_cos_phi and
+rho_sin_phi),  three values per time.  The station's longitude enters
+only through its sine and cosine,  which are found once per call;  so
+there's one cos/sin pair per time,  for the sidereal time.  Returns -1
+(leaving 'offsets' alone) for stations not on the earth.  */
+
+int compute_topocentric_offsets( const mpc_code_t *station,
+         const size_t n_times, const double *jd_ut, double *offsets)
+{
+   const double cos_lon = cos( station->lon), sin_lon = sin( station->lon);
+   size_t i;
+
+   if( station->planet != 3)
+      return( -1);
+   for( i = 0; i < n_times; i++, offsets += 3)
+      {
+      const double gst = green_sidereal_time( jd_ut[i]);
+      const double cos_gst = cos( gst), sin_gst = sin( gst);
+
+      offsets[0] = station->rho_cos_phi * (cos_lon * cos_gst - sin_lon * sin_gst);
+      offsets[1] = station->rho_cos_phi * (sin_lon * cos_gst + cos_lon * sin_gst);
+      offsets[2] = station->rho_sin_phi;
+      }
+   return( 0);
+}
+
+/* compute_observer_vectors( ) goes a step further,  giving geocentric
+J2000 equatorial positions (AU) and,  optionally,  velocities (AU/day)
+for a station at an array of UTC times.  The precession-nutation matrix
+is the expensive part.  It changes slowly,  so the 'locator' keeps
+matrices on an hourly grid (in TT) and interpolates them with the same
+four-point scheme used by interpolated_precession( ),  good to about
+5e-15 radian.  Grid matrices are computed as needed and remembered in a
+small ring,  so a run of observations within a few hours of each other
+costs one sidereal time,  one cos/sin pair and a 3x3 interpolation apiece.
+(The sidereal time is a short polynomial and is just evaluated for each
+time;  see compute_topocentric_offsets( ).)
+
+   Velocities are those due to the earth's rotation;  the slow change
+in the matrix is ignored.  UT1 is taken to equal UTC,  and TT-UTC is
+found once per call,  which is fine unless a call spans decades.
+
+   A locator is modified as it's used,  so each thread should have its
+own.  Nothing else here keeps state (setup_precession_with_nutation( )'s
+matrix cache is per-thread,  and mean_obliquity( ) and nutation( ) have
+none),  so threads with their own locators needn't serialize calls.  */
+
+#define N_LOCATOR_SLOTS     16
+#define LOCATOR_STEP        (1. / 24.)
+
+typedef struct
+{
+   long grid_idx[N_LOCATOR_SLOTS];
+   double matrix[N_LOCATOR_SLOTS][9];
+} observer_locator_t;
+
+void *init_observer_locator( void)
+{
+   observer_locator_t *rval =
+               (observer_locator_t *)malloc( sizeof( observer_locator_t));
+
+   if( rval)
+      {
+      int i;
+
+      for( i = 0; i < N_LOCATOR_SLOTS; i++)
+         rval->grid_idx[i] = LONG_MIN;
+      }
+   return( rval);
+}
+
+void free_observer_locator( void *locator)
+{
+   free( locator);
+}
+
+static const double *locator_matrix( observer_locator_t *loc, const long idx)
+{
+   const int slot = (int)( idx & (N_LOCATOR_SLOTS - 1));
+
+   if( loc->grid_idx[slot] != idx)
+      {
+      const double jd_tt = (double)idx * LOCATOR_STEP;
+
+      setup_precession_with_nutation( loc->matrix[slot],
+                               2000. + (jd_tt - 2451545.) / 365.25);
+      loc->grid_idx[slot] = idx;
+      }
+   return( loc->matrix[slot]);
+}
+
+/* Returns -1 for stations not on the earth,  0 otherwise.  'vels' can
+be NULL if velocities aren't wanted.  */
+
+int compute_observer_vectors( void *locator, const mpc_code_t *station,
+         const size_t n_times, const double *jd_utc,
+         double *posns, double *vels)
+{
+   observer_locator_t *loc = (observer_locator_t *)locator;
+   const double scale = EARTH_MAJOR_AXIS / AU_IN_METERS;
+   const double omega = 360.98564736629 * PI / 180.;  /* radians/UT day */
+   double tt_minus_utc;
+   size_t i;
+
+   if( compute_topocentric_offsets( station, n_times, jd_utc, posns))
+      return( -1);
+   if( !n_times)
+      return( 0);
+   tt_minus_utc = td_minus_utc( jd_utc[0]) / seconds_per_day;
+   for( i = 0; i < n_times; i++, posns += 3)
+      {
+      double p = (jd_utc[i] + tt_minus_utc) / LOCATOR_STEP;
+      const long idx = (long)floor( p) - 1;
+      const double *m0 = locator_matrix( loc, idx);
+      const double *m1 = locator_matrix( loc, idx + 1);
+      const double *m2 = locator_matrix( loc, idx + 2);
+      const double *m3 = locator_matrix( loc, idx + 3);
+      double w[4], matrix[9], vect[3];
+      int j;
+
+      p -= (double)( idx + 1);       /* now 0 <= p < 1 */
+      w[0] = -p * (p - 1.) * (p - 2.) / 6.;
+      w[1] = (p + 1.) * (p - 1.) * (p - 2.) / 2.;
+      w[2] = -(p + 1.) * p * (p - 2.) / 2.;
+      w[3] = (p + 1.) * p * (p - 1.) / 6.;
+      for( j = 0; j < 9; j++)
+         matrix[j] = w[0] * m0[j] + w[1] * m1[j] + w[2] * m2[j] + w[3] * m3[j];
+      for( j = 0; j < 3; j++)
+         vect[j] = posns[j] * scale;
+      deprecess_vector( matrix, vect, posns);
+      if( vels)
+         {
+         const double vel_of_date[3] = { -vect[1] * omega, vect[0] * omega, 0. };
+
+         deprecess_vector( matrix, vel_of_date, vels + i * 3);
+         }
+      }
+   return( 0);
+}
+
 #ifdef TEST_CODE
 
 static int text_search_and_replace( char *str, const char *oldstr,
@@ -160,14 +160,14 @@ extra 86401st second in a day.)
        1    2013 02 13.1          (MPC's expected format, 10^-1 day)
        0    2013 02 13.           (MPC's expected format, 10^-0 day) */
 
-double extract_date_from_mpc_report( const char *buff, unsigned *format)
+static double extract_date( const char *buff, const size_t len,
+                                          unsigned *format)
 {
    double rval = 0.;
    int year = 0, month = 0;
    size_t start_of_decimals = 0;
    unsigned format_found = 0;
    char tbuff[18];
-   const size_t len = strlen( buff);
    unsigned i, bit, digits_mask = 0;
 
    if( len < 80 || len > 82)       /* check for correct length */
@@ -283,6 +283,11 @@ double extract_date_from_mpc_report( const char *buff, unsigned *format)
    return( rval);
 }
 
+double extract_date_from_mpc_report( const char *buff, unsigned *format)
+{
+   return( extract_date( buff, strlen( buff), format));
+}
+
 /* get_ra_dec() looks at an RA or dec from an MPC report and returns
 its precision.  It interprets the formats used by MPC,  plus a lot of
 "extended" formats that can be useful if your input data is in other
@@ -463,6 +468,90 @@ int get_ra_dec_from_mpc_report( const char *ibuff,
    return( rval);
 }
 
+/* Astrometry files can run to millions of lines,  and some programs
+(astcheck,  for one) used to parse each line several times over : once
+to see if it was valid astrometry,  again to get the date and RA/dec,
+and yet again when looking for pairs of observations to get motions.
+parse_mpc_obs_buffer( ) goes through a buffer of 80-column lines (often a
+memory-mapped file) once,  making an array of mpc_obs_t records in one
+allocation.  The records point back to their lines in the buffer rather
+than copying them,  so the buffer must stay around while they're used.
+Lines that aren't valid 80-column astrometry are skipped.
+
+   The station code is also stored as an integer (see mpc_code_to_int( ))
+so that comparing stations is just an integer comparison.  */
+
+int mpc_code_to_int( const char *mpc_code)
+{
+   return( ((int)(unsigned char)mpc_code[0] << 16)
+         | ((int)(unsigned char)mpc_code[1] << 8)
+         |  (int)(unsigned char)mpc_code[2]);
+}
+
+/* Parses one line,  'len' bytes long (not counting any CR/LF at the end),
+which needn't be null-terminated.  Returns 0 if it's valid astrometry,
+-1 if the RA is bad,  -2 if the dec is bad,  -3 if both are,  -4 if the
+date is bad or the line is of the wrong length.  */
+
+int parse_mpc_obs_line( const char *line, size_t len, mpc_obs_t *obs)
+{
+   int rval = 0;
+   double prec;
+
+   while( len && (line[len - 1] == 10 || line[len - 1] == 13))
+      len--;
+   if( len < 80 || len > 82)
+      return( -4);
+   obs->jd = extract_date( line, len, &obs->time_format);
+   if( !obs->jd)
+      return( -4);
+   obs->ra = get_ra_dec( line + 32, &obs->ra_format, &prec) * (PI / 12.);
+   obs->ra_precision = prec * 15.;
+   if( obs->ra_format == BAD_RA_DEC_FMT)
+      rval = -1;
+   obs->dec = get_ra_dec( line + 44, &obs->dec_format, &prec) * (PI / 180.);
+   obs->dec_precision = prec;
+   if( obs->dec_format == BAD_RA_DEC_FMT)
+      rval -= 2;
+   obs->line = line;
+   obs->station = mpc_code_to_int( line + 77);
+   memcpy( obs->desig, line, 12);
+   return( rval);
+}
+
+/* Returns a malloc()ed array of the valid observations in 'buff',  in
+the order in which they appear,  setting *n_obs to the number found.
+Returns NULL if memory runs out.  */
+
+mpc_obs_t *parse_mpc_obs_buffer( const char *buff, const size_t size,
+                                          int *n_obs)
+{
+   const char *end = buff + size, *tptr = buff;
+   size_t n_lines = 1;
+   mpc_obs_t *rval;
+
+   while( (tptr = (const char *)memchr( tptr, '\n', end - tptr)) != NULL)
+      {
+      tptr++;
+      n_lines++;
+      }
+   *n_obs = 0;
+   rval = (mpc_obs_t *)malloc( n_lines * sizeof( mpc_obs_t));
+   if( !rval)
+      return( NULL);
+   while( buff < end)
+      {
+      const char *eol = (const char *)memchr( buff, '\n', end - buff);
+
+      if( !eol)
+         eol = end;
+      if( !parse_mpc_obs_line( buff, eol - buff, rval + *n_obs))
+         (*n_obs)++;
+      buff = eol + 1;
+      }
+   return( rval);
+}
+
 static const char *net_codes[] = {
     /* http://www.minorplanetcenter.net/iau/info/CatalogueCodes.html
          G. V. Williams, 2012, ``Minor Planet Astrophotometry'', PhD
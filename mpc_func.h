@@ -28,6 +28,23 @@ int get_ra_dec_from_mpc_report( const char *ibuff,    /* mpc_fmt.cpp */
                        int *ra_format, double *ra, double *ra_precision,
                        int *dec_format, double *dec, double *dec_precision);
 
+typedef struct
+{
+   double jd;                       /* UTC */
+   double ra, dec;                  /* in radians */
+   double ra_precision, dec_precision;       /* in arcseconds */
+   const char *line;                /* points into the buffer parsed */
+   int station;                     /* mpc_code_to_int( ) of columns 78-80 */
+   int ra_format, dec_format;
+   unsigned time_format;
+   char desig[12];                  /* columns 1-12;  NOT null-terminated */
+} mpc_obs_t;
+
+int mpc_code_to_int( const char *mpc_code);           /* mpc_fmt.cpp */
+int parse_mpc_obs_line( const char *line, size_t len, mpc_obs_t *obs);
+mpc_obs_t *parse_mpc_obs_buffer( const char *buff, const size_t size,
+                                          int *n_obs);
+
 char net_name_to_byte_code( const char *net_name);
 const char *byte_code_to_net_name( const char byte_code);
 int extract_region_data_for_lat_lon( FILE *ifile, char *buff,
@@ -50,6 +67,17 @@ typedef struct
 int get_mpc_code_info( mpc_code_t *cinfo, const char *buff);
 int get_xxx_location_info( mpc_code_t *cinfo, const char *buff);
 int get_lat_lon_info( mpc_code_t *cinfo, const char *buff);
+void *init_mpc_code_registry( void);
+int add_mpc_codes_to_registry( void *registry, FILE *ifile);
+const mpc_code_t *find_mpc_code( const void *registry, const char *code);
+void free_mpc_code_registry( void *registry);
+int compute_topocentric_offsets( const mpc_code_t *station,
+         const size_t n_times, const double *jd_ut, double *offsets);
+void *init_observer_locator( void);
+int compute_observer_vectors( void *locator, const mpc_code_t *station,
+         const size_t n_times, const double *jd_utc,
+         double *posns, double *vels);
+void free_observer_locator( void *locator);
 double point_to_ellipse( const double a, const double b,
                          const double x, const double y, double *dist);
 int lat_alt_to_parallax( const double lat, const double ht_in_meters,
@@ -64,6 +92,32 @@ int xlate_ades2mpc_in_place( void *context, char *buff);
 int free_ades2mpc_context( void *context);
 int fgets_with_ades_xlation( char *buff, const size_t len,
                                       void *ades_context, FILE *ifile);
+int xlate_ades2mpc_buffer( void *context, const char *ibuff, size_t ilen,
+                        char **obuff, size_t *olen, size_t *oalloced);
+int psv_header_field_count( const char *line, const size_t len);
+
+typedef struct
+{
+   long double t2k;           /* UTC, days from J2000 = JD 2451545.0 */
+   double jd;                 /* UTC;  t2k above is more precise */
+   double ra, dec;            /* decimal degrees */
+   double rms_ra, rms_dec, rms_corr;      /* arcseconds;  zero if not given */
+   double mag, rms_mag, rms_time;         /* rms_time is in seconds */
+   double pos[3];             /* for spacecraft/roving observers;  see sys */
+   char perm_id[24], prov_id[24], art_sat[24], trk_sub[16];
+   char obs_id[40], trk_id[16];
+   char stn[8], mode[4], band[4], ast_cat[16], notes[8];
+   char sys[12], ctr[12];
+   char disc;
+} ades_obs_t;
+
+typedef int (*ades_obs_callback_t)( void *user_data, const ades_obs_t *obs);
+
+void *init_ades_reader( ades_obs_callback_t callback, void *user_data);
+int ades_reader_feed( void *reader, const char *buff, size_t len);
+long free_ades_reader( void *reader);
+long read_ades_file( FILE *ifile, ades_obs_callback_t callback,
+                                             void *user_data);
 int mutant_hex_char_to_int( const char c);
 char int_to_mutant_hex_char( const int ival);
 int get_mutant_hex_value( const char *buff, size_t n_digits);
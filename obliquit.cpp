@@ -34,16 +34,18 @@ integrated values from a file due to Laskar.   */
           /* input is time in julian centuries from 2000. */
           /* rval is mean obliq. (epsilon sub 0) in radians */
           /* Valid range is the years -8000 to +12000 (t = -100 to 100) */
+          /* There used to be a one-entry cache of the previous result  */
+          /* here;  it saved little (ten multiply-adds) and made this   */
+          /* function unsafe to call from more than one thread.         */
 
 double DLL_FUNC mean_obliquity( const double t_cen)
 {
-   double u, u0;
+   double u, u0, rval;
    unsigned i;
    const double obliquit_minus_100_cen = 24.232841111 * PI / 180.;
    const double obliquit_plus_100_cen =  22.611485556 * PI / 180.;
-   static double j2000_obliquit = 23. * 3600. + 26. * 60. + 21.448;
-   static double t0 = 30000., rval;
-   static long coeffs[10] = { -468093L, -155L, 199925L, -5138L,
+   static const double j2000_obliquit = 23. * 3600. + 26. * 60. + 21.448;
+   static const long coeffs[10] = { -468093L, -155L, 199925L, -5138L,
             -24967L, -3905L, 712L, 2787L, 579L, 245L };
 
    if( t_cen == 0.)      /* common J2000 case;  don't do any math */
@@ -55,11 +57,7 @@ double DLL_FUNC mean_obliquity( const double t_cen)
       return( obliquit_minus_100_cen);
 #endif
 
-   if( t0 == t_cen)    /* return previous answer */
-      return( rval);
-
    rval = j2000_obliquit;
-   t0 = t_cen;
    u = u0 = t_cen / 100.;     /* u is in julian 10000's of years */
    for( i = 0; i < 10; i++, u *= u0)
       rval += u * (double)coeffs[i] / 100.;
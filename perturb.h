@@ -0,0 +1,107 @@
+/* perturb.h: header file for numerical integration of asteroid orbits
+Copyright (C) 2026, Project Pluto
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+02110-1301, USA.    */
+
+/* Include 'comets.h' (for ELEMENTS) before this.  See 'perturb.cpp' for
+details,  and 'integrat.cpp' for an example of use.  */
+
+#ifndef PERTURB_H_INCLUDED
+#define PERTURB_H_INCLUDED
+
+#define PERTURBERS_MERCURY_TO_NEPTUNE 0xff
+#define PERTURBERS_PLUTO 0x100
+#define PERTURBERS_MOON  0x200
+#define PERTURBERS_PLUTO_AND_MOON (PERTURBERS_PLUTO | PERTURBERS_MOON)
+#define PERTURBERS_CERES_PALLAS_VESTA 0x1c00
+#define N_PERTURBERS 13
+
+         /* integrate_orbits( ) works on blocks of this many objects : */
+#define INTEGRATION_BLOCK_SIZE 64
+
+/* A perturber source sets locs[i * 3], locs[i * 3 + 1],  locs[i * 3 + 2]
+to the heliocentric ecliptic J2000 position of planet i + 1 (1=Mercury,
+... 9=Pluto,  10=Moon) at 'jd' for each i < 10 whose bit is set in
+'mask',  returning 0 on success.  Planet 3 is always the earth itself;
+if the Moon isn't a perturber (PERTURBERS_MOON not set),  the integrator
+adds the Moon's mass to the earth's.   */
+
+typedef int (*perturber_source_t)( void *source_data, const double jd,
+                        const unsigned long mask, double *locs);
+
+typedef struct perturber_ephem perturber_ephem_t;
+
+/* Everything needed to integrate an orbit.  Nothing in perturb.cpp keeps
+any other state,  so any number of threads can integrate at once,  each
+with its own integration_t,  as long as the perturber source is
+reentrant (or each thread has its own source_data,  for sources such as
+JPL ephemerides that keep state there).  vsop_perturber_source( ) is
+reentrant;  see perturb.cpp.  The position cache and perturber ephemeris
+can be shared,  once made.   */
+
+typedef struct
+{
+   perturber_source_t get_perturbers;
+   void *source_data;
+   unsigned long perturber_mask;
+   int asteroid_perturber_number;   /* 10-12 when integrating Ceres, */
+   int resync_freq;                 /* Pallas,  Vesta;  else -1      */
+   int use_grid;
+   double *position_cache;
+   perturber_ephem_t *ephem;
+   long n_steps_taken, n_evals;     /* statistics */
+} integration_t;
+
+typedef struct
+{
+   const double *times;
+   double *posns;
+   int n_times, n_done, stride;
+} dense_output_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void init_integration( integration_t *integ, perturber_source_t source,
+                  void *source_data, const unsigned long perturber_mask);
+int vsop_perturber_source( void *vsop_data, const double jd,
+                  const unsigned long mask, double *locs);
+double *make_position_cache( const integration_t *integ, double jd0,
+                  const double stepsize, const int n_steps);
+perturber_ephem_t *make_perturber_ephem( const integration_t *integ,
+                  double jd1, double jd2);
+void free_perturber_ephem( perturber_ephem_t *ephem);
+int get_ephem_posns( const perturber_ephem_t *ephem, const double jd,
+                  double *locs);
+int fit_asteroid_perturber( integration_t *integ, perturber_ephem_t *ephem,
+                  const ELEMENTS *start_elem, const double max_err,
+                  const double stepsize);
+int integrate_orbit( integration_t *integ, ELEMENTS *elem,
+                  const double jd_from, const double jd_to,
+                  const double max_err, const int n_steps);
+int integrate_orbits( integration_t *integ, ELEMENTS *elems,
+                  const int n_objects, const double jd_from,
+                  const double jd_to, const double max_err, int n_steps);
+int integrate_adaptively( integration_t *integ, ELEMENTS *elem,
+                  const double jd_from, const double jd_to,
+                  const double max_err, double step,
+                  dense_output_t *dense);
+
+#ifdef __cplusplus
+}
+#endif
+#endif      /* #ifndef PERTURB_H_INCLUDED */
@@ -140,19 +140,75 @@ int DLL_FUNC setup_equatorial_precession_from_j2000(
    return( 0);
 }
 
-#define SEMIRANDOM_GARBAGE1  314.8145501e+12
-#define SEMIRANDOM_GARBAGE2  -9.19001473e-08
+/* It's pretty common to precess a few zillion data points,  or to compute
+positions for many planets at the same time,  all needing the same
+matrices.  So the most recently computed matrices are cached,  keyed by
+kind and the times (and,  for nutation,  the nutation offsets),  so that
+repeated calls don't result in repeated computation.  Each thread gets
+its own cache,  where the compiler allows it;  Watcom and older MSVC get
+one cache for everybody and aren't thread-safe here.  Otherwise,  the
+setup_*precession*( ) functions can be called from any number of threads:
+on a cache miss,  they call mean_obliquity( ) and nutation( ),  neither of
+which keeps any state.  */
+
+#if defined( __WATCOMC__) || (defined( _MSC_VER) && _MSC_VER < 1900)
+   #define THREAD_LOCAL
+#else
+   #define THREAD_LOCAL thread_local
+#endif
+
+#define N_CACHED_MATRICES  8
+
+#define MATRIX_ECLIPTIC_PRECESSION   0
+#define MATRIX_PRECESSION            1
+#define MATRIX_PRECESSION_NUTATION   2
+
+typedef struct
+{
+   int kind;
+   double key[3];
+   double matrix[9];
+} cached_matrix_t;
+
+static THREAD_LOCAL cached_matrix_t matrix_cache[N_CACHED_MATRICES];
+static THREAD_LOCAL int n_cached_matrices = 0, next_cached_matrix = 0;
+
+static const cached_matrix_t *find_cached_matrix( const int kind,
+                     const double key0, const double key1, const double key2)
+{
+   int i;
+
+   for( i = 0; i < n_cached_matrices; i++)
+      {
+      const cached_matrix_t *cptr = matrix_cache + i;
+
+      if( cptr->kind == kind && cptr->key[0] == key0
+                  && cptr->key[1] == key1 && cptr->key[2] == key2)
+         return( cptr);
+      }
+   return( NULL);
+}
+
+static void cache_matrix( const double *matrix, const int kind,
+                     const double key0, const double key1, const double key2)
+{
+   cached_matrix_t *cptr = matrix_cache + next_cached_matrix;
+
+   cptr->kind = kind;
+   cptr->key[0] = key0;
+   cptr->key[1] = key1;
+   cptr->key[2] = key2;
+   memcpy( cptr->matrix, matrix, 9 * sizeof( double));
+   next_cached_matrix = (next_cached_matrix + 1) % N_CACHED_MATRICES;
+   if( n_cached_matrices < N_CACHED_MATRICES)
+      n_cached_matrices++;
+}
 
 int DLL_FUNC setup_ecliptic_precession( double DLLPTR *matrix,
                      const double year_from, const double year_to)
 {
    int rval;
-         /* It's pretty common to precess a few zillion data points.  So   */
-         /* it helps to cache the most recently computed precession matrix */
-         /* so that repeated calls don't result in repeated computation.   */
-   static double prev_year_from = SEMIRANDOM_GARBAGE1;
-   static double prev_year_to   = SEMIRANDOM_GARBAGE2;
-   static double prev_matrix[9];
+   const cached_matrix_t *cached;
 
    if( fabs( year_from - year_to) < 1.e-5)   /* dates sensibly equal; */
       {                                      /* avoid pointless math */
@@ -160,16 +216,20 @@ int DLL_FUNC setup_ecliptic_precession( double DLLPTR *matrix,
       return( 0);
       }
 
-   if( year_from == prev_year_from && year_to == prev_year_to)
+   cached = find_cached_matrix( MATRIX_ECLIPTIC_PRECESSION,
+                                 year_from, year_to, 0.);
+   if( cached)
       {
-      memcpy( matrix, prev_matrix, 9 * sizeof( double));
+      memcpy( matrix, cached->matrix, 9 * sizeof( double));
       return( 0);
       }
                /* Similarly,  it's common to precess first  */
                /* in one direction,  then the other:        */
-   if( year_from == prev_year_to && year_to == prev_year_from)
+   cached = find_cached_matrix( MATRIX_ECLIPTIC_PRECESSION,
+                                 year_to, year_from, 0.);
+   if( cached)
       {
-      memcpy( matrix, prev_matrix, 9 * sizeof( double));
+      memcpy( matrix, cached->matrix, 9 * sizeof( double));
       invert_orthonormal_matrix( matrix);
       return( 0);
       }
@@ -195,20 +255,27 @@ int DLL_FUNC setup_ecliptic_precession( double DLLPTR *matrix,
          }
       }
                /* Store matrix for likely subsequent use: */
-   memcpy( prev_matrix, matrix, 9 * sizeof( double));
-   prev_year_from = year_from;
-   prev_year_to = year_to;
+   cache_matrix( matrix, MATRIX_ECLIPTIC_PRECESSION, year_from, year_to, 0.);
    return( rval);
 }
 
 int DLL_FUNC setup_precession( double DLLPTR *matrix, const double year_from, const double year_to)
 {
-   const double obliquity1 = mean_obliquity( (year_from - 2000.) / 100.);
-   const double obliquity2 = mean_obliquity( (year_to - 2000.) / 100.);
+   const cached_matrix_t *cached = find_cached_matrix( MATRIX_PRECESSION,
+                                 year_from, year_to, 0.);
+   double obliquity1, obliquity2;
 
+   if( cached)
+      {
+      memcpy( matrix, cached->matrix, 9 * sizeof( double));
+      return( 0);
+      }
+   obliquity1 = mean_obliquity( (year_from - 2000.) / 100.);
+   obliquity2 = mean_obliquity( (year_to - 2000.) / 100.);
    setup_ecliptic_precession( matrix, year_from, year_to);
    pre_spin_matrix( matrix + 1, matrix + 2, obliquity1);
    spin_matrix( matrix + 3, matrix + 6, obliquity2);
+   cache_matrix( matrix, MATRIX_PRECESSION, year_from, year_to, 0.);
    return( 0);
 }
 
@@ -222,10 +289,19 @@ int DLL_FUNC setup_precession_with_nutation_delta( double DLLPTR *matrix,
 {
    const double j2000_obliquity = 23.43929111111111 * PI / 180.;
    const double t_cen = (year - 2000.) / 100.;     /* Julian centuries */
-   double obliquity = mean_obliquity( t_cen);      /* from J2000       */
+   double obliquity;
    double d_lon, d_obliq;
    double equation_of_equinoxes;
+   const cached_matrix_t *cached = find_cached_matrix(
+                  MATRIX_PRECESSION_NUTATION, year,
+                  delta_nutation_lon, delta_nutation_obliq);
 
+   if( cached)
+      {
+      memcpy( matrix, cached->matrix, 9 * sizeof( double));
+      return( 0);
+      }
+   obliquity = mean_obliquity( t_cen);      /* from J2000       */
    nutation( t_cen, &d_lon, &d_obliq);
    d_lon   *= PI / (180. * 3600.);    /* cvt arcsec to radians */
    d_obliq *= PI / (180. * 3600.);
@@ -243,6 +319,8 @@ int DLL_FUNC setup_precession_with_nutation_delta( double DLLPTR *matrix,
    spin_matrix( matrix + 3, matrix + 6, obliquity + d_obliq);
    equation_of_equinoxes = d_lon * cos( obliquity);
    spin_matrix( matrix + 3, matrix, equation_of_equinoxes);
+   cache_matrix( matrix, MATRIX_PRECESSION_NUTATION, year,
+                  delta_nutation_lon, delta_nutation_obliq);
    return( 0);
 }
 
@@ -252,6 +330,116 @@ int DLL_FUNC setup_precession_with_nutation( double DLLPTR *matrix,
    return( setup_precession_with_nutation_delta( matrix, year, 0., 0.));
 }
 
+/* For computing many matrices over a span of time,  it's faster still to
+tabulate them on a grid and interpolate.  make_precession_interpolator( )
+computes the matrix for a given kind (see afuncs.h) at evenly spaced
+years,  and interpolated_precession( ) interpolates each element with a
+four-point (cubic) Lagrange polynomial.  Precession alone varies so
+slowly that a grid step of a year gives errors at the 1e-15 radian level;
+that's the default.  With nutation,  the short-period terms require a
+finer grid;  the default is hourly,  good to about 5e-15 radian (see the
+nutation cache in nutation.cpp for the error analysis).  The result isn't
+exactly orthonormal,  but is off by no more than the interpolation error.
+The tabulated matrices are only read from,  so the interpolator can be
+shared between threads.  */
+
+typedef struct
+{
+   int kind;
+   long n_steps;
+   double year0, step;
+   double year_start, year_end;
+   double *matrices;
+} precession_interpolator_t;
+
+static void compute_precession_matrix( double *matrix, const int kind,
+                           const double year)
+{
+   if( kind == PRECESSION_ECLIPTIC)
+      setup_ecliptic_precession( matrix, 2000., year);
+   else if( kind == PRECESSION_EQUATORIAL)
+      setup_precession( matrix, 2000., year);
+   else
+      setup_precession_with_nutation( matrix, year);
+}
+
+void * DLL_FUNC make_precession_interpolator( const int kind,
+            const double year_start, const double year_end, double step)
+{
+   precession_interpolator_t *rval;
+   long n_steps, i;
+
+   if( kind < PRECESSION_ECLIPTIC || kind > PRECESSION_WITH_NUTATION)
+      return( NULL);
+   if( step <= 0.)
+      step = (kind == PRECESSION_WITH_NUTATION ? 1. / (24. * 365.25) : 1.);
+            /* One grid point before year_start,  and enough after year_end */
+            /* for the four-point formula even if year_end lands exactly   */
+            /* on a grid point (i.e.,  the span is a whole number of steps) */
+   n_steps = (long)ceil( (year_end - year_start) / step) + 4;
+   if( n_steps < 4)
+      n_steps = 4;
+   rval = (precession_interpolator_t *)malloc(
+            sizeof( precession_interpolator_t)
+                     + (size_t)n_steps * 9 * sizeof( double));
+   if( !rval)
+      return( NULL);
+   rval->kind = kind;
+   rval->n_steps = n_steps;
+   rval->year0 = year_start - step;
+   rval->year_start = year_start;
+   rval->year_end = year_end;
+   rval->step = step;
+   rval->matrices = (double *)( rval + 1);
+   for( i = 0; i < n_steps; i++)
+      compute_precession_matrix( rval->matrices + i * 9, kind,
+                                 rval->year0 + (double)i * step);
+   return( rval);
+}
+
+int DLL_FUNC free_precession_interpolator( void *interpolator)
+{
+   free( interpolator);
+   return( 0);
+}
+
+/* Returns 0 if the matrix was interpolated,  1 if 'year' was outside the
+span of the interpolator,  in which case it's computed directly.  */
+
+int DLL_FUNC interpolated_precession( const void *interpolator,
+                        const double year, double DLLPTR *matrix)
+{
+   const precession_interpolator_t *interp =
+                     (const precession_interpolator_t *)interpolator;
+   double p = (year - interp->year0) / interp->step, w[4];
+   long idx = (long)floor( p) - 1;
+   const double *mptr;
+   int i;
+
+   if( year >= interp->year_start && year <= interp->year_end)
+      {        /* within the span;  just guard against roundoff at the ends */
+      if( idx < 0)
+         idx = 0;
+      if( idx > interp->n_steps - 4)
+         idx = interp->n_steps - 4;
+      }
+   else if( idx < 0 || idx > interp->n_steps - 4)
+      {
+      compute_precession_matrix( matrix, interp->kind, year);
+      return( 1);
+      }
+   p -= (double)( idx + 1);       /* now 0 <= p < 1,  give or take roundoff */
+   w[0] = -p * (p - 1.) * (p - 2.) / 6.;
+   w[1] = (p + 1.) * (p - 1.) * (p - 2.) / 2.;
+   w[2] = -(p + 1.) * p * (p - 2.) / 2.;
+   w[3] = (p + 1.) * p * (p - 1.) / 6.;
+   mptr = interp->matrices + idx * 9;
+   for( i = 0; i < 9; i++)
+      matrix[i] = w[0] * mptr[i] + w[1] * mptr[i + 9]
+                + w[2] * mptr[i + 18] + w[3] * mptr[i + 27];
+   return( 0);
+}
+
 static const double sin_obliq_2000 = 0.397777155931913701597179975942380896684;
 static const double cos_obliq_2000 = 0.917482062069181825744000384639406458043;
 
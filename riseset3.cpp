@@ -64,11 +64,11 @@ int fill_planet_data( PLANET_DATA *pdata, const int planet_no, const double jd,
    double loc_sidereal_time = green_sidereal_time( jd) + observer_lon;
    double t_centuries = (jd - J2000) / 36525.;
    double obliquity = mean_obliquity( t_centuries);
-   double loc[3];
+   double loc[3], ovals[15];
 
    pdata->jd = jd;
-   if( planet_no == 10)         /* get lunar data,  not VSOP */
-      {
+   if( planet_no == 10)         /* get lunar data,  not VSOP;  we keep */
+      {                         /* the distance in km,  not AU         */
       double fund[N_FUND];
 
       lunar_fundamentals( vsop_data, t_centuries, fund);
@@ -78,19 +78,19 @@ int fill_planet_data( PLANET_DATA *pdata, const int planet_no, const double jd,
       }
    else
       {
+                  /* Only the polar ecliptic-of-date position is used : */
+      compute_planet_frames( vsop_data, planet_no, t_centuries,
+                                 PLANET_POLAR_OF_DATE, NULL, ovals);
+      pdata->r = ovals[2];
                   /* What we _really_ want is the location of the sun as */
                   /* seen from the earth.  VSOP gives us the opposite,   */
                   /* i.e.,  where the _earth_ is as seen from the _sun_. */
                   /* To evade this,  we add PI to the longitude and      */
                   /* negate the latitude.                                */
-      pdata->ecliptic_lon =
-               calc_vsop_loc( vsop_data, planet_no, 0, t_centuries, 0.) + pi;
-      pdata->ecliptic_lat =
-                  -calc_vsop_loc( vsop_data, planet_no, 1, t_centuries, 0.);
-      pdata->r   = calc_vsop_loc( vsop_data, planet_no, 2, t_centuries, 0.);
+      pdata->ecliptic_lon = ovals[0] + pi;
+      pdata->ecliptic_lat = -ovals[1];
       }
 
-
    polar3_to_cartesian( loc, pdata->ecliptic_lon, pdata->ecliptic_lat);
    memcpy( pdata->ecliptic_loc, loc, 3 * sizeof( double));
 
@@ -23,6 +23,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#ifndef _WIN32
+   #include <sys/mman.h>
+#endif
 #include "watdefs.h"
 #include "comets.h"
 #include "date.h"
@@ -199,6 +202,148 @@ int extract_sof_data( ELEMENTS *elem, const char *buff, const char *header)
    return( extract_sof_data_ex( elem, buff, header, NULL));
 }
 
+/* Parsing a full SOF file of 1.3 million orbits (as astcheck and others
+need to do) takes a couple of seconds,  all of it spent walking the header
+and calling atof( ).  A 'compiled' SOF file holds the same data as
+sof_record_ts,  with derive_quantities( ) already done,  so it can just be
+mapped into memory and used directly.  The file starts with a header of
+COMPILED_SOF_HEADER_SIZE bytes :  a magic number,  the checksum of the
+SOF file it was compiled from (see compute_sof_checksum( )),  the number
+of records,  and the size of each record (to catch files written by code
+with a different ELEMENTS layout).  The rest of the header is zeroes.
+
+   Note that comet_posn( ) and friends modify the ELEMENTS they're given
+(they set the mean anomaly).  Copy the elements from a loaded compiled
+file before use;  on non-Windows systems,  the file is mapped read-only. */
+
+#define COMPILED_SOF_MAGIC          0x534f4662
+#define COMPILED_SOF_HEADER_SIZE    64
+
+/* This 'checksum' is really just a way to see if the SOF file has changed.
+It looks at four chunks,  evenly spread through the file,  plus the file
+length.  It has to match the one astcheck has always used (it's stored in
+the '.chk' files),  quirks included. */
+
+int32_t compute_sof_checksum( FILE *sof_file)
+{
+   uint32_t rval = 0;
+   long filelen;
+   size_t i, j;
+   char buff[450];
+
+   fseek( sof_file, 0L, SEEK_END);
+   filelen = ftell( sof_file);
+   for( i = 0; i < 4; i++)
+      {
+      const uint32_t big_prime = 1234567891;
+
+      fseek( sof_file, (long)( i * (filelen - sizeof( buff))) / 3L, SEEK_SET);
+      if( fread( buff, sizeof( buff), 1, sof_file))
+         for( j = 0; j < sizeof( buff); j++)
+            rval = rval * big_prime + (uint32_t)(int32_t)buff[i];
+      }
+   fseek( sof_file, 0L, SEEK_SET);
+   return( (int32_t)rval);
+}
+
+/* Reads the SOF file and writes out its compiled equivalent.  Returns the
+number of records written,  or a negative value on error.  The object
+names are the first twelve bytes of each SOF record;  objects are flagged
+as comets (is_asteroid = 0) by the same rules astcheck uses.   */
+
+int write_compiled_sof( FILE *ofile, FILE *sof_file)
+{
+   char header[COMPILED_SOF_HEADER_SIZE], sof_header[450], buff[450];
+   int32_t ivals[4];
+   int rval = 0;
+   sof_record_t rec;
+
+   memset( header, 0, sizeof( header));
+   ivals[0] = COMPILED_SOF_MAGIC;
+   ivals[1] = compute_sof_checksum( sof_file);
+   ivals[3] = (int32_t)sizeof( sof_record_t);
+   if( !fgets( sof_header, sizeof( sof_header), sof_file))
+      return( -1);
+   if( fseek( ofile, (long)COMPILED_SOF_HEADER_SIZE, SEEK_SET))
+      return( -2);
+   memset( &rec, 0, sizeof( rec));
+   while( fgets( buff, sizeof( buff), sof_file))
+      {
+      if( extract_sof_data( &rec.elem, buff, sof_header))
+         return( -3);
+      memcpy( rec.name, buff, 12);
+      rec.elem.is_asteroid = !(buff[1] == '/' || strchr( "APXCD", buff[3]));
+      if( !fwrite( &rec, sizeof( rec), 1, ofile))
+         return( -2);
+      rval++;
+      }
+   ivals[2] = rval;
+   memcpy( header, ivals, sizeof( ivals));
+   fseek( ofile, 0L, SEEK_SET);
+   if( !fwrite( header, sizeof( header), 1, ofile))
+      return( -2);
+   return( rval);
+}
+
+/* Loads (on non-Windows boxes,  memory-maps) a compiled SOF file,  provided
+it was compiled from a SOF file with the given checksum.  Returns NULL if
+it's missing,  outdated,  or truncated.  Release with free_compiled_sof( ). */
+
+sof_record_t *load_compiled_sof( const char *filename, const int32_t checksum,
+                                 int *n_records)
+{
+   FILE *ifile = fopen( filename, "rb");
+   int32_t ivals[4];
+   size_t file_size;
+   char *base = NULL;
+
+   if( !ifile)
+      return( NULL);
+   if( !fread( ivals, sizeof( ivals), 1, ifile) || ivals[0] != COMPILED_SOF_MAGIC
+               || ivals[1] != checksum || ivals[2] < 0
+               || ivals[3] != (int32_t)sizeof( sof_record_t))
+      {
+      fclose( ifile);
+      return( NULL);
+      }
+   file_size = COMPILED_SOF_HEADER_SIZE + (size_t)ivals[2] * sizeof( sof_record_t);
+   fseek( ifile, 0L, SEEK_END);
+   if( (size_t)ftell( ifile) == file_size)
+      {
+#ifdef _WIN32
+      base = (char *)malloc( file_size);
+      fseek( ifile, 0L, SEEK_SET);
+      if( base && !fread( base, file_size, 1, ifile))
+         {
+         free( base);
+         base = NULL;
+         }
+#else
+      base = (char *)mmap( NULL, file_size, PROT_READ, MAP_SHARED,
+                           fileno( ifile), 0);
+      if( base == (char *)MAP_FAILED)
+         base = NULL;
+#endif
+      }
+   fclose( ifile);
+   if( !base)
+      return( NULL);
+   *n_records = ivals[2];
+   return( (sof_record_t *)( base + COMPILED_SOF_HEADER_SIZE));
+}
+
+void free_compiled_sof( sof_record_t *recs, const int n_records)
+{
+   char *base = (char *)recs - COMPILED_SOF_HEADER_SIZE;
+
+#ifdef _WIN32
+   INTENTIONALLY_UNUSED_PARAMETER( n_records);
+   free( base);
+#else
+   munmap( base, COMPILED_SOF_HEADER_SIZE + (size_t)n_records * sizeof( sof_record_t));
+#endif
+}
+
 #ifdef TEST_CODE
 
 #define MAX_LEN 300
@@ -19,6 +19,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <assert.h>
 #include "watdefs.h"
@@ -106,3 +107,292 @@ double DLL_FUNC calc_vsop_loc( const void FAR *data, const int planet,
    return( rval);
 }
 
+
+/* calc_vsop_loc( ) is fine for the odd position.  But it unpacks each
+term from VSOP.BIN as it goes,  and gets one coordinate at one time;
+and rise/set tables,  ephemerides,  and integrat's position cache want
+all three coordinates for a planet at many evenly spaced times.  So
+load_vsop_table( ) unpacks the terms once into native doubles,  and
+calc_vsop_locs( ) evaluates longitude,  latitude,  and radius (and,  if
+you want them,  their rates) at n_times times t0,  t0 + dt,  t0 + 2dt...
+
+   Each term is A cos( B + C t).  Computing the cosine for each term at
+each time is most of the work.  But if we know the cosine and sine of
+the argument at one time,  we can step to the next time with the
+angle-addition formulae,  using cos(C dt) and sin(C dt) :
+
+cos( x + C dt) = cos( x) cos( C dt) - sin( x) sin( C dt)
+sin( x + C dt) = sin( x) cos( C dt) + cos( x) sin( C dt)
+
+   That's four multiplications and two additions instead of a cos( ).
+Errors creep in with each step,  so we start over with cos( ) and sin( )
+every VSOP_CHUNK times;  the results then agree with calc_vsop_loc( ) to
+within a few units in the last place.  (At the start of each chunk,  and
+so always when n_times == 1,  they're identical.)  Times are in Julian
+centuries from J2000,  as for calc_vsop_loc( ).  */
+
+#define VSOP_CHUNK 32
+#define N_VSOP_OFFSETS (8 * 18 + 1)
+
+typedef struct
+{
+   int16_t offsets[N_VSOP_OFFSETS];
+   int max_terms;
+   double scale;
+   double *terms;             /* A, B, C for each term */
+} vsop_table_t;
+
+void * DLL_FUNC load_vsop_table( const void FAR *data)
+{
+   const int16_t FAR *loc = (const int16_t FAR *)data;
+   const double FAR *tptr = (const double FAR *)( loc + N_VSOP_OFFSETS);
+   vsop_table_t *rval;
+   int i, n_terms;
+
+   assert( data);                         /* check VSOP data is correct */
+   assert( ((char *)data)[2] == '&');
+   assert( ((char *)data)[20] == 'x');
+   assert( ((char *)data)[0xea0a] == 'q');
+   assert( get16bits( (char *)data + 0x10c) == 0x93e);
+   n_terms = (int)get16bits( loc + N_VSOP_OFFSETS - 1);
+   rval = (vsop_table_t *)malloc( sizeof( vsop_table_t)
+                                 + (size_t)n_terms * 3 * sizeof( double));
+   if( !rval)
+      return( NULL);
+   rval->terms = (double *)( rval + 1);
+   rval->max_terms = 0;
+   for( i = 0; i < N_VSOP_OFFSETS; i++)
+      {
+      rval->offsets[i] = (int16_t)get16bits( loc + i);
+      assert( rval->offsets[i] >= 0 && rval->offsets[i] <= n_terms);
+      if( i && rval->max_terms < rval->offsets[i] - rval->offsets[i - 1])
+         rval->max_terms = rval->offsets[i] - rval->offsets[i - 1];
+      }
+   for( i = 0; i < n_terms * 3; i++)
+      rval->terms[i] = get_double( tptr + i);
+   rval->scale = (((const char FAR *)data)[2] == 38 ? 1.e-8 : 1.);
+   return( rval);
+}
+
+int DLL_FUNC unload_vsop_table( void *table)
+{
+   free( table);
+   return( 0);
+}
+
+/* For one series,  sets sums[i] = the sum of A cos( B + C t[i]) for the
+n_times (at most VSOP_CHUNK) times in t[],  assumed to be 'dt' apart,
+and (if dsums isn't NULL) sets dsums[i] to its derivative.  All times
+are in millennia.  rot[] holds cos( C dt) and sin( C dt) for each term;
+cs[] is scratch space for the cosines and sines of the arguments.  */
+
+static void vsop_series_sums( const double *terms, const int n_terms,
+            const double *t, const int n_times, const double *rot,
+            double *sums, double *dsums, double *cs)
+{
+   double *sn = cs + n_terms;
+   const double *rot_sin = rot + n_terms;
+   int i, j;
+
+   for( j = 0; j < n_terms; j++)
+      {
+      const double argument = terms[j * 3 + 1] + terms[j * 3 + 2] * t[0];
+
+      cs[j] = cos( argument);
+      sn[j] = sin( argument);
+      }
+   for( i = 0; i < n_times; i++)
+      {
+      double sum = 0., dsum = 0.;
+
+      if( i)         /* step arguments on from the previous time */
+         for( j = 0; j < n_terms; j++)
+            {
+            const double new_cs = cs[j] * rot[j] - sn[j] * rot_sin[j];
+
+            sn[j] = sn[j] * rot[j] + cs[j] * rot_sin[j];
+            cs[j] = new_cs;
+            }
+      for( j = 0; j < n_terms; j++)
+         sum += terms[j * 3] * cs[j];
+      sums[i] = sum;
+      if( dsums)
+         {
+         for( j = 0; j < n_terms; j++)
+            dsum -= terms[j * 3] * terms[j * 3 + 2] * sn[j];
+         dsums[i] = dsum;
+         }
+      }
+}
+
+/* lbr[i * 3],  lbr[i * 3 + 1],  lbr[i * 3 + 2] are set to the ecliptic
+(of date) longitude,  latitude,  and radius of the planet at time
+t0 + i * dt,  just as calc_vsop_loc( ) would give them.  If lbr_rates
+isn't NULL,  it gets their rates of change,  in radians and AU per day.
+Returns 0,  or -1 if memory runs out. */
+
+int DLL_FUNC calc_vsop_locs( const void *vsop_table, const int planet,
+                  const double t0, const double dt, const int n_times,
+                  double *lbr, double *lbr_rates)
+{
+   const vsop_table_t *table = (const vsop_table_t *)vsop_table;
+   double *scratch;
+   int value, i;
+
+   for( i = 0; i < n_times * 3; i++)
+      {
+      lbr[i] = 0.;
+      if( lbr_rates)
+         lbr_rates[i] = 0.;
+      }
+   if( !planet)
+      return( 0);       /* the sun */
+   assert( planet > 0 && planet < 9);
+   scratch = (double *)malloc( (size_t)table->max_terms * 4 * sizeof( double));
+   if( !scratch)
+      return( -1);
+   for( value = 0; value < 3; value++)
+      {
+      const int16_t *loc = table->offsets + (planet - 1) * 18 + value * 6;
+      int power, chunk;
+
+      for( power = 0; power < 6; power++)
+         {
+         const double *terms = table->terms + loc[power] * 3;
+         const int n_terms = loc[power + 1] - loc[power];
+         double *rot = scratch + 2 * n_terms;
+
+         for( i = 0; i < n_terms; i++)
+            {
+            rot[i] = cos( terms[i * 3 + 2] * dt / 10.);
+            rot[i + n_terms] = sin( terms[i * 3 + 2] * dt / 10.);
+            }
+         for( chunk = 0; chunk < n_times; chunk += VSOP_CHUNK)
+            {
+            const int n = (n_times - chunk < VSOP_CHUNK ?
+                                    n_times - chunk : VSOP_CHUNK);
+            double t[VSOP_CHUNK], sums[VSOP_CHUNK], dsums[VSOP_CHUNK];
+
+            for( i = 0; i < n; i++)    /* convert to julian millennia */
+               t[i] = (t0 + (double)( chunk + i) * dt) / 10.;
+            vsop_series_sums( terms, n_terms, t, n, rot, sums,
+                              (lbr_rates ? dsums : NULL), scratch);
+            for( i = 0; i < n; i++)
+               {
+               double power_of_t = 1., prev_power = 0.;
+               int j;
+
+               for( j = 0; j < power; j++)
+                  {
+                  prev_power = power_of_t;
+                  power_of_t *= t[i];
+                  }
+               lbr[(chunk + i) * 3 + value] += sums[i] * power_of_t;
+               if( lbr_rates)
+                  lbr_rates[(chunk + i) * 3 + value] += dsums[i] * power_of_t
+                              + (double)power * sums[i] * prev_power;
+               }
+            }
+         }
+      }
+   free( scratch);
+   for( i = 0; i < n_times; i++)
+      {
+      double *tptr = lbr + i * 3;
+
+      for( value = 0; value < 3; value++)
+         tptr[value] *= table->scale;
+      *tptr = fmod( *tptr, TWO_PI);     /* ensure 0 < lon < 2 * pi  */
+      if( *tptr < 0.)
+         *tptr += TWO_PI;
+      if( lbr_rates)
+         for( value = 0; value < 3; value++)
+            lbr_rates[i * 3 + value] *= table->scale / 365250.;
+      }
+   return( 0);
+}
+
+#ifdef TEST_CODE
+
+/* Compares calc_vsop_locs( ) to calc_vsop_loc( ),  both for speed and
+for the results:  the largest differences in position (in AU) and in
+the rates (checked against numerical differentiation).   Run as
+
+vsopson (n_times) (step in days)     */
+
+#include <time.h>
+
+static double seconds( void)
+{
+   return( (double)clock( ) / (double)CLOCKS_PER_SEC);
+}
+
+int main( const int argc, const char **argv)
+{
+   FILE *ifile = fopen( "vsop.bin", "rb");
+   const int n_times = (argc > 1 ? atoi( argv[1]) : 1000);
+   const double dt = (argc > 2 ? atof( argv[2]) : 1.) / 36525.;
+   const double t0 = -.05;
+   char *vsop_data = (char *)malloc( 60874);
+   double *lbr = (double *)malloc( n_times * 9 * sizeof( double));
+   double *rates = lbr + n_times * 3, *lbr2 = lbr + n_times * 6;
+   double time_old = 0., time_new = 0., max_diff = 0., max_rate_diff = 0.;
+   void *table;
+   int planet, i;
+
+   if( !ifile || !vsop_data || !lbr || !fread( vsop_data, 60874, 1, ifile))
+      {
+      printf( "Couldn't load 'vsop.bin'\n");
+      return( -1);
+      }
+   fclose( ifile);
+   table = load_vsop_table( vsop_data);
+   for( planet = 1; planet <= 8; planet++)
+      {
+      double t = seconds( );
+
+      for( i = 0; i < n_times; i++)
+         {
+         const double t_cen = t0 + (double)i * dt;
+
+         lbr2[i * 3] = calc_vsop_loc( vsop_data, planet, 0, t_cen, 0.);
+         lbr2[i * 3 + 1] = calc_vsop_loc( vsop_data, planet, 1, t_cen, 0.);
+         lbr2[i * 3 + 2] = calc_vsop_loc( vsop_data, planet, 2, t_cen, 0.);
+         }
+      time_old += seconds( ) - t;
+      t = seconds( );
+      calc_vsop_locs( table, planet, t0, dt, n_times, lbr, rates);
+      time_new += seconds( ) - t;
+      for( i = 0; i < n_times; i++)
+         {
+         double *loc = lbr + i * 3, *loc2 = lbr2 + i * 3, diff;
+
+         diff = loc[2] - loc2[2];
+         diff = sqrt( diff * diff + loc[2] * loc[2] * ((loc[1] - loc2[1]) *
+                  (loc[1] - loc2[1]) + (loc[0] - loc2[0]) * (loc[0] - loc2[0])));
+         if( max_diff < diff)
+            max_diff = diff;
+         if( i && i < n_times - 1)
+            {
+            const double numeric_rate =
+                  (loc[5] - loc[-1]) / (2. * dt * 36525.);
+
+            diff = fabs( numeric_rate - rates[i * 3 + 2]);
+            if( max_rate_diff < diff)
+               max_rate_diff = diff;
+            }
+         }
+      }
+   printf( "%d times,  8 planets\n", n_times);
+   printf( "calc_vsop_loc( ):  %.3f s\n", time_old);
+   printf( "calc_vsop_locs( ): %.3f s  (%.1f times faster)\n", time_new,
+                  time_old / time_new);
+   printf( "Largest difference in position: %.3g AU\n", max_diff);
+   printf( "Largest radius rate difference from numerical: %.3g AU/day\n",
+                  max_rate_diff);
+   unload_vsop_table( table);
+   free( lbr);
+   free( vsop_data);
+   return( 0);
+}
+#endif